@@ -0,0 +1,111 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Compares insert and lookup throughput of the memtable representations
+// built on SkipList (pointer to an arena-allocated key) and InlineSkipList
+// (key stored inline with a cached prefix).
+//
+// Usage: skiplist_bench [--num=N] [--key_size=N] [--value_size=N]
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "db/dbformat.h"
+#include "db/memtable.h"
+#include "leveldb/comparator.h"
+#include "leveldb/env.h"
+#include "leveldb/memtablerep.h"
+#include "leveldb/options.h"
+#include "util/random.h"
+
+namespace leveldb {
+
+namespace {
+
+int FLAGS_num = 1000000;
+int FLAGS_key_size = 16;
+int FLAGS_value_size = 100;
+
+std::string MakeKey(uint64_t k) {
+  char buf[32];
+  std::snprintf(buf, sizeof(buf), "%016llu",
+                static_cast<unsigned long long>(k));
+  std::string key(buf);
+  key.resize(FLAGS_key_size, 'x');
+  return key;
+}
+
+void Run(const char* name, MemTableRepFactory* factory,
+         const std::vector<std::string>& keys) {
+  InternalKeyComparator cmp(BytewiseComparator());
+  Options options;
+  options.memtable_factory = factory;
+  MemTable* mem = new MemTable(cmp, options);
+  mem->Ref();
+  const std::string value(FLAGS_value_size, 'v');
+  Env* env = Env::Default();
+
+  uint64_t start = env->NowMicros();
+  for (size_t i = 0; i < keys.size(); i++) {
+    mem->Add(i + 1, kTypeValue, keys[i], value);
+  }
+  const double insert_secs = (env->NowMicros() - start) * 1e-6;
+
+  Random rnd(301);
+  std::string result;
+  int found = 0;
+  start = env->NowMicros();
+  for (size_t i = 0; i < keys.size(); i++) {
+    Status s;
+    LookupKey lkey(keys[rnd.Uniform(keys.size())], kMaxSequenceNumber);
+    if (mem->Get(lkey, &result, &s)) found++;
+  }
+  const double get_secs = (env->NowMicros() - start) * 1e-6;
+
+  std::fprintf(stdout,
+               "%-20s : insert %9.0f ops/sec  get %9.0f ops/sec  (%d found)\n",
+               name, keys.size() / insert_secs, keys.size() / get_secs, found);
+  mem->Unref();
+}
+
+}  // namespace
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  for (int i = 1; i < argc; i++) {
+    int n;
+    char junk;
+    if (sscanf(argv[i], "--num=%d%c", &n, &junk) == 1) {
+      leveldb::FLAGS_num = n;
+    } else if (sscanf(argv[i], "--key_size=%d%c", &n, &junk) == 1) {
+      leveldb::FLAGS_key_size = n;
+    } else if (sscanf(argv[i], "--value_size=%d%c", &n, &junk) == 1) {
+      leveldb::FLAGS_value_size = n;
+    } else {
+      std::fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
+      std::exit(1);
+    }
+  }
+
+  // Random insertion order, no duplicates.
+  std::vector<std::string> keys;
+  leveldb::Random rnd(1000);
+  for (int i = 0; i < leveldb::FLAGS_num; i++) {
+    keys.push_back(leveldb::MakeKey(
+        (static_cast<uint64_t>(rnd.Next()) << 20) ^ static_cast<uint64_t>(i)));
+  }
+
+  leveldb::MemTableRepFactory* skiplist = leveldb::NewSkipListRepFactory();
+  leveldb::MemTableRepFactory* inline_skiplist =
+      leveldb::NewInlineSkipListRepFactory();
+  leveldb::Run("skiplist", skiplist, keys);
+  leveldb::Run("inline skiplist", inline_skiplist, keys);
+  delete skiplist;
+  delete inline_skiplist;
+  return 0;
+}
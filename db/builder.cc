@@ -4,40 +4,75 @@
 
 #include "db/builder.h"
 
+#include <algorithm>
+
 #include "db/dbformat.h"
 #include "db/filename.h"
+#include "db/range_tombstone.h"
 #include "db/table_cache.h"
 #include "db/version_edit.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
+#include "util/rate_limiter.h"
 
 namespace leveldb {
 
 Status BuildTable(const std::string& dbname, Env* env, const Options& options,
-                  TableCache* table_cache, Iterator* iter, FileMetaData* meta) {
+                  TableCache* table_cache, Iterator* iter,
+                  const std::vector<RangeTombstone>& range_dels,
+                  FileMetaData* meta) {
   Status s;
   meta->file_size = 0;
+  meta->num_entries = 0;
+  meta->num_deletions = 0;
+  meta->creation_time = env->NowMicros() / 1000000;
   iter->SeekToFirst();
 
   std::string fname = TableFileName(dbname, meta->number);
-  if (iter->Valid()) {
+  if (iter->Valid() || !range_dels.empty()) {
     WritableFile* file;
     s = env->NewWritableFile(fname, &file);
     if (!s.ok()) {
       return s;
     }
+    // Flushes unblock writers, so they go ahead of compactions.
+    file = NewRateLimitedWritableFile(file, options.rate_limiter,
+                                      RateLimiter::kIOHigh);
 
     TableBuilder* builder = new TableBuilder(options, file);
-    meta->smallest.DecodeFrom(iter->key());
+    const bool has_entries = iter->Valid();
+    if (has_entries) {
+      meta->smallest.DecodeFrom(iter->key());
+    }
     Slice key;
+    SequenceNumber smallest_seq = kMaxSequenceNumber;
+    SequenceNumber largest_seq = 0;
+    ParsedInternalKey ikey;
     for (; iter->Valid(); iter->Next()) {
       key = iter->key();
       builder->Add(key, iter->value());
+      meta->num_entries++;
+      if (ParseInternalKey(key, &ikey)) {
+        if (ikey.type == kTypeDeletion) {
+          meta->num_deletions++;
+        }
+        smallest_seq = std::min(smallest_seq, ikey.sequence);
+        largest_seq = std::max(largest_seq, ikey.sequence);
+      }
     }
     if (!key.empty()) {
       meta->largest.DecodeFrom(key);
     }
+    if (!range_dels.empty()) {
+      AddRangeTombstonesToTable(
+          *static_cast<const InternalKeyComparator*>(options.comparator),
+          range_dels, has_entries, builder, &meta->smallest, &meta->largest);
+      meta->has_range_deletions = true;
+    }
+    if (has_entries) {
+      builder->SetEntryStats(meta->num_deletions, smallest_seq, largest_seq);
+    }
 
     // Finish and check for builder errors
     s = builder->Finish();
@@ -5,6 +5,9 @@
 #ifndef STORAGE_LEVELDB_DB_BUILDER_H_
 #define STORAGE_LEVELDB_DB_BUILDER_H_
 
+#include <string>
+#include <vector>
+
 #include "leveldb/status.h"
 
 namespace leveldb {
@@ -13,17 +16,22 @@ struct Options;
 struct FileMetaData;
 
 class Env;
+struct RangeTombstone;
 class Iterator;
 class TableCache;
 class VersionEdit;
 
-// Build a Table file from the contents of *iter.  The generated file
-// will be named according to meta->number.  On success, the rest of
-// *meta will be filled with metadata about the generated table.
-// If no data is present in *iter, meta->file_size will be set to
-// zero, and no Table file will be produced.
+// Build a Table file from the contents of *iter and the range tombstones
+// in "range_dels", which must be sorted by SortRangeTombstones().  The
+// generated file will be named according to meta->number.  On success,
+// the rest of *meta will be filled with metadata about the generated
+// table.  If neither *iter nor "range_dels" holds any data,
+// meta->file_size will be set to zero, and no Table file will be
+// produced.
 Status BuildTable(const std::string& dbname, Env* env, const Options& options,
-                  TableCache* table_cache, Iterator* iter, FileMetaData* meta);
+                  TableCache* table_cache, Iterator* iter,
+                  const std::vector<RangeTombstone>& range_dels,
+                  FileMetaData* meta);
 
 }  // namespace leveldb
 
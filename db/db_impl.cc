@@ -8,6 +8,8 @@
 #include <atomic>
 #include <cstdint>
 #include <cstdio>
+#include <cstdlib>
+#include <deque>
 #include <set>
 #include <string>
 #include <vector>
@@ -19,9 +21,12 @@
 #include "db/log_reader.h"
 #include "db/log_writer.h"
 #include "db/memtable.h"
+#include "db/merge_helper.h"
+#include "db/range_tombstone.h"
 #include "db/table_cache.h"
 #include "db/version_set.h"
 #include "db/write_batch_internal.h"
+#include "leveldb/compaction_filter.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "leveldb/status.h"
@@ -34,6 +39,7 @@
 #include "util/coding.h"
 #include "util/logging.h"
 #include "util/mutexlock.h"
+#include "util/rate_limiter.h"
 
 namespace leveldb {
 
@@ -42,11 +48,18 @@ const int kNumNonTableCacheFiles = 10;
 // Information kept for every waiting writer
 struct DBImpl::Writer {
   explicit Writer(port::Mutex* mu)
-      : batch(nullptr), sync(false), done(false), cv(mu) {}
+      : batch(nullptr),
+        sync(false),
+        disable_wal(false),
+        exclusive(false),
+        done(false),
+        cv(mu) {}
 
   Status status;
   WriteBatch* batch;
   bool sync;
+  bool disable_wal;
+  bool exclusive;  // Never part of the group of another writer
   bool done;
   port::CondVar cv;
 };
@@ -57,6 +70,10 @@ struct DBImpl::CompactionState {
     uint64_t number;
     uint64_t file_size;
     InternalKey smallest, largest;
+    bool has_range_deletions;
+    uint64_t num_entries;
+    uint64_t num_deletions;
+    SequenceNumber smallest_seq, largest_seq;
   };
 
   Output* current_output() { return &outputs[outputs.size() - 1]; }
@@ -64,10 +81,22 @@ struct DBImpl::CompactionState {
   explicit CompactionState(Compaction* c)
       : compaction(c),
         smallest_snapshot(0),
+        newest_snapshot(0),
         outfile(nullptr),
         builder(nullptr),
+        has_range_del_lower(false),
+        merge_stripe(0),
+        reserved_number(0),
         total_bytes(0) {}
 
+  // Index in "snapshots" of the oldest snapshot that sees entries with
+  // sequence number "s", or snapshots.size() if none does.  Entries with
+  // the same index are seen by the same snapshots.
+  size_t SnapshotStripe(SequenceNumber s) const {
+    return std::lower_bound(snapshots.begin(), snapshots.end(), s) -
+           snapshots.begin();
+  }
+
   Compaction* const compaction;
 
   // Sequence numbers < smallest_snapshot are not significant since we
@@ -76,12 +105,37 @@ struct DBImpl::CompactionState {
   // we can drop all entries for the same key with sequence numbers < S.
   SequenceNumber smallest_snapshot;
 
+  // Entries with larger sequence numbers are seen by no snapshot, so the
+  // compaction filter may drop or rewrite them.  Zero if there are no
+  // snapshots.
+  SequenceNumber newest_snapshot;
+
+  // Sequence numbers of all snapshots, oldest first.  Only filled in if
+  // there is a merge operator.
+  std::vector<SequenceNumber> snapshots;
+
   std::vector<Output> outputs;
 
   // State kept for output being generated
   WritableFile* outfile;
   TableBuilder* builder;
 
+  // Range tombstones to write, sorted as BuildTable() expects.  Each
+  // output gets the part from the first user key of its own range up to
+  // that of the next output, so that outputs do not overlap.
+  std::vector<RangeTombstone> range_dels;
+  std::string range_del_lower;  // Valid iff has_range_del_lower
+  bool has_range_del_lower;
+
+  // Merge operands of one user key that may still be combined with older
+  // entries, newest first, and their SnapshotStripe().
+  std::vector<std::string> merge_keys;  // Internal keys
+  std::vector<std::string> merge_operands;
+  size_t merge_stripe;
+
+  // If non-zero, the number to give the next output file.
+  uint64_t reserved_number;
+
   uint64_t total_bytes;
 };
 
@@ -91,6 +145,29 @@ static void ClipToRange(T* ptr, V minvalue, V maxvalue) {
   if (static_cast<V>(*ptr) > maxvalue) *ptr = maxvalue;
   if (static_cast<V>(*ptr) < minvalue) *ptr = minvalue;
 }
+
+// Clip the options that DB::SetOptions() may change.
+static void SanitizeMutableOptions(Options* result) {
+  ClipToRange(&result->level0_file_num_compaction_trigger, 1, 1 << 20);
+  ClipToRange(&result->max_mem_compaction_level, 0, result->num_levels - 1);
+  ClipToRange(&result->max_bytes_for_level_base, uint64_t{64} << 10,
+              uint64_t{1} << 40);
+  ClipToRange(&result->max_bytes_for_level_multiplier, 2.0, 1000.0);
+  ClipToRange(&result->level0_slowdown_writes_trigger,
+              result->level0_file_num_compaction_trigger, 1 << 20);
+  ClipToRange(&result->level0_stop_writes_trigger,
+              result->level0_slowdown_writes_trigger, 1 << 20);
+  if (result->hard_pending_compaction_bytes_limit != 0 &&
+      result->hard_pending_compaction_bytes_limit <
+          result->soft_pending_compaction_bytes_limit) {
+    result->hard_pending_compaction_bytes_limit =
+        result->soft_pending_compaction_bytes_limit;
+  }
+  if (result->delayed_write_rate < kMinDelayedWriteRate) {
+    result->delayed_write_rate = kMinDelayedWriteRate;
+  }
+}
+
 Options SanitizeOptions(const std::string& dbname,
                         const InternalKeyComparator* icmp,
                         const InternalFilterPolicy* ipolicy,
@@ -98,10 +175,28 @@ Options SanitizeOptions(const std::string& dbname,
   Options result = src;
   result.comparator = icmp;
   result.filter_policy = (src.filter_policy != nullptr) ? ipolicy : nullptr;
+  ClipToRange(&result.num_levels, 2, config::kMaxNumLevels);
   ClipToRange(&result.max_open_files, 64 + kNumNonTableCacheFiles, 50000);
   ClipToRange(&result.write_buffer_size, 64 << 10, 1 << 30);
+  ClipToRange(&result.max_write_buffer_number, 2, 64);
+  ClipToRange(&result.flush_parallelism, 1, 16);
+  ClipToRange(&result.memtable_bloom_size_ratio, 0.0, 0.25);
+  ClipToRange(&result.memtable_max_deletion_ratio, 0.0, 1.0);
+  if ((result.memtable_huge_page_size &
+       (result.memtable_huge_page_size - 1)) != 0 ||
+      result.memtable_huge_page_size > result.write_buffer_size / 4) {
+    result.memtable_huge_page_size = 0;
+  }
   ClipToRange(&result.max_file_size, 1 << 20, 1 << 30);
   ClipToRange(&result.block_size, 1 << 10, 4 << 20);
+  ClipToRange(&result.compaction_readahead_size, 0, 64 << 20);
+  ClipToRange(&result.universal_size_ratio, 0, 1 << 20);
+  ClipToRange(&result.universal_min_merge_width, 2, 1 << 20);
+  ClipToRange(&result.universal_max_merge_width,
+              result.universal_min_merge_width, 1 << 20);
+  ClipToRange(&result.universal_max_size_amplification_percent, 0, 1 << 20);
+  ClipToRange(&result.deletion_compaction_ratio, 0.0, 1.0);
+  SanitizeMutableOptions(&result);
   if (result.info_log == nullptr) {
     // Open a log file in the same directory as the db
     src.env->CreateDir(dbname);  // In case it does not exist
@@ -123,6 +218,88 @@ static int TableCacheSize(const Options& sanitized_options) {
   return sanitized_options.max_open_files - kNumNonTableCacheFiles;
 }
 
+// Runs the partitions of parallel flushes on up to "max_threads" threads
+// that are started on demand and kept for later flushes.
+class FlushThreadPool {
+ public:
+  FlushThreadPool(Env* env, int max_threads)
+      : env_(env),
+        max_threads_(max_threads),
+        work_cv_(&mu_),
+        exit_cv_(&mu_),
+        threads_(0),
+        busy_threads_(0),
+        shutting_down_(false) {}
+
+  FlushThreadPool(const FlushThreadPool&) = delete;
+  FlushThreadPool& operator=(const FlushThreadPool&) = delete;
+
+  // Waits for the threads to finish their work and exit.
+  ~FlushThreadPool() {
+    MutexLock l(&mu_);
+    shutting_down_ = true;
+    work_cv_.SignalAll();
+    while (threads_ > 0) {
+      exit_cv_.Wait();
+    }
+  }
+
+  void Schedule(void (*function)(void*), void* arg) {
+    MutexLock l(&mu_);
+    queue_.push_back(Work{function, arg});
+    if (queue_.size() > static_cast<size_t>(threads_ - busy_threads_) &&
+        threads_ < max_threads_) {
+      threads_++;
+      env_->StartThread(&FlushThreadPool::ThreadMain, this);
+    } else {
+      work_cv_.Signal();
+    }
+  }
+
+ private:
+  struct Work {
+    void (*function)(void*);
+    void* arg;
+  };
+
+  static void ThreadMain(void* pool) {
+    reinterpret_cast<FlushThreadPool*>(pool)->Run();
+  }
+
+  void Run() {
+    MutexLock l(&mu_);
+    while (true) {
+      while (queue_.empty() && !shutting_down_) {
+        work_cv_.Wait();
+      }
+      if (queue_.empty()) {
+        break;
+      }
+      const Work work = queue_.front();
+      queue_.pop_front();
+      busy_threads_++;
+      mu_.Unlock();
+      (*work.function)(work.arg);
+      mu_.Lock();
+      busy_threads_--;
+    }
+    if (--threads_ == 0) {
+      exit_cv_.SignalAll();
+    }
+  }
+
+  Env* const env_;
+  const int max_threads_;
+
+  port::Mutex mu_;
+  port::CondVar work_cv_ GUARDED_BY(mu_);
+  port::CondVar exit_cv_ GUARDED_BY(mu_);
+  std::deque<Work> queue_ GUARDED_BY(mu_);
+  int threads_ GUARDED_BY(mu_);
+  int busy_threads_ GUARDED_BY(mu_);  // Threads running a piece of work
+  bool shutting_down_ GUARDED_BY(mu_);
+};
+
 DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
     : env_(raw_options.env),
       internal_comparator_(raw_options.comparator),
@@ -133,23 +310,48 @@ DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
       owns_cache_(options_.block_cache != raw_options.block_cache),
       dbname_(dbname),
       table_cache_(new TableCache(dbname_, options_, TableCacheSize(options_))),
+      flush_pool_(options_.flush_parallelism > 1
+                      ? new FlushThreadPool(env_,
+                                            options_.flush_parallelism - 1)
+                      : nullptr),
       db_lock_(nullptr),
       shutting_down_(false),
       background_work_finished_signal_(&mutex_),
       mem_(nullptr),
-      imm_(nullptr),
       has_imm_(false),
+      mem_has_unlogged_writes_(false),
       logfile_(nullptr),
       logfile_number_(0),
       log_(nullptr),
       seed_(0),
       tmp_batch_(new WriteBatch),
+      num_live_iterators_(0),
+      num_running_gets_(0),
+      inplace_write_running_(false),
+      inplace_write_finished_signal_(&mutex_),
       background_compaction_scheduled_(false),
       manual_compaction_(nullptr),
       versions_(new VersionSet(dbname_, &options_, table_cache_,
                                &internal_comparator_)) {}
 
 DBImpl::~DBImpl() {
+  // Writes that skipped the log only exist in memory, so persist them
+  // before shutting down.
+  mutex_.Lock();
+  bool flush_unlogged_writes = mem_has_unlogged_writes_;
+  for (const ImmutableMemTable& imm : imm_) {
+    flush_unlogged_writes |= imm.has_unlogged_writes;
+  }
+  flush_unlogged_writes &= bg_error_.ok();
+  mutex_.Unlock();
+  if (flush_unlogged_writes) {
+    Status s = FlushMemTable();
+    if (!s.ok()) {
+      Log(options_.info_log, "Flushing unlogged writes failed: %s",
+          s.ToString().c_str());
+    }
+  }
+
   // Wait for background work to finish.
   mutex_.Lock();
   shutting_down_.store(true, std::memory_order_release);
@@ -164,11 +366,14 @@ DBImpl::~DBImpl() {
 
   delete versions_;
   if (mem_ != nullptr) mem_->Unref();
-  if (imm_ != nullptr) imm_->Unref();
+  for (const ImmutableMemTable& imm : imm_) {
+    imm.mem->Unref();
+  }
   delete tmp_batch_;
   delete log_;
   delete logfile_;
   delete table_cache_;
+  delete flush_pool_;
 
   if (owns_info_log_) {
     delete options_.info_log;
@@ -184,6 +389,7 @@ Status DBImpl::NewDB() {
   new_db.SetLogNumber(0);
   new_db.SetNextFile(2);
   new_db.SetLastSequence(0);
+  new_db.SetNumLevels(options_.num_levels);
 
   const std::string manifest = DescriptorFileName(dbname_, 1);
   WritableFile* file;
@@ -438,10 +644,11 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
     WriteBatchInternal::SetContents(&batch, record);
 
     if (mem == nullptr) {
-      mem = new MemTable(internal_comparator_);
+      mem = new MemTable(internal_comparator_, options_);
       mem->Ref();
     }
-    status = WriteBatchInternal::InsertInto(&batch, mem);
+    status = WriteBatchInternal::InsertInto(&batch, mem,
+                                            options_.inplace_update_support);
     MaybeIgnoreError(&status);
     if (!status.ok()) {
       break;
@@ -452,7 +659,7 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
       *max_sequence = last_seq;
     }
 
-    if (mem->ApproximateMemoryUsage() > options_.write_buffer_size) {
+    if (MemTableIsFull(mem)) {
       compactions++;
       *save_manifest = true;
       status = WriteLevel0Table(mem, edit, nullptr);
@@ -477,14 +684,15 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
     if (env_->GetFileSize(fname, &lfile_size).ok() &&
         env_->NewAppendableFile(fname, &logfile_).ok()) {
       Log(options_.info_log, "Reusing old log %s \n", fname.c_str());
-      log_ = new log::Writer(logfile_, lfile_size);
+      log_ = new log::Writer(logfile_, lfile_size, options_.wal_compression,
+                             options_.zstd_compression_level);
       logfile_number_ = log_number;
       if (mem != nullptr) {
         mem_ = mem;
         mem = nullptr;
       } else {
         // mem can be nullptr if lognum exists but was empty.
-        mem_ = new MemTable(internal_comparator_);
+        mem_ = new MemTable(internal_comparator_, options_);
         mem_->Ref();
       }
     }
@@ -504,19 +712,238 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
 
 Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
                                 Version* base) {
+  return WriteLevel0Table(&mem, 1, edit, base);
+}
+
+namespace {
+
+// A flush is only split into partitions of at least this many bytes of
+// memtable, so that small flushes do not produce tiny tables.
+const size_t kMinFlushPartitionBytes = 1 << 20;
+
+// Add the range tombstones of "mem" to *list.
+Status AddMemTableRangeTombstones(MemTable* mem, RangeTombstoneList* list) {
+  Iterator* iter = mem->NewRangeTombstoneIterator();
+  if (iter == nullptr) {
+    return Status::OK();
+  }
+  Status s = list->AddAll(iter);
+  delete iter;
+  return s;
+}
+
+// Store in *tombstones the range tombstones of mems[0..n-1] that lie in
+// [*start, *limit), sorted as BuildTable() expects.  A null bound leaves
+// that side of the range open.
+Status CollectFlushRangeTombstones(const InternalKeyComparator& icmp,
+                                   MemTable* const* mems, int n,
+                                   const std::string* start,
+                                   const std::string* limit,
+                                   std::vector<RangeTombstone>* tombstones) {
+  RangeTombstoneList list(icmp.user_comparator());
+  for (int i = 0; i < n; i++) {
+    Status s = AddMemTableRangeTombstones(mems[i], &list);
+    if (!s.ok()) {
+      return s;
+    }
+  }
+  for (RangeTombstone t : list.tombstones()) {
+    if (ClipRangeTombstone(icmp.user_comparator(), start, limit, &t)) {
+      tombstones->push_back(t);
+    }
+  }
+  SortRangeTombstones(icmp, tombstones);
+  return Status::OK();
+}
+
+Iterator* NewMemTablesIterator(const InternalKeyComparator* icmp,
+                               MemTable* const* mems, int n) {
+  std::vector<Iterator*> list;
+  for (int i = 0; i < n; i++) {
+    list.push_back(mems[i]->NewIterator());
+  }
+  return NewMergingIterator(icmp, &list[0], n);
+}
+
+// Yields the entries of an internal key iterator whose user keys are in
+// [*start, *limit).  A null bound leaves that side of the range open.
+class KeyRangeIterator : public Iterator {
+ public:
+  // Takes ownership of "iter".
+  KeyRangeIterator(const Comparator* ucmp, Iterator* iter,
+                   const std::string* start, const std::string* limit)
+      : ucmp_(ucmp), iter_(iter), start_(start), limit_(limit) {}
+
+  ~KeyRangeIterator() override { delete iter_; }
+
+  bool Valid() const override {
+    if (!iter_->Valid()) {
+      return false;
+    }
+    const Slice user_key = ExtractUserKey(iter_->key());
+    return (start_ == nullptr || ucmp_->Compare(user_key, *start_) >= 0) &&
+           (limit_ == nullptr || ucmp_->Compare(user_key, *limit_) < 0);
+  }
+  void SeekToFirst() override {
+    if (start_ == nullptr) {
+      iter_->SeekToFirst();
+    } else {
+      InternalKey ikey(*start_, kMaxSequenceNumber, kValueTypeForSeek);
+      iter_->Seek(ikey.Encode());
+    }
+  }
+  void SeekToLast() override {
+    if (limit_ == nullptr) {
+      iter_->SeekToLast();
+      return;
+    }
+    InternalKey ikey(*limit_, kMaxSequenceNumber, kValueTypeForSeek);
+    iter_->Seek(ikey.Encode());
+    if (iter_->Valid()) {
+      iter_->Prev();
+    } else {
+      iter_->SeekToLast();
+    }
+  }
+  void Seek(const Slice& target) override {
+    if (start_ != nullptr &&
+        ucmp_->Compare(ExtractUserKey(target), *start_) < 0) {
+      SeekToFirst();
+    } else {
+      iter_->Seek(target);
+    }
+  }
+  void Next() override { iter_->Next(); }
+  void Prev() override { iter_->Prev(); }
+  Slice key() const override { return iter_->key(); }
+  Slice value() const override { return iter_->value(); }
+  Status status() const override { return iter_->status(); }
+
+ private:
+  const Comparator* const ucmp_;
+  Iterator* const iter_;
+  const std::string* const start_;
+  const std::string* const limit_;
+};
+
+// Store in *splits up to partitions-1 user keys that divide the
+// "num_entries" entries of *iter into ranges of about equal count.  Entries
+// for one user key are never divided.  The scan stops at the last split,
+// and only reads keys.
+void ChooseFlushSplits(const Comparator* ucmp, Iterator* iter,
+                       uint64_t num_entries, int partitions,
+                       std::vector<std::string>* splits) {
+  uint64_t entries = 0;
+  uint64_t next_split_entries = num_entries / partitions;
+  bool split_pending = false;
+  std::string last_user_key;  // Valid iff split_pending
+  for (iter->SeekToFirst();
+       iter->Valid() && splits->size() < static_cast<size_t>(partitions - 1);
+       iter->Next()) {
+    const Slice user_key = ExtractUserKey(iter->key());
+    if (split_pending && ucmp->Compare(user_key, last_user_key) != 0) {
+      splits->push_back(user_key.ToString());
+      split_pending = false;
+      next_split_entries = num_entries * (splits->size() + 1) / partitions;
+    }
+    entries++;
+    if (!split_pending && entries >= next_split_entries) {
+      split_pending = true;
+      last_user_key.assign(user_key.data(), user_key.size());
+    }
+  }
+}
+
+struct ParallelFlushState {
+  ParallelFlushState(const std::string& dbname, Env* env,
+                     const Options& options, TableCache* table_cache)
+      : dbname(dbname),
+        env(env),
+        options(options),
+        table_cache(table_cache),
+        done_cv(&mu),
+        remaining(0) {}
+
+  const std::string& dbname;
+  Env* const env;
+  const Options& options;
+  TableCache* const table_cache;
+
+  port::Mutex mu;
+  port::CondVar done_cv;
+  int remaining GUARDED_BY(mu);  // Jobs still running on other threads
+};
+
+// One table of a parallel flush.
+struct FlushJob {
+  ParallelFlushState* state;
+  Iterator* iter;
+  std::vector<RangeTombstone> range_dels;
+  FileMetaData meta;
+  uint64_t micros;
+  Status status;
+};
+
+void RunFlushJob(FlushJob* job) {
+  if (!job->status.ok()) {
+    return;  // Its range tombstones could not be collected
+  }
+  ParallelFlushState* state = job->state;
+  const uint64_t start_micros = state->env->NowMicros();
+  job->status = BuildTable(state->dbname, state->env, state->options,
+                           state->table_cache, job->iter, job->range_dels,
+                           &job->meta);
+  job->micros = state->env->NowMicros() - start_micros;
+}
+
+void FlushJobThread(void* arg) {
+  FlushJob* job = reinterpret_cast<FlushJob*>(arg);
+  RunFlushJob(job);
+  ParallelFlushState* state = job->state;
+  MutexLock l(&state->mu);
+  if (--state->remaining == 0) {
+    state->done_cv.Signal();
+  }
+}
+
+}  // namespace
+
+Status DBImpl::WriteLevel0Table(MemTable* const* mems, int n,
+                                VersionEdit* edit, Version* base) {
   mutex_.AssertHeld();
+  assert(n > 0);
+  if (options_.flush_parallelism > 1) {
+    size_t bytes = 0;
+    for (int i = 0; i < n; i++) {
+      bytes += mems[i]->ApproximateMemoryUsage();
+    }
+    const size_t partitions =
+        std::min<size_t>(options_.flush_parallelism,
+                         bytes / kMinFlushPartitionBytes);
+    if (partitions > 1) {
+      return WriteLevel0TablesInParallel(mems, n, static_cast<int>(partitions),
+                                         edit, base);
+    }
+  }
+
   const uint64_t start_micros = env_->NowMicros();
   FileMetaData meta;
   meta.number = versions_->NewFileNumber();
   pending_outputs_.insert(meta.number);
-  Iterator* iter = mem->NewIterator();
+  Iterator* iter = NewMemTablesIterator(&internal_comparator_, mems, n);
   Log(options_.info_log, "Level-0 table #%llu: started",
       (unsigned long long)meta.number);
 
   Status s;
   {
     mutex_.Unlock();
-    s = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta);
+    std::vector<RangeTombstone> range_dels;
+    s = CollectFlushRangeTombstones(internal_comparator_, mems, n, nullptr,
+                                    nullptr, &range_dels);
+    if (s.ok()) {
+      s = BuildTable(dbname_, env_, options_, table_cache_, iter, range_dels,
+                     &meta);
+    }
     mutex_.Lock();
   }
 
@@ -535,8 +962,7 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
     if (base != nullptr) {
       level = base->PickLevelForMemTableOutput(min_user_key, max_user_key);
     }
-    edit->AddFile(level, meta.number, meta.file_size, meta.smallest,
-                  meta.largest);
+    edit->AddFile(level, meta);
   }
 
   CompactionStats stats;
@@ -546,15 +972,109 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
   return s;
 }
 
+Status DBImpl::WriteLevel0TablesInParallel(MemTable* const* mems, int n,
+                                           int partitions, VersionEdit* edit,
+                                           Version* base) {
+  mutex_.AssertHeld();
+  std::vector<std::string> splits;
+  {
+    mutex_.Unlock();
+    uint64_t num_entries = 0;
+    for (int i = 0; i < n; i++) {
+      num_entries += mems[i]->NumEntries();
+    }
+    Iterator* iter = NewMemTablesIterator(&internal_comparator_, mems, n);
+    ChooseFlushSplits(user_comparator(), iter, num_entries, partitions,
+                      &splits);
+    delete iter;
+    mutex_.Lock();
+  }
+
+  ParallelFlushState state(dbname_, env_, options_, table_cache_);
+  std::vector<FlushJob> jobs(splits.size() + 1);
+  for (size_t i = 0; i < jobs.size(); i++) {
+    FlushJob* job = &jobs[i];
+    const std::string* start = i > 0 ? &splits[i - 1] : nullptr;
+    const std::string* limit = i < splits.size() ? &splits[i] : nullptr;
+    job->state = &state;
+    job->iter = new KeyRangeIterator(
+        user_comparator(), NewMemTablesIterator(&internal_comparator_, mems, n),
+        start, limit);
+    job->status = CollectFlushRangeTombstones(internal_comparator_, mems, n,
+                                              start, limit, &job->range_dels);
+    job->meta.number = versions_->NewFileNumber();
+    job->micros = 0;
+    pending_outputs_.insert(job->meta.number);
+    Log(options_.info_log, "Level-0 table #%llu: started (partition %d/%d)",
+        (unsigned long long)job->meta.number, static_cast<int>(i + 1),
+        static_cast<int>(jobs.size()));
+  }
+
+  {
+    mutex_.Unlock();
+    state.mu.Lock();
+    state.remaining = static_cast<int>(jobs.size()) - 1;
+    state.mu.Unlock();
+    for (size_t i = 1; i < jobs.size(); i++) {
+      flush_pool_->Schedule(&FlushJobThread, &jobs[i]);
+    }
+    RunFlushJob(&jobs[0]);
+    state.mu.Lock();
+    while (state.remaining > 0) {
+      state.done_cv.Wait();
+    }
+    state.mu.Unlock();
+    mutex_.Lock();
+  }
+
+  Status s;
+  for (size_t i = 0; i < jobs.size(); i++) {
+    FlushJob* job = &jobs[i];
+    const FileMetaData& meta = job->meta;
+    Log(options_.info_log, "Level-0 table #%llu: %lld bytes %s",
+        (unsigned long long)meta.number, (unsigned long long)meta.file_size,
+        job->status.ToString().c_str());
+    delete job->iter;
+    pending_outputs_.erase(meta.number);
+    if (s.ok()) {
+      s = job->status;
+    }
+
+    // The partitions do not overlap, so each can be placed on its own.
+    int level = 0;
+    if (job->status.ok() && meta.file_size > 0) {
+      if (base != nullptr) {
+        level = base->PickLevelForMemTableOutput(meta.smallest.user_key(),
+                                                 meta.largest.user_key());
+      }
+      edit->AddFile(level, meta);
+    }
+
+    CompactionStats stats;
+    stats.micros = job->micros;
+    stats.bytes_written = meta.file_size;
+    stats_[level].Add(stats);
+  }
+  return s;
+}
+
 void DBImpl::CompactMemTable() {
   mutex_.AssertHeld();
-  assert(imm_ != nullptr);
+  assert(!imm_.empty());
 
-  // Save the contents of the memtable as a new Table
+  // Save the contents of the oldest memtable (or of all queued memtables)
+  // as a new Table.  Memtables queued while this runs are left for the
+  // next flush.
+  const size_t n = options_.merge_immutable_memtables ? imm_.size() : 1;
+  std::vector<MemTable*> mems;
+  for (size_t i = 0; i < n; i++) {
+    mems.push_back(imm_[i].mem);
+  }
+  const uint64_t next_log_number = imm_[n - 1].next_log_number;
   VersionEdit edit;
   Version* base = versions_->current();
   base->Ref();
-  Status s = WriteLevel0Table(imm_, &edit, base);
+  Status s = WriteLevel0Table(&mems[0], static_cast<int>(n), &edit, base);
   base->Unref();
 
   if (s.ok() && shutting_down_.load(std::memory_order_acquire)) {
@@ -564,15 +1084,17 @@ void DBImpl::CompactMemTable() {
   // Replace immutable memtable with the generated Table
   if (s.ok()) {
     edit.SetPrevLogNumber(0);
-    edit.SetLogNumber(logfile_number_);  // Earlier logs no longer needed
+    edit.SetLogNumber(next_log_number);  // Earlier logs no longer needed
     s = versions_->LogAndApply(&edit, &mutex_);
   }
 
   if (s.ok()) {
     // Commit to the new state
-    imm_->Unref();
-    imm_ = nullptr;
-    has_imm_.store(false, std::memory_order_release);
+    for (size_t i = 0; i < n; i++) {
+      imm_.front().mem->Unref();
+      imm_.pop_front();
+    }
+    has_imm_.store(!imm_.empty(), std::memory_order_release);
     RemoveObsoleteFiles();
   } else {
     RecordBackgroundError(s);
@@ -584,7 +1106,7 @@ void DBImpl::CompactRange(const Slice* begin, const Slice* end) {
   {
     MutexLock l(&mutex_);
     Version* base = versions_->current();
-    for (int level = 1; level < config::kNumLevels; level++) {
+    for (int level = 1; level < options_.num_levels; level++) {
       if (base->OverlapInLevel(level, begin, end)) {
         max_level_with_files = level;
       }
@@ -596,10 +1118,96 @@ void DBImpl::CompactRange(const Slice* begin, const Slice* end) {
   }
 }
 
+// Parse "value" into *result.  Returns false if it is not a number in
+// range of the type of *result.
+static bool ParseOptionValue(const std::string& value, uint64_t* result) {
+  Slice in(value);
+  return ConsumeDecimalNumber(&in, result) && in.empty();
+}
+
+static bool ParseOptionValue(const std::string& value, int* result) {
+  uint64_t v;
+  if (!ParseOptionValue(value, &v) || v > (1u << 30)) {
+    return false;
+  }
+  *result = static_cast<int>(v);
+  return true;
+}
+
+static bool ParseOptionValue(const std::string& value, double* result) {
+  char* end;
+  *result = std::strtod(value.c_str(), &end);
+  return !value.empty() && *end == '\0';
+}
+
+Status DBImpl::SetOptions(const std::map<std::string, std::string>& options) {
+  MutexLock l(&mutex_);
+  Options updated = options_;
+  for (const auto& option : options) {
+    const std::string& name = option.first;
+    bool ok;
+    if (name == "level0_file_num_compaction_trigger") {
+      ok = ParseOptionValue(option.second,
+                            &updated.level0_file_num_compaction_trigger);
+    } else if (name == "max_mem_compaction_level") {
+      ok = ParseOptionValue(option.second, &updated.max_mem_compaction_level);
+    } else if (name == "max_bytes_for_level_base") {
+      ok = ParseOptionValue(option.second, &updated.max_bytes_for_level_base);
+    } else if (name == "max_bytes_for_level_multiplier") {
+      ok = ParseOptionValue(option.second,
+                            &updated.max_bytes_for_level_multiplier);
+    } else if (name == "level0_slowdown_writes_trigger") {
+      ok = ParseOptionValue(option.second,
+                            &updated.level0_slowdown_writes_trigger);
+    } else if (name == "level0_stop_writes_trigger") {
+      ok = ParseOptionValue(option.second, &updated.level0_stop_writes_trigger);
+    } else if (name == "soft_pending_compaction_bytes_limit") {
+      ok = ParseOptionValue(option.second,
+                            &updated.soft_pending_compaction_bytes_limit);
+    } else if (name == "hard_pending_compaction_bytes_limit") {
+      ok = ParseOptionValue(option.second,
+                            &updated.hard_pending_compaction_bytes_limit);
+    } else if (name == "delayed_write_rate") {
+      ok = ParseOptionValue(option.second, &updated.delayed_write_rate);
+    } else {
+      return Status::InvalidArgument("option cannot be changed", name);
+    }
+    if (!ok) {
+      return Status::InvalidArgument(name, "invalid value " + option.second);
+    }
+  }
+  SanitizeMutableOptions(&updated);
+
+  options_.level0_file_num_compaction_trigger =
+      updated.level0_file_num_compaction_trigger;
+  options_.max_mem_compaction_level = updated.max_mem_compaction_level;
+  options_.max_bytes_for_level_base = updated.max_bytes_for_level_base;
+  options_.max_bytes_for_level_multiplier =
+      updated.max_bytes_for_level_multiplier;
+  options_.level0_slowdown_writes_trigger =
+      updated.level0_slowdown_writes_trigger;
+  options_.level0_stop_writes_trigger = updated.level0_stop_writes_trigger;
+  options_.soft_pending_compaction_bytes_limit =
+      updated.soft_pending_compaction_bytes_limit;
+  options_.hard_pending_compaction_bytes_limit =
+      updated.hard_pending_compaction_bytes_limit;
+  options_.delayed_write_rate = updated.delayed_write_rate;
+  for (const auto& option : options) {
+    Log(options_.info_log, "SetOptions: %s = %s", option.first.c_str(),
+        option.second.c_str());
+  }
+
+  // Compactions and stalled writes depend on the new values.
+  versions_->UpdateCompactionScore();
+  MaybeScheduleCompaction();
+  background_work_finished_signal_.SignalAll();
+  return Status::OK();
+}
+
 void DBImpl::TEST_CompactRange(int level, const Slice* begin,
                                const Slice* end) {
   assert(level >= 0);
-  assert(level + 1 < config::kNumLevels);
+  assert(level + 1 < options_.num_levels);
 
   InternalKey begin_storage, end_storage;
 
@@ -635,16 +1243,18 @@ void DBImpl::TEST_CompactRange(int level, const Slice* begin,
   }
 }
 
-Status DBImpl::TEST_CompactMemTable() {
+Status DBImpl::TEST_CompactMemTable() { return FlushMemTable(); }
+
+Status DBImpl::FlushMemTable() {
   // nullptr batch means just wait for earlier writes to be done
   Status s = Write(WriteOptions(), nullptr);
   if (s.ok()) {
     // Wait until the compaction completes
     MutexLock l(&mutex_);
-    while (imm_ != nullptr && bg_error_.ok()) {
+    while (!imm_.empty() && bg_error_.ok()) {
       background_work_finished_signal_.Wait();
     }
-    if (imm_ != nullptr) {
+    if (!imm_.empty()) {
       s = bg_error_;
     }
   }
@@ -667,7 +1277,7 @@ void DBImpl::MaybeScheduleCompaction() {
     // DB is being deleted; no more background compactions
   } else if (!bg_error_.ok()) {
     // Already got an error; no more changes
-  } else if (imm_ == nullptr && manual_compaction_ == nullptr &&
+  } else if (imm_.empty() && manual_compaction_ == nullptr &&
              !versions_->NeedsCompaction()) {
     // No work to be done
   } else {
@@ -702,7 +1312,7 @@ void DBImpl::BackgroundCall() {
 void DBImpl::BackgroundCompaction() {
   mutex_.AssertHeld();
 
-  if (imm_ != nullptr) {
+  if (!imm_.empty()) {
     CompactMemTable();
     return;
   }
@@ -713,7 +1323,8 @@ void DBImpl::BackgroundCompaction() {
   if (is_manual) {
     ManualCompaction* m = manual_compaction_;
     c = versions_->CompactRange(m->level, m->begin, m->end);
-    m->done = (c == nullptr);
+    // A universal compaction merges all of level-0 at once.
+    m->done = (c == nullptr || c->output_level() == 0);
     if (c != nullptr) {
       manual_end = c->input(0, c->num_input_files(0) - 1)->largest;
     }
@@ -734,15 +1345,14 @@ void DBImpl::BackgroundCompaction() {
     assert(c->num_input_files(0) == 1);
     FileMetaData* f = c->input(0, 0);
     c->edit()->RemoveFile(c->level(), f->number);
-    c->edit()->AddFile(c->level() + 1, f->number, f->file_size, f->smallest,
-                       f->largest);
+    c->edit()->AddFile(c->output_level(), *f);
     status = versions_->LogAndApply(c->edit(), &mutex_);
     if (!status.ok()) {
       RecordBackgroundError(status);
     }
     VersionSet::LevelSummaryStorage tmp;
     Log(options_.info_log, "Moved #%lld to level-%d %lld bytes %s: %s\n",
-        static_cast<unsigned long long>(f->number), c->level() + 1,
+        static_cast<unsigned long long>(f->number), c->output_level(),
         static_cast<unsigned long long>(f->file_size),
         status.ToString().c_str(), versions_->LevelSummary(&tmp));
   } else {
@@ -794,6 +1404,9 @@ void DBImpl::CleanupCompaction(CompactionState* compact) {
     const CompactionState::Output& out = compact->outputs[i];
     pending_outputs_.erase(out.number);
   }
+  if (compact->reserved_number != 0) {
+    pending_outputs_.erase(compact->reserved_number);
+  }
   delete compact;
 }
 
@@ -803,12 +1416,22 @@ Status DBImpl::OpenCompactionOutputFile(CompactionState* compact) {
   uint64_t file_number;
   {
     mutex_.Lock();
-    file_number = versions_->NewFileNumber();
-    pending_outputs_.insert(file_number);
+    if (compact->reserved_number != 0) {
+      file_number = compact->reserved_number;
+      compact->reserved_number = 0;
+    } else {
+      file_number = versions_->NewFileNumber();
+      pending_outputs_.insert(file_number);
+    }
     CompactionState::Output out;
     out.number = file_number;
     out.smallest.Clear();
     out.largest.Clear();
+    out.has_range_deletions = false;
+    out.num_entries = 0;
+    out.num_deletions = 0;
+    out.smallest_seq = kMaxSequenceNumber;
+    out.largest_seq = 0;
     compact->outputs.push_back(out);
     mutex_.Unlock();
   }
@@ -817,30 +1440,63 @@ Status DBImpl::OpenCompactionOutputFile(CompactionState* compact) {
   std::string fname = TableFileName(dbname_, file_number);
   Status s = env_->NewWritableFile(fname, &compact->outfile);
   if (s.ok()) {
+    compact->outfile = NewRateLimitedWritableFile(
+        compact->outfile, options_.rate_limiter, RateLimiter::kIOLow);
     compact->builder = new TableBuilder(options_, compact->outfile);
   }
   return s;
 }
 
 Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
-                                          Iterator* input) {
+                                          Iterator* input,
+                                          const Slice* next_user_key) {
   assert(compact != nullptr);
   assert(compact->outfile != nullptr);
   assert(compact->builder != nullptr);
 
-  const uint64_t output_number = compact->current_output()->number;
+  CompactionState::Output* const out = compact->current_output();
+  const uint64_t output_number = out->number;
   assert(output_number != 0);
 
+  const uint64_t current_entries = compact->builder->NumEntries();
+  if (!compact->range_dels.empty()) {
+    const std::string upper =
+        next_user_key != nullptr ? next_user_key->ToString() : std::string();
+    std::vector<RangeTombstone> range_dels;
+    for (RangeTombstone t : compact->range_dels) {
+      if (ClipRangeTombstone(
+              user_comparator(),
+              compact->has_range_del_lower ? &compact->range_del_lower
+                                           : nullptr,
+              next_user_key != nullptr ? &upper : nullptr, &t)) {
+        range_dels.push_back(t);
+      }
+    }
+    if (!range_dels.empty()) {
+      SortRangeTombstones(internal_comparator_, &range_dels);
+      AddRangeTombstonesToTable(internal_comparator_, range_dels,
+                                current_entries > 0, compact->builder,
+                                &out->smallest, &out->largest);
+      out->has_range_deletions = true;
+    }
+    compact->range_del_lower = upper;
+    compact->has_range_del_lower = true;
+  }
+
+  if (current_entries > 0) {
+    compact->builder->SetEntryStats(out->num_deletions, out->smallest_seq,
+                                    out->largest_seq);
+  }
+
   // Check for iterator errors
   Status s = input->status();
-  const uint64_t current_entries = compact->builder->NumEntries();
   if (s.ok()) {
     s = compact->builder->Finish();
   } else {
     compact->builder->Abandon();
   }
   const uint64_t current_bytes = compact->builder->FileSize();
-  compact->current_output()->file_size = current_bytes;
+  out->file_size = current_bytes;
   compact->total_bytes += current_bytes;
   delete compact->builder;
   compact->builder = nullptr;
@@ -855,7 +1511,7 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
   delete compact->outfile;
   compact->outfile = nullptr;
 
-  if (s.ok() && current_entries > 0) {
+  if (s.ok() && (current_entries > 0 || out->has_range_deletions)) {
     // Verify that the table is usable
     Iterator* iter =
         table_cache_->NewIterator(ReadOptions(), output_number, current_bytes);
@@ -875,20 +1531,167 @@ Status DBImpl::InstallCompactionResults(CompactionState* compact) {
   mutex_.AssertHeld();
   Log(options_.info_log, "Compacted %d@%d + %d@%d files => %lld bytes",
       compact->compaction->num_input_files(0), compact->compaction->level(),
-      compact->compaction->num_input_files(1), compact->compaction->level() + 1,
+      compact->compaction->num_input_files(1),
+      compact->compaction->output_level(),
       static_cast<long long>(compact->total_bytes));
 
   // Add compaction outputs
   compact->compaction->AddInputDeletions(compact->compaction->edit());
-  const int level = compact->compaction->level();
+  const int level = compact->compaction->output_level();
+  const uint64_t now = env_->NowMicros() / 1000000;
   for (size_t i = 0; i < compact->outputs.size(); i++) {
     const CompactionState::Output& out = compact->outputs[i];
-    compact->compaction->edit()->AddFile(level + 1, out.number, out.file_size,
-                                         out.smallest, out.largest);
+    FileMetaData f;
+    f.number = out.number;
+    f.file_size = out.file_size;
+    f.smallest = out.smallest;
+    f.largest = out.largest;
+    f.has_range_deletions = out.has_range_deletions;
+    f.num_entries = out.num_entries;
+    f.num_deletions = out.num_deletions;
+    f.creation_time = now;
+    compact->compaction->edit()->AddFile(level, f);
   }
   return versions_->LogAndApply(compact->compaction->edit(), &mutex_);
 }
 
+// Add the range tombstones of the compaction inputs to *range_dels and
+// keep in compact->range_dels those that must be written to the output.
+Status DBImpl::CollectCompactionRangeTombstones(
+    CompactionState* compact, RangeTombstoneList* range_dels) {
+  Compaction* const c = compact->compaction;
+  for (int which = 0; which < 2; which++) {
+    for (int i = 0; i < c->num_input_files(which); i++) {
+      const FileMetaData* f = c->input(which, i);
+      if (f->has_range_deletions) {
+        Status s =
+            table_cache_->AddRangeTombstones(f->number, f->file_size,
+                                             range_dels);
+        if (!s.ok()) {
+          return s;
+        }
+      }
+    }
+  }
+  range_dels->Finish();
+
+  for (const RangeTombstone& t : range_dels->tombstones()) {
+    // A tombstone seen by every snapshot has deleted all it covers in the
+    // inputs, and may go once no older data can lie below the output.
+    if (t.seq > compact->smallest_snapshot ||
+        !c->IsBaseLevelForRange(t.begin, t.end)) {
+      compact->range_dels.push_back(t);
+    }
+  }
+  SortRangeTombstones(internal_comparator_, &compact->range_dels);
+  return Status::OK();
+}
+
+Status DBImpl::AddCompactionOutputEntry(CompactionState* compact,
+                                        Iterator* input, const Slice& key,
+                                        const Slice& value,
+                                        bool* finish_pending) {
+  Status status;
+  // With range tombstones, entries for one user key must stay in one
+  // output: the tombstones of the next output start at its first
+  // user key.
+  const Slice user_key = ExtractUserKey(key);
+  if (*finish_pending &&
+      (compact->range_dels.empty() ||
+       user_comparator()->Compare(
+           user_key, compact->current_output()->largest.user_key()) != 0)) {
+    *finish_pending = false;
+    status = FinishCompactionOutputFile(compact, input, &user_key);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+
+  // Open output file if necessary
+  if (compact->builder == nullptr) {
+    status = OpenCompactionOutputFile(compact);
+    if (!status.ok()) {
+      return status;
+    }
+  }
+  CompactionState::Output* const out = compact->current_output();
+  if (compact->builder->NumEntries() == 0) {
+    out->smallest.DecodeFrom(key);
+  }
+  out->largest.DecodeFrom(key);
+  compact->builder->Add(key, value);
+  out->num_entries++;
+  ParsedInternalKey ikey;
+  if (ParseInternalKey(key, &ikey)) {
+    if (ikey.type == kTypeDeletion) {
+      out->num_deletions++;
+    }
+    out->smallest_seq = std::min(out->smallest_seq, ikey.sequence);
+    out->largest_seq = std::max(out->largest_seq, ikey.sequence);
+  }
+
+  // Close output file if it is big enough
+  if (compact->builder->FileSize() >=
+      compact->compaction->MaxOutputFileSize()) {
+    *finish_pending = true;
+  }
+  return status;
+}
+
+Status DBImpl::WriteCompactionMerges(CompactionState* compact,
+                                     Iterator* input, bool combine,
+                                     const Slice* existing_value,
+                                     bool* combined, bool* finish_pending) {
+  Status status;
+  *combined = false;
+  if (combine) {
+    ParsedInternalKey newest;
+    std::string value;
+    if (ParseInternalKey(compact->merge_keys[0], &newest) &&
+        FullMerge(options_.merge_operator, newest.user_key, existing_value,
+                  compact->merge_operands, &value)
+            .ok()) {
+      // The result takes the place of the newest operand.
+      std::string key;
+      AppendInternalKey(&key, ParsedInternalKey(newest.user_key,
+                                                newest.sequence, kTypeValue));
+      status = AddCompactionOutputEntry(compact, input, key, value,
+                                        finish_pending);
+      *combined = true;
+    }
+    // Operands that cannot be combined are kept as they are, so that
+    // reads of the key report the failure.
+  }
+  for (size_t i = 0; !*combined && status.ok() &&
+                     i < compact->merge_keys.size();
+       i++) {
+    status = AddCompactionOutputEntry(compact, input, compact->merge_keys[i],
+                                      compact->merge_operands[i],
+                                      finish_pending);
+  }
+  compact->merge_keys.clear();
+  compact->merge_operands.clear();
+  return status;
+}
+
+Status DBImpl::FinishCompactionMerge(CompactionState* compact,
+                                     Iterator* input,
+                                     const RangeTombstoneList& range_dels,
+                                     bool* finish_pending) {
+  // No older entry of the key was found.  If none survives below the
+  // compaction either, and no range tombstone comes between the
+  // operands, they apply to no value.
+  ParsedInternalKey oldest;
+  const bool combine =
+      ParseInternalKey(compact->merge_keys.back(), &oldest) &&
+      compact->compaction->IsBaseLevelForKey(oldest.user_key) &&
+      range_dels.MaxCoveringSequence(oldest.user_key, kMaxSequenceNumber) <
+          oldest.sequence;
+  bool combined;
+  return WriteCompactionMerges(compact, input, combine, nullptr, &combined,
+                               finish_pending);
+}
+
 Status DBImpl::DoCompactionWork(CompactionState* compact) {
   const uint64_t start_micros = env_->NowMicros();
   int64_t imm_micros = 0;  // Micros spent doing imm_ compactions
@@ -896,7 +1699,7 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   Log(options_.info_log, "Compacting %d@%d + %d@%d files",
       compact->compaction->num_input_files(0), compact->compaction->level(),
       compact->compaction->num_input_files(1),
-      compact->compaction->level() + 1);
+      compact->compaction->output_level());
 
   assert(versions_->NumLevelFiles(compact->compaction->level()) > 0);
   assert(compact->builder == nullptr);
@@ -905,6 +1708,17 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
     compact->smallest_snapshot = versions_->LastSequence();
   } else {
     compact->smallest_snapshot = snapshots_.oldest()->sequence_number();
+    compact->newest_snapshot = snapshots_.newest()->sequence_number();
+    if (options_.merge_operator != nullptr) {
+      snapshots_.GetAll(&compact->snapshots);
+    }
+  }
+
+  if (compact->compaction->output_level() == 0) {
+    // Level-0 files are ordered by number, and the output holds data older
+    // than any memtable flushed while the compaction runs.
+    compact->reserved_number = versions_->NewFileNumber();
+    pending_outputs_.insert(compact->reserved_number);
   }
 
   Iterator* input = versions_->MakeInputIterator(compact->compaction);
@@ -912,18 +1726,29 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   // Release mutex while we're actually doing the compaction work
   mutex_.Unlock();
 
+  RangeTombstoneList range_dels(user_comparator());
+  Status status = CollectCompactionRangeTombstones(compact, &range_dels);
+
+  const CompactionFilter* const filter = options_.compaction_filter;
+  std::string filtered_key;
+  std::string filtered_value;
+
   input->SeekToFirst();
-  Status status;
   ParsedInternalKey ikey;
   std::string current_user_key;
   bool has_current_user_key = false;
   SequenceNumber last_sequence_for_key = kMaxSequenceNumber;
-  while (input->Valid() && !shutting_down_.load(std::memory_order_acquire)) {
+  bool key_has_merge_operands = false;
+  // An output is finished only once the first key of the next one is
+  // known, since that is where its range tombstones end.
+  bool finish_pending = false;
+  while (status.ok() && input->Valid() &&
+         !shutting_down_.load(std::memory_order_acquire)) {
     // Prioritize immutable compaction work
     if (has_imm_.load(std::memory_order_relaxed)) {
       const uint64_t imm_start = env_->NowMicros();
       mutex_.Lock();
-      if (imm_ != nullptr) {
+      if (!imm_.empty()) {
         CompactMemTable();
         // Wake up MakeRoomForWrite() if necessary.
         background_work_finished_signal_.SignalAll();
@@ -933,17 +1758,22 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
     }
 
     Slice key = input->key();
+    Slice value = input->value();
     if (compact->compaction->ShouldStopBefore(key) &&
         compact->builder != nullptr) {
-      status = FinishCompactionOutputFile(compact, input);
-      if (!status.ok()) {
-        break;
-      }
+      finish_pending = true;
     }
 
     // Handle key/value, add to state, etc.
     bool drop = false;
     if (!ParseInternalKey(key, &ikey)) {
+      if (!compact->merge_keys.empty()) {
+        status = FinishCompactionMerge(compact, input, range_dels,
+                                       &finish_pending);
+        if (!status.ok()) {
+          break;
+        }
+      }
       // Do not hide error keys
       current_user_key.clear();
       has_current_user_key = false;
@@ -953,9 +1783,17 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
           user_comparator()->Compare(ikey.user_key, Slice(current_user_key)) !=
               0) {
         // First occurrence of this user key
+        if (!compact->merge_keys.empty()) {
+          status = FinishCompactionMerge(compact, input, range_dels,
+                                         &finish_pending);
+          if (!status.ok()) {
+            break;
+          }
+        }
         current_user_key.assign(ikey.user_key.data(), ikey.user_key.size());
         has_current_user_key = true;
         last_sequence_for_key = kMaxSequenceNumber;
+        key_has_merge_operands = false;
       }
 
       if (last_sequence_for_key <= compact->smallest_snapshot) {
@@ -972,9 +1810,91 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
         //     few iterations of this loop (by rule (A) above).
         // Therefore this deletion marker is obsolete and can be dropped.
         drop = true;
+      } else if (range_dels.MaxCoveringSequence(
+                     ikey.user_key, compact->smallest_snapshot) >
+                 ikey.sequence) {
+        // Deleted by a range tombstone that every snapshot sees.
+        drop = true;
+      } else if (filter != nullptr && ikey.type == kTypeValue &&
+                 last_sequence_for_key == kMaxSequenceNumber &&
+                 !key_has_merge_operands &&
+                 ikey.sequence > compact->newest_snapshot &&
+                 range_dels.MaxCoveringSequence(ikey.user_key,
+                                                kMaxSequenceNumber) <
+                     ikey.sequence) {
+        // The live value of this key, which no snapshot can observe.
+        bool value_changed = false;
+        filtered_value.clear();
+        if (filter->Filter(compact->compaction->level(), ikey.user_key, value,
+                           &filtered_value, &value_changed)) {
+          if (ikey.sequence <= compact->smallest_snapshot &&
+              compact->compaction->IsBaseLevelForKey(ikey.user_key)) {
+            // Nothing older survives, as for an obsolete deletion marker.
+            drop = true;
+          } else {
+            // Older values of the key may survive in this or other
+            // levels, so hide them behind a deletion marker.
+            filtered_key.clear();
+            AppendInternalKey(&filtered_key,
+                              ParsedInternalKey(ikey.user_key, ikey.sequence,
+                                                kTypeDeletion));
+            key = filtered_key;
+            value = Slice();
+          }
+        } else if (value_changed) {
+          value = filtered_value;
+        }
       }
 
-      last_sequence_for_key = ikey.sequence;
+      // Merge operands do not hide older entries; the value they are
+      // combined into does.
+      SequenceNumber hiding_sequence =
+          (ikey.type == kTypeMerge) ? last_sequence_for_key : ikey.sequence;
+      if (!drop && !compact->merge_keys.empty()) {
+        bool combined = false;
+        const SequenceNumber merge_sequence =
+            DecodeFixed64(compact->merge_keys[0].data() +
+                          compact->merge_keys[0].size() - 8) >>
+            8;
+        if (compact->SnapshotStripe(ikey.sequence) != compact->merge_stripe) {
+          // A snapshot sees this entry without the pending operands.
+          status = WriteCompactionMerges(compact, input, false, nullptr,
+                                         &combined, &finish_pending);
+        } else if (ikey.type == kTypeMerge) {
+          compact->merge_keys.push_back(key.ToString());
+          compact->merge_operands.push_back(value.ToString());
+          drop = true;
+        } else {
+          // Combine the operands with the value or deletion they apply
+          // to, unless a range tombstone comes between them.
+          const bool combine = range_dels.MaxCoveringSequence(
+                                   ikey.user_key, kMaxSequenceNumber) <
+                               ikey.sequence;
+          status = WriteCompactionMerges(
+              compact, input, combine,
+              (ikey.type == kTypeValue) ? &value : nullptr, &combined,
+              &finish_pending);
+        }
+        if (!status.ok()) {
+          break;
+        }
+        if (combined) {
+          drop = true;
+          hiding_sequence = merge_sequence;
+        }
+      }
+      if (!drop && ikey.type == kTypeMerge &&
+          options_.merge_operator != nullptr) {
+        compact->merge_keys.push_back(key.ToString());
+        compact->merge_operands.push_back(value.ToString());
+        compact->merge_stripe = compact->SnapshotStripe(ikey.sequence);
+        drop = true;
+      }
+      if (ikey.type == kTypeMerge) {
+        key_has_merge_operands = true;
+      }
+
+      last_sequence_for_key = hiding_sequence;
     }
 #if 0
     Log(options_.info_log,
@@ -987,26 +1907,10 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
 #endif
 
     if (!drop) {
-      // Open output file if necessary
-      if (compact->builder == nullptr) {
-        status = OpenCompactionOutputFile(compact);
-        if (!status.ok()) {
-          break;
-        }
-      }
-      if (compact->builder->NumEntries() == 0) {
-        compact->current_output()->smallest.DecodeFrom(key);
-      }
-      compact->current_output()->largest.DecodeFrom(key);
-      compact->builder->Add(key, input->value());
-
-      // Close output file if it is big enough
-      if (compact->builder->FileSize() >=
-          compact->compaction->MaxOutputFileSize()) {
-        status = FinishCompactionOutputFile(compact, input);
-        if (!status.ok()) {
-          break;
-        }
+      status = AddCompactionOutputEntry(compact, input, key, value,
+                                        &finish_pending);
+      if (!status.ok()) {
+        break;
       }
     }
 
@@ -1016,8 +1920,17 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   if (status.ok() && shutting_down_.load(std::memory_order_acquire)) {
     status = Status::IOError("Deleting DB during compaction");
   }
+  if (status.ok() && !compact->merge_keys.empty()) {
+    status = FinishCompactionMerge(compact, input, range_dels,
+                                   &finish_pending);
+  }
+  if (status.ok() && compact->builder == nullptr &&
+      !compact->range_dels.empty() && !compact->has_range_del_lower) {
+    // Every entry was dropped, but some range tombstones must be kept.
+    status = OpenCompactionOutputFile(compact);
+  }
   if (status.ok() && compact->builder != nullptr) {
-    status = FinishCompactionOutputFile(compact, input);
+    status = FinishCompactionOutputFile(compact, input, nullptr);
   }
   if (status.ok()) {
     status = input->status();
@@ -1037,7 +1950,7 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
   }
 
   mutex_.Lock();
-  stats_[compact->compaction->level() + 1].Add(stats);
+  stats_[compact->compaction->output_level()].Add(stats);
 
   if (status.ok()) {
     status = InstallCompactionResults(compact);
@@ -1056,17 +1969,25 @@ struct IterState {
   port::Mutex* const mu;
   Version* const version GUARDED_BY(mu);
   MemTable* const mem GUARDED_BY(mu);
-  MemTable* const imm GUARDED_BY(mu);
-
-  IterState(port::Mutex* mutex, MemTable* mem, MemTable* imm, Version* version)
-      : mu(mutex), version(version), mem(mem), imm(imm) {}
+  std::vector<MemTable*> imm GUARDED_BY(mu);
+  int* const num_live_iterators GUARDED_BY(mu);
+
+  IterState(port::Mutex* mutex, MemTable* mem, Version* version,
+            int* num_live_iterators)
+      : mu(mutex),
+        version(version),
+        mem(mem),
+        num_live_iterators(num_live_iterators) {}
 };
 
 static void CleanupIteratorState(void* arg1, void* arg2) {
   IterState* state = reinterpret_cast<IterState*>(arg1);
   state->mu->Lock();
+  --*state->num_live_iterators;
   state->mem->Unref();
-  if (state->imm != nullptr) state->imm->Unref();
+  for (MemTable* imm : state->imm) {
+    imm->Unref();
+  }
   state->version->Unref();
   state->mu->Unlock();
   delete state;
@@ -1076,28 +1997,66 @@ static void CleanupIteratorState(void* arg1, void* arg2) {
 
 Iterator* DBImpl::NewInternalIterator(const ReadOptions& options,
                                       SequenceNumber* latest_snapshot,
-                                      uint32_t* seed) {
+                                      uint32_t* seed,
+                                      RangeTombstoneList** range_dels) {
   mutex_.Lock();
+  while (inplace_write_running_) {
+    inplace_write_finished_signal_.Wait();
+  }
   *latest_snapshot = versions_->LastSequence();
 
   // Collect together all needed child iterators
+  num_live_iterators_++;
+  IterState* cleanup = new IterState(&mutex_, mem_, versions_->current(),
+                                     &num_live_iterators_);
   std::vector<Iterator*> list;
   list.push_back(mem_->NewIterator());
   mem_->Ref();
-  if (imm_ != nullptr) {
-    list.push_back(imm_->NewIterator());
-    imm_->Ref();
+  for (const ImmutableMemTable& imm : imm_) {
+    list.push_back(imm.mem->NewIterator());
+    imm.mem->Ref();
+    cleanup->imm.push_back(imm.mem);
   }
   versions_->current()->AddIterators(options, &list);
   Iterator* internal_iter =
       NewMergingIterator(&internal_comparator_, &list[0], list.size());
   versions_->current()->Ref();
 
-  IterState* cleanup = new IterState(&mutex_, mem_, imm_, versions_->current());
   internal_iter->RegisterCleanup(CleanupIteratorState, cleanup, nullptr);
 
+  RangeTombstoneList* tombstones = nullptr;
+  Status s;
+  if (range_dels != nullptr) {
+    tombstones = new RangeTombstoneList(user_comparator());
+    s = AddMemTableRangeTombstones(mem_, tombstones);
+    for (size_t i = 0; s.ok() && i < imm_.size(); i++) {
+      s = AddMemTableRangeTombstones(imm_[i].mem, tombstones);
+    }
+  }
+
   *seed = ++seed_;
+  Version* const version = cleanup->version;
   mutex_.Unlock();
+
+  if (range_dels != nullptr) {
+    // The iterator holds a reference to the version, so its files may
+    // be read without the lock.
+    if (s.ok()) {
+      s = version->AddRangeTombstones(tombstones);
+    }
+    if (!s.ok()) {
+      delete tombstones;
+      delete internal_iter;
+      return NewErrorIterator(s);
+    }
+    if (tombstones->empty()) {
+      delete tombstones;
+      tombstones = nullptr;
+    } else {
+      tombstones->Finish();
+    }
+    *range_dels = tombstones;
+  }
   return internal_iter;
 }
 
@@ -1116,6 +2075,10 @@ Status DBImpl::Get(const ReadOptions& options, const Slice& key,
                    std::string* value) {
   Status s;
   MutexLock l(&mutex_);
+  while (inplace_write_running_) {
+    inplace_write_finished_signal_.Wait();
+  }
+  num_running_gets_++;
   SequenceNumber snapshot;
   if (options.snapshot != nullptr) {
     snapshot =
@@ -1125,10 +2088,13 @@ Status DBImpl::Get(const ReadOptions& options, const Slice& key,
   }
 
   MemTable* mem = mem_;
-  MemTable* imm = imm_;
+  std::vector<MemTable*> imm;  // Newest first
+  for (auto it = imm_.rbegin(); it != imm_.rend(); ++it) {
+    imm.push_back(it->mem);
+    it->mem->Ref();
+  }
   Version* current = versions_->current();
   mem->Ref();
-  if (imm != nullptr) imm->Ref();
   current->Ref();
 
   bool have_stat_update = false;
@@ -1137,24 +2103,46 @@ Status DBImpl::Get(const ReadOptions& options, const Slice& key,
   // Unlock while reading from files and memtables
   {
     mutex_.Unlock();
-    // First look in the memtable, then in the immutable memtable (if any).
+    // First look in the memtable, then in the immutable memtables from
+    // newest to oldest, and finally in the table files.
+    // Range tombstones found on the way delete older entries of the
+    // sources searched after them.
     LookupKey lkey(key, snapshot);
-    if (mem->Get(lkey, value, &s)) {
-      // Done
-    } else if (imm != nullptr && imm->Get(lkey, value, &s)) {
-      // Done
-    } else {
-      s = current->Get(options, lkey, value, &stats);
+    SequenceNumber covering_tombstone = 0;
+    std::vector<std::string> merge_operands;
+    bool done =
+        mem->Get(lkey, value, &s, &covering_tombstone, &merge_operands);
+    for (size_t i = 0; !done && i < imm.size(); i++) {
+      done = imm[i]->Get(lkey, value, &s, &covering_tombstone,
+                         &merge_operands);
+    }
+    if (!done) {
+      s = current->Get(options, lkey, value, &stats, &merge_operands,
+                       covering_tombstone);
       have_stat_update = true;
     }
+    if (!merge_operands.empty() && (s.ok() || s.IsNotFound())) {
+      // Apply the operands to the value found, if any.
+      std::string existing;
+      if (s.ok()) {
+        existing.swap(*value);
+      }
+      const Slice existing_value(existing);
+      s = FullMerge(options_.merge_operator, key,
+                    s.ok() ? &existing_value : nullptr, merge_operands,
+                    value);
+    }
     mutex_.Lock();
   }
+  num_running_gets_--;
 
   if (have_stat_update && current->UpdateStats(stats)) {
     MaybeScheduleCompaction();
   }
   mem->Unref();
-  if (imm != nullptr) imm->Unref();
+  for (MemTable* m : imm) {
+    m->Unref();
+  }
   current->Unref();
   return s;
 }
@@ -1162,13 +2150,15 @@ Status DBImpl::Get(const ReadOptions& options, const Slice& key,
 Iterator* DBImpl::NewIterator(const ReadOptions& options) {
   SequenceNumber latest_snapshot;
   uint32_t seed;
-  Iterator* iter = NewInternalIterator(options, &latest_snapshot, &seed);
+  RangeTombstoneList* range_dels = nullptr;
+  Iterator* iter =
+      NewInternalIterator(options, &latest_snapshot, &seed, &range_dels);
   return NewDBIterator(this, user_comparator(), iter,
                        (options.snapshot != nullptr
                             ? static_cast<const SnapshotImpl*>(options.snapshot)
                                   ->sequence_number()
                             : latest_snapshot),
-                       seed);
+                       range_dels, options_.merge_operator, seed);
 }
 
 void DBImpl::RecordReadSample(Slice key) {
@@ -1180,6 +2170,9 @@ void DBImpl::RecordReadSample(Slice key) {
 
 const Snapshot* DBImpl::GetSnapshot() {
   MutexLock l(&mutex_);
+  while (inplace_write_running_) {
+    inplace_write_finished_signal_.Wait();
+  }
   return snapshots_.New(versions_->LastSequence());
 }
 
@@ -1197,10 +2190,30 @@ Status DBImpl::Delete(const WriteOptions& options, const Slice& key) {
   return DB::Delete(options, key);
 }
 
+Status DBImpl::DeleteRange(const WriteOptions& options, const Slice& begin,
+                           const Slice& end) {
+  const int r = user_comparator()->Compare(begin, end);
+  if (r > 0) {
+    return Status::InvalidArgument("DeleteRange begin is after end");
+  } else if (r == 0) {
+    return Status::OK();
+  }
+  return DB::DeleteRange(options, begin, end);
+}
+
+Status DBImpl::Merge(const WriteOptions& options, const Slice& key,
+                     const Slice& value) {
+  if (options_.merge_operator == nullptr) {
+    return Status::InvalidArgument("Merge requires options.merge_operator");
+  }
+  return DB::Merge(options, key, value);
+}
+
 Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
   Writer w(&mutex_);
   w.batch = updates;
   w.sync = options.sync;
+  w.disable_wal = options.disable_wal;
   w.done = false;
 
   MutexLock l(&mutex_);
@@ -1213,7 +2226,9 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
   }
 
   // May temporarily unlock and wait.
-  Status status = MakeRoomForWrite(updates == nullptr);
+  Status status = MakeRoomForWrite(
+      updates == nullptr,
+      updates == nullptr ? 0 : WriteBatchInternal::ByteSize(updates));
   uint64_t last_sequence = versions_->LastSequence();
   Writer* last_writer = &w;
   if (status.ok() && updates != nullptr) {  // nullptr batch is for compactions
@@ -1224,19 +2239,37 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
     // Add to log and apply to memtable.  We can release the lock
     // during this phase since &w is currently responsible for logging
     // and protects against concurrent loggers and concurrent writes
-    // into mem_.
+    // into mem_.  The sequence numbers are assigned above whether or not
+    // the group is logged, so recovery of later logged writes stays
+    // ordered after the unlogged ones.
+    if (options.disable_wal) {
+      mem_has_unlogged_writes_ = true;
+    }
+    // Without snapshots, iterators and running Get() calls nothing can
+    // read the versions an in-place update overwrites, and new readers
+    // wait until the whole group is applied, so batches stay atomic.
+    const bool inplace_update = options_.inplace_update_support &&
+                                snapshots_.empty() &&
+                                num_live_iterators_ == 0 &&
+                                num_running_gets_ == 0;
+    if (inplace_update) {
+      inplace_write_running_ = true;
+    }
     {
       mutex_.Unlock();
-      status = log_->AddRecord(WriteBatchInternal::Contents(write_batch));
+      if (!options.disable_wal) {
+        status = log_->AddRecord(WriteBatchInternal::Contents(write_batch));
+      }
       bool sync_error = false;
-      if (status.ok() && options.sync) {
+      if (status.ok() && options.sync && !options.disable_wal) {
         status = logfile_->Sync();
         if (!status.ok()) {
           sync_error = true;
         }
       }
       if (status.ok()) {
-        status = WriteBatchInternal::InsertInto(write_batch, mem_);
+        status =
+            WriteBatchInternal::InsertInto(write_batch, mem_, inplace_update);
       }
       mutex_.Lock();
       if (sync_error) {
@@ -1246,6 +2279,10 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
         RecordBackgroundError(status);
       }
     }
+    if (inplace_update) {
+      inplace_write_running_ = false;
+      inplace_write_finished_signal_.SignalAll();
+    }
     if (write_batch == tmp_batch_) tmp_batch_->Clear();
 
     versions_->SetLastSequence(last_sequence);
@@ -1299,6 +2336,16 @@ WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer) {
       break;
     }
 
+    if (w->disable_wal != first->disable_wal) {
+      // Logged and unlogged writes are never mixed in one group.
+      break;
+    }
+
+    if (w->exclusive) {
+      // Must reach the front of the queue to do its work.
+      break;
+    }
+
     if (w->batch != nullptr) {
       size += WriteBatchInternal::ByteSize(w->batch);
       if (size > max_size) {
@@ -1320,42 +2367,339 @@ WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer) {
   return result;
 }
 
+// An external table file being ingested.
+struct DBImpl::IngestedTable {
+  IngestedTable() : file(nullptr), table(nullptr), empty(true) {}
+
+  std::string path;
+  RandomAccessFile* file;
+  Table* table;
+  std::string smallest, largest;  // User keys, unless "empty"
+  bool empty;
+  FileMetaData meta;  // Of the copy added to the database
+};
+
+Status DBImpl::OpenIngestedTable(const Options& table_options,
+                                 IngestedTable* t) {
+  uint64_t size;
+  Status s = env_->GetFileSize(t->path, &size);
+  if (s.ok()) {
+    s = env_->NewRandomAccessFile(t->path, &t->file);
+  }
+  if (s.ok()) {
+    s = Table::Open(table_options, t->file, size, &t->table);
+  }
+  if (s.ok()) {
+    Iterator* iter = t->table->NewIterator(ReadOptions());
+    iter->SeekToFirst();
+    if (iter->Valid()) {
+      t->smallest = iter->key().ToString();
+      iter->SeekToLast();
+      if (iter->Valid()) {
+        t->largest = iter->key().ToString();
+        t->empty = false;
+      }
+    }
+    s = iter->status();
+    delete iter;
+  }
+  return s;
+}
+
+namespace {
+
+// Yields the entries of a table built with user keys as values with
+// sequence number "seq", the form in which BuildTable() writes them.
+// Fails at the first key that does not follow the previous one.
+class IngestedTableIterator : public Iterator {
+ public:
+  // Takes ownership of "iter".
+  IngestedTableIterator(const Comparator* ucmp, Iterator* iter,
+                        SequenceNumber seq)
+      : ucmp_(ucmp), iter_(iter), seq_(seq) {}
+
+  ~IngestedTableIterator() override { delete iter_; }
+
+  bool Valid() const override { return status_.ok() && iter_->Valid(); }
+  void SeekToFirst() override {
+    iter_->SeekToFirst();
+    key_.clear();
+    Update();
+  }
+  void Next() override {
+    iter_->Next();
+    Update();
+  }
+  // BuildTable() only scans forward from the first entry.
+  void SeekToLast() override { status_ = Status::NotSupported("SeekToLast"); }
+  void Seek(const Slice& target) override {
+    status_ = Status::NotSupported("Seek");
+  }
+  void Prev() override { status_ = Status::NotSupported("Prev"); }
+  Slice key() const override { return key_; }
+  Slice value() const override { return iter_->value(); }
+  Status status() const override {
+    return status_.ok() ? iter_->status() : status_;
+  }
+
+ private:
+  void Update() {
+    if (!iter_->Valid()) {
+      return;
+    }
+    const Slice user_key = iter_->key();
+    if (!key_.empty() && ucmp_->Compare(user_key, ExtractUserKey(key_)) <= 0) {
+      status_ = Status::InvalidArgument("ingested file is not sorted",
+                                        EscapeString(user_key));
+      return;
+    }
+    key_.clear();
+    AppendInternalKey(&key_, ParsedInternalKey(user_key, seq_, kTypeValue));
+  }
+
+  const Comparator* const ucmp_;
+  Iterator* const iter_;
+  const SequenceNumber seq_;
+  std::string key_;
+  Status status_;
+};
+
+}  // namespace
+
+Status DBImpl::IngestExternalFile(const std::vector<std::string>& paths) {
+  // The files are read with the user comparator they were built with.
+  Options table_options = options_;
+  table_options.comparator = user_comparator();
+  table_options.filter_policy = nullptr;
+  table_options.block_cache = nullptr;
+
+  std::vector<IngestedTable> tables(paths.size());
+  Status s;
+  for (size_t i = 0; s.ok() && i < paths.size(); i++) {
+    tables[i].path = paths[i];
+    s = OpenIngestedTable(table_options, &tables[i]);
+  }
+
+  // All the entries get one sequence number, so the files must not
+  // hold the same key twice.
+  std::vector<IngestedTable*> sorted;
+  if (s.ok()) {
+    for (IngestedTable& t : tables) {
+      if (!t.empty) {
+        sorted.push_back(&t);
+      }
+    }
+    const Comparator* ucmp = user_comparator();
+    std::sort(sorted.begin(), sorted.end(),
+              [ucmp](const IngestedTable* a, const IngestedTable* b) {
+                return ucmp->Compare(a->smallest, b->smallest) < 0;
+              });
+    for (size_t i = 1; s.ok() && i < sorted.size(); i++) {
+      if (ucmp->Compare(sorted[i - 1]->largest, sorted[i]->smallest) >= 0) {
+        s = Status::InvalidArgument("ingested files overlap", sorted[i]->path);
+      }
+    }
+  }
+
+  if (s.ok() && !sorted.empty()) {
+    // Keep other writes from taking sequence numbers until the files
+    // are installed.
+    Writer w(&mutex_);
+    w.exclusive = true;
+    MutexLock l(&mutex_);
+    writers_.push_back(&w);
+    while (&w != writers_.front()) {
+      w.cv.Wait();
+    }
+    s = IngestTables(sorted);
+    writers_.pop_front();
+    if (!writers_.empty()) {
+      writers_.front()->cv.Signal();
+    }
+  }
+
+  for (IngestedTable& t : tables) {
+    delete t.table;
+    delete t.file;
+  }
+  return s;
+}
+
+Status DBImpl::IngestTables(const std::vector<IngestedTable*>& tables) {
+  mutex_.AssertHeld();
+
+  // The ingested data is newer than all the data written so far, which
+  // must therefore be below it in the tree: flush the memtables.
+  Status s;
+  if (mem_->NumEntries() > 0) {
+    s = MakeRoomForWrite(true /* force */, 0);
+  }
+  while (s.ok() && !imm_.empty()) {
+    if (!bg_error_.ok()) {
+      s = bg_error_;
+    } else {
+      background_work_finished_signal_.Wait();
+    }
+  }
+  if (!s.ok()) {
+    return s;
+  }
+
+  const SequenceNumber seq = versions_->LastSequence() + 1;
+  for (IngestedTable* t : tables) {
+    t->meta.number = versions_->NewFileNumber();
+    pending_outputs_.insert(t->meta.number);
+  }
+  for (size_t i = 0; s.ok() && i < tables.size(); i++) {
+    IngestedTable* t = tables[i];
+    mutex_.Unlock();
+    ReadOptions read_options;
+    read_options.verify_checksums = true;
+    read_options.fill_cache = false;
+    Iterator* iter = new IngestedTableIterator(
+        user_comparator(), t->table->NewIterator(read_options), seq);
+    s = BuildTable(dbname_, env_, options_, table_cache_, iter,
+                   std::vector<RangeTombstone>(), &t->meta);
+    delete iter;
+    mutex_.Lock();
+    Log(options_.info_log, "Ingested table #%llu from %s: %lld bytes %s",
+        (unsigned long long)t->meta.number, t->path.c_str(),
+        (unsigned long long)t->meta.file_size, s.ToString().c_str());
+  }
+
+  // LogAndApply() must not run concurrently with the background work, and
+  // the levels must be picked from the version the files are added to:
+  // hold the background slot until the files are installed.
+  while (background_compaction_scheduled_) {
+    background_work_finished_signal_.Wait();
+  }
+  background_compaction_scheduled_ = true;
+
+  VersionEdit edit;
+  Version* const base = versions_->current();
+  for (size_t i = 0; s.ok() && i < tables.size(); i++) {
+    FileMetaData* meta = &tables[i]->meta;
+    const int level = base->PickLevelForIngestedFile(meta->smallest.user_key(),
+                                                     meta->largest.user_key());
+    if (level == 0) {
+      // Level-0 files are ordered by number, and the file holds data
+      // newer than any compaction output, including those of compactions
+      // started while it was built.
+      const uint64_t number = versions_->NewFileNumber();
+      pending_outputs_.insert(number);
+      s = env_->RenameFile(TableFileName(dbname_, meta->number),
+                           TableFileName(dbname_, number));
+      if (s.ok()) {
+        table_cache_->Evict(meta->number);
+        pending_outputs_.erase(meta->number);
+        meta->number = number;
+      }
+    }
+    edit.AddFile(level, *meta);
+
+    CompactionStats stats;
+    stats.bytes_written = meta->file_size;
+    stats_[level].Add(stats);
+  }
+  if (s.ok()) {
+    versions_->SetLastSequence(seq);
+    s = versions_->LogAndApply(&edit, &mutex_);
+  }
+  for (IngestedTable* t : tables) {
+    pending_outputs_.erase(t->meta.number);
+  }
+  if (!s.ok()) {
+    RemoveObsoleteFiles();
+  }
+  background_compaction_scheduled_ = false;
+  MaybeScheduleCompaction();
+  background_work_finished_signal_.SignalAll();
+  return s;
+}
+
+// Reads only the counters of "mem" and options that never change, so it
+// is also used by log recovery.
+bool DBImpl::MemTableIsFull(MemTable* mem) const {
+  if (mem->ApproximateMemoryUsage() > options_.write_buffer_size) {
+    return true;
+  }
+  const uint64_t entries = mem->NumEntries();
+  if (options_.memtable_max_entries != 0 &&
+      entries >= options_.memtable_max_entries) {
+    return true;
+  }
+  return options_.memtable_max_deletion_ratio > 0 &&
+         entries >= config::kMinEntriesForDeletionRatio &&
+         mem->NumDeletes() >= options_.memtable_max_deletion_ratio * entries;
+}
+
 // REQUIRES: mutex_ is held
 // REQUIRES: this thread is currently at the front of the writer queue
-Status DBImpl::MakeRoomForWrite(bool force) {
+Status DBImpl::MakeRoomForWrite(bool force, size_t write_bytes) {
   mutex_.AssertHeld();
   assert(!writers_.empty());
   bool allow_delay = !force;
+  bool stalled = false;
   Status s;
   while (true) {
+    if (stalled && options_.rate_limiter != nullptr) {
+      // Background writes are not keeping up; let them use more I/O.
+      options_.rate_limiter->ReportWriteStall();
+      stalled = false;
+    }
     if (!bg_error_.ok()) {
       // Yield previous error
       s = bg_error_;
       break;
-    } else if (allow_delay && versions_->NumLevelFiles(0) >=
-                                  config::kL0_SlowdownWritesTrigger) {
+    } else if (allow_delay && UpdateDelayedWriteRate()) {
       // We are getting close to hitting a hard limit on the number of
-      // L0 files.  Rather than delaying a single write by several
-      // seconds when we hit the hard limit, start delaying each
-      // individual write by 1ms to reduce latency variance.  Also,
-      // this delay hands over some CPU to the compaction thread in
-      // case it is sharing the same core as the writer.
-      mutex_.Unlock();
-      env_->SleepForMicroseconds(1000);
+      // L0 files or on pending compaction work.  Rather than delaying a
+      // single write by several seconds when we hit the hard limit,
+      // throttle writes to a rate that shrinks as the limit approaches
+      // so that latency stays smooth.  This also hands over some CPU to
+      // the compaction thread in case it is sharing the same core as
+      // the writer.
+      // The delay is slept in short slices, and ends early once the
+      // compactions have caught up.
+      static const uint64_t kDelaySliceMicros = 1000;
+      const uint64_t start_micros = env_->NowMicros();
+      const uint64_t deadline =
+          start_micros + write_controller_.GetDelay(start_micros, write_bytes);
       allow_delay = false;  // Do not delay a single write more than once
-      mutex_.Lock();
-    } else if (!force &&
-               (mem_->ApproximateMemoryUsage() <= options_.write_buffer_size)) {
+      stalled = true;
+      for (uint64_t now = env_->NowMicros(); now < deadline;
+           now = env_->NowMicros()) {
+        mutex_.Unlock();
+        env_->SleepForMicroseconds(
+            static_cast<int>(std::min(deadline - now, kDelaySliceMicros)));
+        mutex_.Lock();
+        if (!bg_error_.ok() || !UpdateDelayedWriteRate()) {
+          break;
+        }
+      }
+    } else if (!force && !MemTableIsFull(mem_)) {
       // There is room in current memtable
       break;
-    } else if (imm_ != nullptr) {
+    } else if (imm_.size() >=
+               static_cast<size_t>(options_.max_write_buffer_number - 1)) {
       // We have filled up the current memtable, but the previous
-      // one is still being compacted, so we wait.
+      // ones are still being compacted, so we wait.
       Log(options_.info_log, "Current memtable full; waiting...\n");
+      stalled = true;
       background_work_finished_signal_.Wait();
-    } else if (versions_->NumLevelFiles(0) >= config::kL0_StopWritesTrigger) {
+    } else if (versions_->NumLevelFiles(0) >=
+               options_.level0_stop_writes_trigger) {
       // There are too many level-0 files.
       Log(options_.info_log, "Too many L0 files; waiting...\n");
+      stalled = true;
+      background_work_finished_signal_.Wait();
+    } else if (options_.hard_pending_compaction_bytes_limit != 0 &&
+               versions_->EstimatedPendingCompactionBytes() >=
+                   options_.hard_pending_compaction_bytes_limit) {
+      // Compactions are too far behind.
+      Log(options_.info_log,
+          "Too many pending compaction bytes; waiting...\n");
+      stalled = true;
       background_work_finished_signal_.Wait();
     } else {
       // Attempt to switch to a new memtable and trigger compaction of old
@@ -1386,10 +2730,13 @@ Status DBImpl::MakeRoomForWrite(bool force) {
 
       logfile_ = lfile;
       logfile_number_ = new_log_number;
-      log_ = new log::Writer(lfile);
-      imm_ = mem_;
+      log_ = new log::Writer(lfile, 0, options_.wal_compression,
+                             options_.zstd_compression_level);
+      mem_->MarkImmutable();
+      imm_.push_back({mem_, new_log_number, mem_has_unlogged_writes_});
       has_imm_.store(true, std::memory_order_release);
-      mem_ = new MemTable(internal_comparator_);
+      mem_has_unlogged_writes_ = false;
+      mem_ = new MemTable(internal_comparator_, options_);
       mem_->Ref();
       force = false;  // Do not force another compaction if have room
       MaybeScheduleCompaction();
@@ -1398,6 +2745,43 @@ Status DBImpl::MakeRoomForWrite(bool force) {
   return s;
 }
 
+bool DBImpl::UpdateDelayedWriteRate() {
+  mutex_.AssertHeld();
+  // Scale the configured rate by how close we are to each stop condition;
+  // the closest one wins.
+  double factor = 1.0;
+  bool delay = false;
+  const int l0_files = versions_->NumLevelFiles(0);
+  if (l0_files >= options_.level0_slowdown_writes_trigger) {
+    delay = true;
+    const int range = options_.level0_stop_writes_trigger -
+                      options_.level0_slowdown_writes_trigger;
+    const int left = options_.level0_stop_writes_trigger - l0_files;
+    if (range > 0) {
+      factor = std::min(factor, static_cast<double>(left) / range);
+    }
+  }
+  const uint64_t pending = versions_->EstimatedPendingCompactionBytes();
+  const uint64_t soft = options_.soft_pending_compaction_bytes_limit;
+  const uint64_t hard = options_.hard_pending_compaction_bytes_limit;
+  if (soft != 0 && pending >= soft) {
+    delay = true;
+    if (hard > soft && pending < hard) {
+      factor = std::min(factor, static_cast<double>(hard - pending) /
+                                    static_cast<double>(hard - soft));
+    }
+  }
+
+  if (!delay) {
+    write_controller_.SetDelayedWriteRate(0);
+    return false;
+  }
+  const uint64_t rate =
+      static_cast<uint64_t>(options_.delayed_write_rate * factor);
+  write_controller_.SetDelayedWriteRate(std::max(rate, kMinDelayedWriteRate));
+  return true;
+}
+
 bool DBImpl::GetProperty(const Slice& property, std::string* value) {
   value->clear();
 
@@ -1411,7 +2795,7 @@ bool DBImpl::GetProperty(const Slice& property, std::string* value) {
     in.remove_prefix(strlen("num-files-at-level"));
     uint64_t level;
     bool ok = ConsumeDecimalNumber(&in, &level) && in.empty();
-    if (!ok || level >= config::kNumLevels) {
+    if (!ok || level >= static_cast<uint64_t>(options_.num_levels)) {
       return false;
     } else {
       char buf[100];
@@ -1427,7 +2811,7 @@ bool DBImpl::GetProperty(const Slice& property, std::string* value) {
                   "Level  Files Size(MB) Time(sec) Read(MB) Write(MB)\n"
                   "--------------------------------------------------\n");
     value->append(buf);
-    for (int level = 0; level < config::kNumLevels; level++) {
+    for (int level = 0; level < options_.num_levels; level++) {
       int files = versions_->NumLevelFiles(level);
       if (stats_[level].micros > 0 || files > 0) {
         std::snprintf(buf, sizeof(buf), "%3d %8d %8.0f %9.0f %8.0f %9.0f\n",
@@ -1447,8 +2831,8 @@ bool DBImpl::GetProperty(const Slice& property, std::string* value) {
     if (mem_) {
       total_usage += mem_->ApproximateMemoryUsage();
     }
-    if (imm_) {
-      total_usage += imm_->ApproximateMemoryUsage();
+    for (const ImmutableMemTable& imm : imm_) {
+      total_usage += imm.mem->ApproximateMemoryUsage();
     }
     char buf[50];
     std::snprintf(buf, sizeof(buf), "%llu",
@@ -1478,6 +2862,40 @@ void DBImpl::GetApproximateSizes(const Range* range, int n, uint64_t* sizes) {
   v->Unref();
 }
 
+Status DBImpl::GetPropertiesOfAllTables(TablePropertiesCollection* props) {
+  props->clear();
+  mutex_.Lock();
+  Version* v = versions_->current();
+  v->Ref();
+  std::vector<FileMetaData*> files;
+  for (int level = 0; level < options_.num_levels; level++) {
+    std::vector<FileMetaData*> level_files;
+    v->GetOverlappingInputs(level, nullptr, nullptr, &level_files);
+    files.insert(files.end(), level_files.begin(), level_files.end());
+  }
+  mutex_.Unlock();
+
+  // The files stay alive while their version is referenced.
+  Status s;
+  for (const FileMetaData* f : files) {
+    TableProperties table_props;
+    bool has_properties;
+    s = table_cache_->GetTableProperties(f->number, f->file_size,
+                                         &table_props, &has_properties);
+    if (!s.ok()) {
+      break;
+    }
+    if (has_properties) {
+      (*props)[TableFileName(dbname_, f->number)] = table_props;
+    }
+  }
+
+  mutex_.Lock();
+  v->Unref();
+  mutex_.Unlock();
+  return s;
+}
+
 // Default implementations of convenience methods that subclasses of DB
 // can call if they wish
 Status DB::Put(const WriteOptions& opt, const Slice& key, const Slice& value) {
@@ -1492,6 +2910,32 @@ Status DB::Delete(const WriteOptions& opt, const Slice& key) {
   return Write(opt, &batch);
 }
 
+Status DB::DeleteRange(const WriteOptions& opt, const Slice& begin,
+                       const Slice& end) {
+  WriteBatch batch;
+  batch.DeleteRange(begin, end);
+  return Write(opt, &batch);
+}
+
+Status DB::Merge(const WriteOptions& opt, const Slice& key,
+                 const Slice& value) {
+  WriteBatch batch;
+  batch.Merge(key, value);
+  return Write(opt, &batch);
+}
+
+Status DB::SetOptions(const std::map<std::string, std::string>& options) {
+  return Status::NotSupported("SetOptions");
+}
+
+Status DB::IngestExternalFile(const std::vector<std::string>& paths) {
+  return Status::NotSupported("IngestExternalFile");
+}
+
+Status DB::GetPropertiesOfAllTables(TablePropertiesCollection* props) {
+  return Status::NotSupported("GetPropertiesOfAllTables");
+}
+
 DB::~DB() = default;
 
 Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
@@ -1513,8 +2957,9 @@ Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
       edit.SetLogNumber(new_log_number);
       impl->logfile_ = lfile;
       impl->logfile_number_ = new_log_number;
-      impl->log_ = new log::Writer(lfile);
-      impl->mem_ = new MemTable(impl->internal_comparator_);
+      impl->log_ = new log::Writer(lfile, 0, impl->options_.wal_compression,
+                                   impl->options_.zstd_compression_level);
+      impl->mem_ = new MemTable(impl->internal_comparator_, impl->options_);
       impl->mem_->Ref();
     }
   }
@@ -13,6 +13,7 @@
 #include "db/dbformat.h"
 #include "db/log_writer.h"
 #include "db/snapshot.h"
+#include "db/write_controller.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "port/port.h"
@@ -20,7 +21,9 @@
 
 namespace leveldb {
 
+class FlushThreadPool;
 class MemTable;
+class RangeTombstoneList;
 class TableCache;
 class Version;
 class VersionEdit;
@@ -39,7 +42,12 @@ class DBImpl : public DB {
   Status Put(const WriteOptions&, const Slice& key,
              const Slice& value) override;
   Status Delete(const WriteOptions&, const Slice& key) override;
+  Status DeleteRange(const WriteOptions&, const Slice& begin,
+                     const Slice& end) override;
+  Status Merge(const WriteOptions&, const Slice& key,
+               const Slice& value) override;
   Status Write(const WriteOptions& options, WriteBatch* updates) override;
+  Status IngestExternalFile(const std::vector<std::string>& paths) override;
   Status Get(const ReadOptions& options, const Slice& key,
              std::string* value) override;
   Iterator* NewIterator(const ReadOptions&) override;
@@ -47,7 +55,10 @@ class DBImpl : public DB {
   void ReleaseSnapshot(const Snapshot* snapshot) override;
   bool GetProperty(const Slice& property, std::string* value) override;
   void GetApproximateSizes(const Range* range, int n, uint64_t* sizes) override;
+  Status GetPropertiesOfAllTables(TablePropertiesCollection* props) override;
   void CompactRange(const Slice* begin, const Slice* end) override;
+  Status SetOptions(
+      const std::map<std::string, std::string>& options) override;
 
   // Extra methods (for testing) that are not in the public DB interface
 
@@ -75,6 +86,17 @@ class DBImpl : public DB {
   friend class DB;
   struct CompactionState;
   struct Writer;
+  struct IngestedTable;
+
+  // A full memtable waiting to be flushed.
+  struct ImmutableMemTable {
+    MemTable* mem;
+    // Log file started when "mem" was sealed.  Earlier logs are no longer
+    // needed once "mem" has been flushed.
+    uint64_t next_log_number;
+    // Does "mem" hold writes that were not added to the log?
+    bool has_unlogged_writes;
+  };
 
   // Information for a manual compaction
   struct ManualCompaction {
@@ -101,9 +123,13 @@ class DBImpl : public DB {
     int64_t bytes_written;
   };
 
+  // If range_dels is non-null, *range_dels is set to the finished list
+  // of range tombstones in the iterated sources, or nullptr if there are
+  // none.  The caller owns it.
   Iterator* NewInternalIterator(const ReadOptions&,
                                 SequenceNumber* latest_snapshot,
-                                uint32_t* seed);
+                                uint32_t* seed,
+                                RangeTombstoneList** range_dels = nullptr);
 
   Status NewDB();
 
@@ -130,11 +156,45 @@ class DBImpl : public DB {
   Status WriteLevel0Table(MemTable* mem, VersionEdit* edit, Version* base)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
-  Status MakeRoomForWrite(bool force /* compact even if there is room? */)
+  // Write the merged contents of mems[0,n-1] as a single level-0 table.
+  Status WriteLevel0Table(MemTable* const* mems, int n, VersionEdit* edit,
+                          Version* base) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Like WriteLevel0Table(), but split the output by user key into up to
+  // "partitions" tables that are built in parallel.  Each table is placed
+  // at the level chosen by base->PickLevelForMemTableOutput().
+  Status WriteLevel0TablesInParallel(MemTable* const* mems, int n,
+                                     int partitions, VersionEdit* edit,
+                                     Version* base)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Force the current memtable contents to be compacted and wait for
+  // the compaction to finish.
+  Status FlushMemTable();
+
+  // Open the table file at t->path, built with the comparator of
+  // "table_options", and find its key range.
+  Status OpenIngestedTable(const Options& table_options, IngestedTable* t);
+
+  // Copy "tables", which do not overlap, into the database as the
+  // entries of one write, and install them with a single edit.
+  // REQUIRES: this thread is at the front of the writer queue
+  Status IngestTables(const std::vector<IngestedTable*>& tables)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Returns true if "mem" should be replaced by a new memtable.
+  bool MemTableIsFull(MemTable* mem) const;
+
+  // "write_bytes" is charged against the delayed write rate.
+  Status MakeRoomForWrite(bool force /* compact even if there is room? */,
+                          size_t write_bytes) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   WriteBatch* BuildBatchGroup(Writer** last_writer)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Set the write rate from the current compaction backlog.  Returns
+  // true if writes should be slowed down.
+  bool UpdateDelayedWriteRate() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
   void RecordBackgroundError(const Status& s);
 
   void MaybeScheduleCompaction() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
@@ -147,7 +207,29 @@ class DBImpl : public DB {
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
   Status OpenCompactionOutputFile(CompactionState* compact);
-  Status FinishCompactionOutputFile(CompactionState* compact, Iterator* input);
+  // "next_user_key" is the first user key of the next output, or null if
+  // this is the last one; the range tombstones of the output end there.
+  Status FinishCompactionOutputFile(CompactionState* compact, Iterator* input,
+                                    const Slice* next_user_key);
+  Status CollectCompactionRangeTombstones(CompactionState* compact,
+                                          RangeTombstoneList* range_dels);
+  // Add an entry to the output of the compaction.  *finish_pending is set
+  // once the current output file should be finished before the next user
+  // key.
+  Status AddCompactionOutputEntry(CompactionState* compact, Iterator* input,
+                                  const Slice& key, const Slice& value,
+                                  bool* finish_pending);
+  // Write out the merge operands held by *compact.  If "combine" is true,
+  // they are first combined with "*existing_value" (null if they apply to
+  // no value) into one value, and *combined tells whether that succeeded.
+  Status WriteCompactionMerges(CompactionState* compact, Iterator* input,
+                               bool combine, const Slice* existing_value,
+                               bool* combined, bool* finish_pending);
+  // Write out the merge operands held by *compact once all entries of
+  // their key have been read.
+  Status FinishCompactionMerge(CompactionState* compact, Iterator* input,
+                               const RangeTombstoneList& range_dels,
+                               bool* finish_pending);
   Status InstallCompactionResults(CompactionState* compact)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
@@ -159,7 +241,10 @@ class DBImpl : public DB {
   Env* const env_;
   const InternalKeyComparator internal_comparator_;
   const InternalFilterPolicy internal_filter_policy_;
-  const Options options_;  // options_.comparator == &internal_comparator_
+  // options_.comparator == &internal_comparator_.  Only the options that
+  // SetOptions() changes are modified after construction, while holding
+  // mutex_.
+  Options options_;
   const bool owns_info_log_;
   const bool owns_cache_;
   const std::string dbname_;
@@ -167,6 +252,10 @@ class DBImpl : public DB {
   // table_cache_ provides its own synchronization
   TableCache* const table_cache_;
 
+  // Builds the partitions of parallel flushes.  Null unless
+  // options_.flush_parallelism > 1.
+  FlushThreadPool* const flush_pool_;
+
   // Lock over the persistent DB state.  Non-null iff successfully acquired.
   FileLock* db_lock_;
 
@@ -175,8 +264,11 @@ class DBImpl : public DB {
   std::atomic<bool> shutting_down_;
   port::CondVar background_work_finished_signal_ GUARDED_BY(mutex_);
   MemTable* mem_;
-  MemTable* imm_ GUARDED_BY(mutex_);  // Memtable being compacted
-  std::atomic<bool> has_imm_;         // So bg thread can detect non-null imm_
+  // Memtables waiting to be flushed, oldest first.
+  std::deque<ImmutableMemTable> imm_ GUARDED_BY(mutex_);
+  std::atomic<bool> has_imm_;  // So bg thread can detect non-empty imm_
+  // Does mem_ hold writes that were not added to the log?
+  bool mem_has_unlogged_writes_ GUARDED_BY(mutex_);
   WritableFile* logfile_;
   uint64_t logfile_number_ GUARDED_BY(mutex_);
   log::Writer* log_;
@@ -186,8 +278,19 @@ class DBImpl : public DB {
   std::deque<Writer*> writers_ GUARDED_BY(mutex_);
   WriteBatch* tmp_batch_ GUARDED_BY(mutex_);
 
+  // Paces writes while compactions are behind.
+  WriteController write_controller_ GUARDED_BY(mutex_);
+
   SnapshotList snapshots_ GUARDED_BY(mutex_);
 
+  // In-place updates overwrite values that snapshots, iterators and
+  // Get() calls could read, so they only run while none exists, and new
+  // ones wait for a running in-place write group to finish.
+  int num_live_iterators_ GUARDED_BY(mutex_);
+  int num_running_gets_ GUARDED_BY(mutex_);
+  bool inplace_write_running_ GUARDED_BY(mutex_);
+  port::CondVar inplace_write_finished_signal_ GUARDED_BY(mutex_);
+
   // Set of table files to protect from deletion because they are
   // part of ongoing compactions.
   std::set<uint64_t> pending_outputs_ GUARDED_BY(mutex_);
@@ -202,7 +305,7 @@ class DBImpl : public DB {
   // Have we encountered a background error in paranoid mode?
   Status bg_error_ GUARDED_BY(mutex_);
 
-  CompactionStats stats_[config::kNumLevels] GUARDED_BY(mutex_);
+  CompactionStats stats_[config::kMaxNumLevels] GUARDED_BY(mutex_);
 };
 
 // Sanitize db options.  The caller should delete result.info_log if
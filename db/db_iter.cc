@@ -4,9 +4,13 @@
 
 #include "db/db_iter.h"
 
+#include <algorithm>
+
 #include "db/db_impl.h"
 #include "db/dbformat.h"
 #include "db/filename.h"
+#include "db/merge_helper.h"
+#include "db/range_tombstone.h"
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
 #include "port/port.h"
@@ -43,31 +47,45 @@ class DBIter : public Iterator {
   //     the exact entry that yields this->key(), this->value()
   // (2) When moving backwards, the internal iterator is positioned
   //     just before all entries whose user key == this->key().
+  // An exception to (1) is an entry combined from merge operands: the
+  // internal iterator is then positioned past the operands, and the key
+  // and value are saved instead.
   enum Direction { kForward, kReverse };
 
   DBIter(DBImpl* db, const Comparator* cmp, Iterator* iter, SequenceNumber s,
+         RangeTombstoneList* range_dels, const MergeOperator* merge_operator,
          uint32_t seed)
       : db_(db),
         user_comparator_(cmp),
         iter_(iter),
         sequence_(s),
+        range_dels_(range_dels),
+        merge_operator_(merge_operator),
         direction_(kForward),
         valid_(false),
+        current_entry_is_merged_(false),
         rnd_(seed),
         bytes_until_read_sampling_(RandomCompactionPeriod()) {}
 
   DBIter(const DBIter&) = delete;
   DBIter& operator=(const DBIter&) = delete;
 
-  ~DBIter() override { delete iter_; }
+  ~DBIter() override {
+    delete iter_;
+    delete range_dels_;
+  }
   bool Valid() const override { return valid_; }
   Slice key() const override {
     assert(valid_);
-    return (direction_ == kForward) ? ExtractUserKey(iter_->key()) : saved_key_;
+    return (direction_ == kForward && !current_entry_is_merged_)
+               ? ExtractUserKey(iter_->key())
+               : saved_key_;
   }
   Slice value() const override {
     assert(valid_);
-    return (direction_ == kForward) ? iter_->value() : saved_value_;
+    return (direction_ == kForward && !current_entry_is_merged_)
+               ? iter_->value()
+               : saved_value_;
   }
   Status status() const override {
     if (status_.ok()) {
@@ -86,6 +104,7 @@ class DBIter : public Iterator {
  private:
   void FindNextUserEntry(bool skipping, std::string* skip);
   void FindPrevUserEntry();
+  void MergeValuesNewToOld();
   bool ParseKey(ParsedInternalKey* key);
 
   inline void SaveKey(const Slice& k, std::string* dst) {
@@ -110,11 +129,15 @@ class DBIter : public Iterator {
   const Comparator* const user_comparator_;
   Iterator* const iter_;
   SequenceNumber const sequence_;
+  RangeTombstoneList* const range_dels_;  // Null if there are none
+  const MergeOperator* const merge_operator_;
   Status status_;
   std::string saved_key_;    // == current key when direction_==kReverse
   std::string saved_value_;  // == current raw value when direction_==kReverse
+  std::vector<std::string> merge_operands_;
   Direction direction_;
   bool valid_;
+  bool current_entry_is_merged_;
   Random rnd_;
   size_t bytes_until_read_sampling_;
 };
@@ -133,9 +156,14 @@ inline bool DBIter::ParseKey(ParsedInternalKey* ikey) {
   if (!ParseInternalKey(k, ikey)) {
     status_ = Status::Corruption("corrupted internal key in DBIter");
     return false;
-  } else {
-    return true;
   }
+  // A value deleted by a range tombstone reads as a deletion.
+  if (range_dels_ != nullptr &&
+      (ikey->type == kTypeValue || ikey->type == kTypeMerge) &&
+      range_dels_->ShouldDelete(*ikey, sequence_)) {
+    ikey->type = kTypeDeletion;
+  }
+  return true;
 }
 
 void DBIter::Next() {
@@ -157,6 +185,14 @@ void DBIter::Next() {
       return;
     }
     // saved_key_ already contains the key to skip past.
+  } else if (current_entry_is_merged_) {
+    // saved_key_ contains the current key, and iter_ is already past its
+    // merge operands.
+    if (!iter_->Valid()) {
+      valid_ = false;
+      saved_key_.clear();
+      return;
+    }
   } else {
     // Store in saved_key_ the current key so we skip it below.
     SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
@@ -178,6 +214,7 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip) {
   // Loop until we hit an acceptable entry to yield
   assert(iter_->Valid());
   assert(direction_ == kForward);
+  current_entry_is_merged_ = false;
   do {
     ParsedInternalKey ikey;
     if (ParseKey(&ikey) && ikey.sequence <= sequence_) {
@@ -198,6 +235,18 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip) {
             return;
           }
           break;
+        case kTypeMerge:
+          if (skipping &&
+              user_comparator_->Compare(ikey.user_key, *skip) <= 0) {
+            // Entry hidden
+          } else {
+            MergeValuesNewToOld();
+            return;
+          }
+          break;
+        case kTypeRangeDeletion:
+          assert(false);  // Kept apart from the other entries
+          break;
       }
     }
     iter_->Next();
@@ -206,14 +255,65 @@ void DBIter::FindNextUserEntry(bool skipping, std::string* skip) {
   valid_ = false;
 }
 
+void DBIter::MergeValuesNewToOld() {
+  // iter_ is at the newest merge operand of the key; apply it and the
+  // older operands to the value they were written over.
+  SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
+  merge_operands_.clear();
+  merge_operands_.push_back(iter_->value().ToString());
+  Status s;
+  bool merged = false;
+  for (iter_->Next(); iter_->Valid(); iter_->Next()) {
+    ParsedInternalKey ikey;
+    if (!ParseKey(&ikey)) {
+      continue;
+    }
+    if (user_comparator_->Compare(ikey.user_key, saved_key_) != 0) {
+      break;
+    }
+    if (ikey.type == kTypeMerge) {
+      merge_operands_.push_back(iter_->value().ToString());
+    } else {
+      if (ikey.type == kTypeValue) {
+        const Slice existing_value = iter_->value();
+        s = FullMerge(merge_operator_, saved_key_, &existing_value,
+                      merge_operands_, &saved_value_);
+        merged = true;
+      }
+      break;
+    }
+  }
+  if (!merged) {
+    s = FullMerge(merge_operator_, saved_key_, nullptr, merge_operands_,
+                  &saved_value_);
+  }
+  if (!s.ok()) {
+    status_ = s;
+    valid_ = false;
+    saved_key_.clear();
+    return;
+  }
+  valid_ = true;
+  current_entry_is_merged_ = true;
+}
+
 void DBIter::Prev() {
   assert(valid_);
 
   if (direction_ == kForward) {  // Switch directions?
-    // iter_ is pointing at the current entry.  Scan backwards until
-    // the key changes so we can use the normal reverse scanning code.
-    assert(iter_->Valid());  // Otherwise valid_ would have been false
-    SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
+    // iter_ is pointing at the current entry (or past it, for an entry
+    // combined from merge operands).  Scan backwards until the key
+    // changes so we can use the normal reverse scanning code.
+    if (current_entry_is_merged_) {
+      // saved_key_ already contains the current key.
+      current_entry_is_merged_ = false;
+      if (!iter_->Valid()) {
+        iter_->SeekToLast();
+      }
+    } else {
+      assert(iter_->Valid());  // Otherwise valid_ would have been false
+      SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
+    }
     while (true) {
       iter_->Prev();
       if (!iter_->Valid()) {
@@ -235,8 +335,12 @@ void DBIter::Prev() {
 
 void DBIter::FindPrevUserEntry() {
   assert(direction_ == kReverse);
+  current_entry_is_merged_ = false;
 
   ValueType value_type = kTypeDeletion;
+  // Whether saved_value_ holds the value the merge operands in
+  // merge_operands_ (oldest first) apply to.
+  bool merge_base_is_value = false;
   if (iter_->Valid()) {
     do {
       ParsedInternalKey ikey;
@@ -246,6 +350,17 @@ void DBIter::FindPrevUserEntry() {
           // We encountered a non-deleted value in entries for previous keys,
           break;
         }
+        if (ikey.type == kTypeMerge) {
+          if (value_type != kTypeMerge) {
+            merge_base_is_value = (value_type == kTypeValue);
+            merge_operands_.clear();
+            SaveKey(ExtractUserKey(iter_->key()), &saved_key_);
+          }
+          merge_operands_.push_back(iter_->value().ToString());
+          value_type = kTypeMerge;
+          iter_->Prev();
+          continue;
+        }
         value_type = ikey.type;
         if (value_type == kTypeDeletion) {
           saved_key_.clear();
@@ -264,6 +379,21 @@ void DBIter::FindPrevUserEntry() {
     } while (iter_->Valid());
   }
 
+  if (value_type == kTypeMerge) {
+    std::reverse(merge_operands_.begin(), merge_operands_.end());
+    std::string existing;
+    existing.swap(saved_value_);
+    const Slice existing_value(existing);
+    Status s =
+        FullMerge(merge_operator_, saved_key_,
+                  merge_base_is_value ? &existing_value : nullptr,
+                  merge_operands_, &saved_value_);
+    if (!s.ok()) {
+      status_ = s;
+      value_type = kTypeDeletion;
+    }
+  }
+
   if (value_type == kTypeDeletion) {
     // End
     valid_ = false;
@@ -311,8 +441,10 @@ void DBIter::SeekToLast() {
 
 Iterator* NewDBIterator(DBImpl* db, const Comparator* user_key_comparator,
                         Iterator* internal_iter, SequenceNumber sequence,
-                        uint32_t seed) {
-  return new DBIter(db, user_key_comparator, internal_iter, sequence, seed);
+                        RangeTombstoneList* range_dels,
+                        const MergeOperator* merge_operator, uint32_t seed) {
+  return new DBIter(db, user_key_comparator, internal_iter, sequence,
+                    range_dels, merge_operator, seed);
 }
 
 }  // namespace leveldb
@@ -13,13 +13,19 @@
 namespace leveldb {
 
 class DBImpl;
+class MergeOperator;
+class RangeTombstoneList;
 
 // Return a new iterator that converts internal keys (yielded by
 // "*internal_iter") that were live at the specified "sequence" number
-// into appropriate user keys.
+// into appropriate user keys.  Values covered by a tombstone in
+// "*range_dels" are skipped.  The iterator takes ownership of
+// "range_dels", which may be null, and Finish() must have been called
+// on it.  Merge operands are combined by "merge_operator".
 Iterator* NewDBIterator(DBImpl* db, const Comparator* user_key_comparator,
                         Iterator* internal_iter, SequenceNumber sequence,
-                        uint32_t seed);
+                        RangeTombstoneList* range_dels,
+                        const MergeOperator* merge_operator, uint32_t seed);
 
 }  // namespace leveldb
 
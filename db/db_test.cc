@@ -14,11 +14,17 @@
 #include "db/version_set.h"
 #include "db/write_batch_internal.h"
 #include "leveldb/cache.h"
+#include "leveldb/compaction_filter.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
+#include "leveldb/memtablerep.h"
+#include "leveldb/merge_operator.h"
+#include "leveldb/rate_limiter.h"
 #include "leveldb/table.h"
+#include "leveldb/table_builder.h"
 #include "port/port.h"
 #include "port/thread_annotations.h"
+#include "util/coding.h"
 #include "util/hash.h"
 #include "util/logging.h"
 #include "util/mutexlock.h"
@@ -141,6 +147,9 @@ class SpecialEnv : public EnvWrapper {
   bool count_random_reads_;
   AtomicCounter random_read_counter_;
 
+  // Added to the time returned by NowMicros().
+  std::atomic<uint64_t> clock_offset_micros_;
+
   explicit SpecialEnv(Env* base)
       : EnvWrapper(base),
         delay_data_sync_(false),
@@ -150,7 +159,8 @@ class SpecialEnv : public EnvWrapper {
         manifest_sync_error_(false),
         manifest_write_error_(false),
         log_file_close_(false),
-        count_random_reads_(false) {}
+        count_random_reads_(false),
+        clock_offset_micros_(0) {}
 
   Status NewWritableFile(const std::string& f, WritableFile** r) {
     class DataFile : public WritableFile {
@@ -255,6 +265,11 @@ class SpecialEnv : public EnvWrapper {
     }
     return s;
   }
+
+  uint64_t NowMicros() override {
+    return target()->NowMicros() +
+           clock_offset_micros_.load(std::memory_order_acquire);
+  }
 };
 
 class DBTest : public testing::Test {
@@ -420,6 +435,12 @@ class DBTest : public testing::Test {
             case kTypeDeletion:
               result += "DEL";
               break;
+            case kTypeRangeDeletion:
+              result += "RANGEDEL";
+              break;
+            case kTypeMerge:
+              result += "+" + iter->value().ToString();
+              break;
           }
         }
         iter->Next();
@@ -442,7 +463,7 @@ class DBTest : public testing::Test {
 
   int TotalTableFiles() {
     int result = 0;
-    for (int level = 0; level < config::kNumLevels; level++) {
+    for (int level = 0; level < last_options_.num_levels; level++) {
       result += NumTableFilesAtLevel(level);
     }
     return result;
@@ -452,7 +473,7 @@ class DBTest : public testing::Test {
   std::string FilesPerLevel() {
     std::string result;
     int last_non_zero_offset = 0;
-    for (int level = 0; level < config::kNumLevels; level++) {
+    for (int level = 0; level < last_options_.num_levels; level++) {
       int f = NumTableFilesAtLevel(level);
       char buf[100];
       std::snprintf(buf, sizeof(buf), "%s%d", (level ? "," : ""), f);
@@ -496,7 +517,7 @@ class DBTest : public testing::Test {
   // Prevent pushing of new sstables into deeper levels by adding
   // tables that cover a specified range to all levels.
   void FillLevels(const std::string& smallest, const std::string& largest) {
-    MakeTables(config::kNumLevels, smallest, largest);
+    MakeTables(last_options_.num_levels, smallest, largest);
   }
 
   void DumpFileCounts(const char* label) {
@@ -504,7 +525,7 @@ class DBTest : public testing::Test {
     std::fprintf(
         stderr, "maxoverlap: %lld\n",
         static_cast<long long>(dbfull()->TEST_MaxNextLevelOverlappingBytes()));
-    for (int level = 0; level < config::kNumLevels; level++) {
+    for (int level = 0; level < last_options_.num_levels; level++) {
       int num = NumTableFilesAtLevel(level);
       if (num > 0) {
         std::fprintf(stderr, "  level %3d : %d files\n", level, num);
@@ -637,6 +658,130 @@ TEST_F(DBTest, GetFromImmutableLayer) {
   } while (ChangeOptions());
 }
 
+TEST_F(DBTest, GetFromImmutableQueue) {
+  for (bool merge : {false, true}) {
+    Options options = CurrentOptions();
+    options.env = env_;
+    options.create_if_missing = true;
+    options.write_buffer_size = 100000;  // Small write buffer
+    options.max_write_buffer_number = 4;
+    options.merge_immutable_memtables = merge;
+    DestroyAndReopen(&options);
+
+    // Block sync calls so that sealed memtables queue up.
+    env_->delay_data_sync_.store(true, std::memory_order_release);
+    ASSERT_LEVELDB_OK(Put("foo", "v1"));
+    const Snapshot* snapshot = db_->GetSnapshot();
+    ASSERT_LEVELDB_OK(Put("k1", std::string(100000, 'x')));  // Fill memtable.
+    ASSERT_LEVELDB_OK(Put("foo", "v2"));
+    ASSERT_LEVELDB_OK(Put("k2", std::string(100000, 'y')));
+    ASSERT_LEVELDB_OK(Put("foo", "v3"));
+    ASSERT_EQ("v3", Get("foo"));
+    ASSERT_EQ("v1", Get("foo", snapshot));
+    ASSERT_EQ(std::string(100000, 'x'), Get("k1"));
+    ASSERT_EQ("[ v3, v2, v1 ]", AllEntriesFor("foo"));
+    // Release sync calls.
+    env_->delay_data_sync_.store(false, std::memory_order_release);
+
+    ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+    ASSERT_EQ("v3", Get("foo"));
+    ASSERT_EQ("v1", Get("foo", snapshot));
+    db_->ReleaseSnapshot(snapshot);
+    Reopen(&options);
+    ASSERT_EQ("v3", Get("foo"));
+    ASSERT_EQ(std::string(100000, 'y'), Get("k2"));
+  }
+}
+
+TEST_F(DBTest, MemTableBloom) {
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.create_if_missing = true;
+  options.write_buffer_size = 100000;
+  options.memtable_bloom_size_ratio = 0.1;
+  DestroyAndReopen(&options);
+
+  // Block sync calls so that the first memtable stays immutable.
+  env_->delay_data_sync_.store(true, std::memory_order_release);
+  ASSERT_LEVELDB_OK(Put("foo", "v1"));
+  ASSERT_LEVELDB_OK(Put("k1", std::string(100000, 'x')));  // Fill memtable.
+  ASSERT_LEVELDB_OK(Put("bar", "v2"));  // Goes to a new memtable
+  ASSERT_EQ("v1", Get("foo"));
+  ASSERT_EQ("v2", Get("bar"));
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_EQ("NOT_FOUND", Get("missing" + NumberToString(i)));
+  }
+  env_->delay_data_sync_.store(false, std::memory_order_release);
+}
+
+TEST_F(DBTest, HugePageMemTable) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.write_buffer_size = 8 << 20;
+  options.memtable_huge_page_size = 2 << 20;
+  options.memtable_numa_aware = true;
+  DestroyAndReopen(&options);
+
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_LEVELDB_OK(Put("key" + NumberToString(i), std::string(1000, 'v')));
+  }
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_EQ(std::string(1000, 'v'), Get("key" + NumberToString(i)));
+  }
+  std::string usage;
+  ASSERT_TRUE(db_->GetProperty("leveldb.approximate-memory-usage", &usage));
+  ASSERT_GE(std::stoull(usage), 1000u * 1000u);
+  Reopen(&options);
+  ASSERT_EQ(std::string(1000, 'v'), Get("key999"));
+}
+
+TEST_F(DBTest, InplaceUpdate) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.inplace_update_support = true;
+  DestroyAndReopen(&options);
+
+  // Same-size and smaller overwrites reuse the entry.
+  ASSERT_LEVELDB_OK(Put("foo", "v10"));
+  for (int i = 11; i < 100; i++) {
+    ASSERT_LEVELDB_OK(Put("foo", "v" + NumberToString(i)));
+  }
+  ASSERT_LEVELDB_OK(Put("foo", "v1"));
+  ASSERT_EQ("v1", Get("foo"));
+  ASSERT_EQ("[ v1 ]", AllEntriesFor("foo"));
+
+  // A larger value needs a new entry.
+  ASSERT_LEVELDB_OK(Put("foo", "v100"));
+  ASSERT_EQ("[ v100, v1 ]", AllEntriesFor("foo"));
+
+  // A deletion is never overwritten.
+  ASSERT_LEVELDB_OK(Delete("foo"));
+  ASSERT_LEVELDB_OK(Put("foo", "v2"));
+  ASSERT_EQ("[ v2, DEL, v100, v1 ]", AllEntriesFor("foo"));
+
+  // Versions visible to a snapshot are kept.
+  const Snapshot* snapshot = db_->GetSnapshot();
+  ASSERT_LEVELDB_OK(Put("foo", "v3"));
+  ASSERT_EQ("v2", Get("foo", snapshot));
+  ASSERT_EQ("v3", Get("foo"));
+  db_->ReleaseSnapshot(snapshot);
+
+  // So are those an open iterator reads.
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  ASSERT_LEVELDB_OK(Put("foo", "v4"));
+  iter->Seek("foo");
+  ASSERT_TRUE(iter->Valid());
+  ASSERT_EQ("v3", iter->value().ToString());
+  delete iter;
+  ASSERT_EQ("[ v4, v3, v2, DEL, v100, v1 ]", AllEntriesFor("foo"));
+
+  ASSERT_LEVELDB_OK(Put("foo", "v5"));
+  ASSERT_EQ("v5", Get("foo"));
+  ASSERT_EQ("[ v5, v3, v2, DEL, v100, v1 ]", AllEntriesFor("foo"));
+  Reopen(&options);
+  ASSERT_EQ("v5", Get("foo"));
+}
+
 TEST_F(DBTest, GetFromVersions) {
   do {
     ASSERT_LEVELDB_OK(Put("foo", "v1"));
@@ -1048,6 +1193,47 @@ TEST_F(DBTest, RecoveryWithEmptyLog) {
   } while (ChangeOptions());
 }
 
+TEST_F(DBTest, DisableWAL) {
+  do {
+    WriteOptions unlogged;
+    unlogged.disable_wal = true;
+    ASSERT_LEVELDB_OK(db_->Put(unlogged, "foo", "v1"));
+    ASSERT_LEVELDB_OK(Put("bar", "v2"));
+    ASSERT_LEVELDB_OK(db_->Put(unlogged, "baz", "v3"));
+    ASSERT_EQ("v1", Get("foo"));
+
+    // A clean close flushes the unlogged writes to a table.
+    Reopen();
+    ASSERT_EQ("v1", Get("foo"));
+    ASSERT_EQ("v2", Get("bar"));
+    ASSERT_EQ("v3", Get("baz"));
+
+    // Logged writes issued after unlogged ones keep their order.
+    ASSERT_LEVELDB_OK(db_->Put(unlogged, "foo", "v4"));
+    ASSERT_LEVELDB_OK(Put("foo", "v5"));
+    Reopen();
+    ASSERT_EQ("v5", Get("foo"));
+  } while (ChangeOptions());
+}
+
+TEST_F(DBTest, RecoverCompressedLog) {
+  const CompressionType types[] = {kSnappyCompression, kZstdCompression};
+  for (CompressionType type : types) {
+    Options options = CurrentOptions();
+    options.create_if_missing = true;
+    options.wal_compression = type;
+    DestroyAndReopen(&options);
+    ASSERT_LEVELDB_OK(Put("foo", "v1"));
+    ASSERT_LEVELDB_OK(Put("big", std::string(100000, 'x')));
+
+    // Logs written with compression are readable without it.
+    options.wal_compression = kNoCompression;
+    Reopen(&options);
+    ASSERT_EQ("v1", Get("foo"));
+    ASSERT_EQ(std::string(100000, 'x'), Get("big"));
+  }
+}
+
 // Check that writes done during a memtable compaction are recovered
 // if the database is shutdown during the memtable compaction.
 TEST_F(DBTest, RecoverDuringMemtableCompaction) {
@@ -1079,6 +1265,732 @@ static std::string Key(int i) {
   return std::string(buf);
 }
 
+TEST_F(DBTest, ParallelFlush) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.write_buffer_size = 16 << 20;
+  options.flush_parallelism = 4;
+  DestroyAndReopen(&options);
+
+  // Overwrite every key once so that some user keys have two entries.
+  const int kNumKeys = 4000;
+  for (int pass = 0; pass < 2; pass++) {
+    for (int i = 0; i < kNumKeys; i++) {
+      std::string value(1000, static_cast<char>('a' + (i + pass) % 26));
+      ASSERT_LEVELDB_OK(Put(Key(i), value));
+    }
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ(4, TotalTableFiles());
+
+  Reopen(&options);
+  for (int i = 0; i < kNumKeys; i++) {
+    ASSERT_EQ(std::string(1000, static_cast<char>('a' + (i + 1) % 26)),
+              Get(Key(i)));
+  }
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    count++;
+  }
+  ASSERT_LEVELDB_OK(iter->status());
+  ASSERT_EQ(kNumKeys, count);
+  delete iter;
+}
+
+TEST_F(DBTest, MemTableFlushTriggers) {
+  for (int trigger = 0; trigger < 3; trigger++) {
+    Options options = CurrentOptions();
+    options.create_if_missing = true;
+    if (trigger == 1) {
+      options.memtable_max_entries = 1000;
+    } else if (trigger == 2) {
+      options.memtable_max_deletion_ratio = 0.5;
+    }
+    DestroyAndReopen(&options);
+
+    // 1200 small entries, half of them deletions, then one more write.
+    for (int i = 0; i < 600; i++) {
+      ASSERT_LEVELDB_OK(Put(Key(i), "v"));
+    }
+    for (int i = 0; i < 600; i++) {
+      ASSERT_LEVELDB_OK(Delete(Key(i)));
+    }
+    ASSERT_LEVELDB_OK(Put("z", "v"));
+    ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+    ASSERT_EQ(trigger == 0 ? 1 : 2, TotalTableFiles()) << trigger;
+    ASSERT_EQ("(z->v)", Contents());
+  }
+}
+
+TEST_F(DBTest, DeletionTriggeredCompaction) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  DestroyAndReopen(&options);
+
+  // A file of values pushed to level-2, then a file of deletions of most
+  // of them, which stays at level-1 above it.
+  for (int i = 0; i < 2000; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), "v"));
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  for (int i = 0; i < 1500; i++) {
+    ASSERT_LEVELDB_OK(Delete(Key(i)));
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  DelayMilliseconds(100);
+  ASSERT_EQ("0,1,1", FilesPerLevel());
+
+  // The deletion counts are kept in the descriptor, so the reopened DB
+  // compacts the deletions away.
+  options.deletion_compaction_ratio = 0.5;
+  Reopen(&options);
+  for (int i = 0; i < 100 && NumTableFilesAtLevel(1) > 0; i++) {
+    DelayMilliseconds(10);
+  }
+  ASSERT_EQ("0,0,1", FilesPerLevel());
+  ASSERT_EQ("[ ]", AllEntriesFor(Key(0)));
+  ASSERT_EQ("NOT_FOUND", Get(Key(0)));
+  ASSERT_EQ("v", Get(Key(1500)));
+}
+
+TEST_F(DBTest, PeriodicCompaction) {
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.create_if_missing = true;
+  options.periodic_compaction_seconds = 3600;
+  DestroyAndReopen(&options);
+
+  // Two files that no size or seek trigger compacts, the one at level-1
+  // created 3000 seconds after the one at level-2.
+  ASSERT_LEVELDB_OK(Put("a", "v1"));
+  ASSERT_LEVELDB_OK(Put("b", "v1"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  env_->clock_offset_micros_.store(uint64_t{3000} * 1000000,
+                                   std::memory_order_release);
+  ASSERT_LEVELDB_OK(Put("a", "v2"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  DelayMilliseconds(100);
+  ASSERT_EQ("0,1,1", FilesPerLevel());
+
+  // The creation times are kept in the descriptor: once the older file is
+  // old enough, the reopened DB compacts it down, and only it.
+  env_->clock_offset_micros_.store(uint64_t{5000} * 1000000,
+                                   std::memory_order_release);
+  Reopen(&options);
+  for (int i = 0; i < 100 && FilesPerLevel() != "0,1,0,1"; i++) {
+    DelayMilliseconds(10);
+  }
+  DelayMilliseconds(100);
+  ASSERT_EQ("0,1,0,1", FilesPerLevel());
+  ASSERT_EQ("[ v2, v1 ]", AllEntriesFor("a"));
+
+  // Then the newer one.  The outputs are new, so they are left alone.
+  env_->clock_offset_micros_.store(uint64_t{7000} * 1000000,
+                                   std::memory_order_release);
+  Reopen(&options);
+  for (int i = 0; i < 100 && FilesPerLevel() != "0,0,1,1"; i++) {
+    DelayMilliseconds(10);
+  }
+  DelayMilliseconds(100);
+  ASSERT_EQ("0,0,1,1", FilesPerLevel());
+  ASSERT_EQ("v2", Get("a"));
+  ASSERT_EQ("v1", Get("b"));
+  env_->clock_offset_micros_.store(0, std::memory_order_release);
+}
+
+TEST_F(DBTest, DeleteRange) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  DestroyAndReopen(&options);
+  ASSERT_LEVELDB_OK(Put("a", "va"));
+  ASSERT_LEVELDB_OK(Put("b", "vb"));
+  ASSERT_LEVELDB_OK(Put("c", "vc"));
+  ASSERT_LEVELDB_OK(Put("d", "vd"));
+  ASSERT_LEVELDB_OK(db_->DeleteRange(WriteOptions(), "b", "d"));
+  ASSERT_EQ("va", Get("a"));
+  ASSERT_EQ("NOT_FOUND", Get("b"));
+  ASSERT_EQ("NOT_FOUND", Get("c"));
+  ASSERT_EQ("vd", Get("d"));
+  ASSERT_EQ("(a->va)(d->vd)", Contents());
+
+  // Later writes are not deleted.
+  ASSERT_LEVELDB_OK(Put("c", "vc2"));
+  ASSERT_EQ("vc2", Get("c"));
+  ASSERT_EQ("(a->va)(c->vc2)(d->vd)", Contents());
+
+  // Empty and inverted ranges.
+  ASSERT_LEVELDB_OK(db_->DeleteRange(WriteOptions(), "c", "c"));
+  ASSERT_TRUE(db_->DeleteRange(WriteOptions(), "d", "a").IsInvalidArgument());
+  ASSERT_EQ("(a->va)(c->vc2)(d->vd)", Contents());
+
+  // Recovered from the log and kept across flushes.
+  Reopen(&options);
+  ASSERT_EQ("(a->va)(c->vc2)(d->vd)", Contents());
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ("NOT_FOUND", Get("b"));
+  ASSERT_EQ("(a->va)(c->vc2)(d->vd)", Contents());
+}
+
+TEST_F(DBTest, DeleteRangeOverTables) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  DestroyAndReopen(&options);
+  for (int i = 0; i < 100; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), "v1"));
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+  const Snapshot* snapshot = db_->GetSnapshot();
+
+  // The tombstone is in the memtable, then in a table of its own.
+  ASSERT_LEVELDB_OK(db_->DeleteRange(WriteOptions(), Key(10), Key(90)));
+  ASSERT_EQ("v1", Get(Key(9)));
+  ASSERT_EQ("NOT_FOUND", Get(Key(10)));
+  ASSERT_EQ("NOT_FOUND", Get(Key(89)));
+  ASSERT_EQ("v1", Get(Key(90)));
+  ASSERT_EQ("v1", Get(Key(50), snapshot));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ("NOT_FOUND", Get(Key(50)));
+  ASSERT_EQ("v1", Get(Key(50), snapshot));
+
+  Iterator* iter = db_->NewIterator(ReadOptions());
+  iter->Seek(Key(5));
+  int count = 0;
+  for (; iter->Valid(); iter->Next()) {
+    count++;
+  }
+  ASSERT_EQ(15, count);
+  iter->Seek(Key(50));
+  ASSERT_EQ(Key(90), iter->key().ToString());
+  iter->Prev();
+  ASSERT_EQ(Key(9), iter->key().ToString());
+  delete iter;
+
+  // The snapshot keeps the covered entries through compactions.
+  dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+  dbfull()->TEST_CompactRange(1, nullptr, nullptr);
+  ASSERT_EQ("NOT_FOUND", Get(Key(50)));
+  ASSERT_EQ("v1", Get(Key(50), snapshot));
+  ASSERT_EQ("[ v1 ]", AllEntriesFor(Key(50)));
+
+  // Without it they are dropped, and so is the tombstone.
+  db_->ReleaseSnapshot(snapshot);
+  dbfull()->TEST_CompactRange(2, nullptr, nullptr);
+  ASSERT_EQ("[ ]", AllEntriesFor(Key(50)));
+  ASSERT_EQ("v1", Get(Key(9)));
+  ASSERT_EQ("NOT_FOUND", Get(Key(50)));
+
+  ASSERT_LEVELDB_OK(db_->DeleteRange(WriteOptions(), Key(0), Key(100)));
+  dbfull()->CompactRange(nullptr, nullptr);
+  ASSERT_EQ(0, TotalTableFiles());
+  ASSERT_EQ("", Contents());
+}
+
+TEST_F(DBTest, DeleteRangeRandomized) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.write_buffer_size = 10000;
+  DestroyAndReopen(&options);
+
+  Random rnd(test::RandomSeed());
+  std::map<std::string, std::string> model;
+  for (int step = 0; step < 3000; step++) {
+    const int p = rnd.Uniform(100);
+    if (p < 80) {
+      const std::string k = Key(rnd.Uniform(1000));
+      const std::string v = RandomString(&rnd, 50);
+      ASSERT_LEVELDB_OK(Put(k, v));
+      model[k] = v;
+    } else if (p < 90) {
+      const std::string k = Key(rnd.Uniform(1000));
+      ASSERT_LEVELDB_OK(Delete(k));
+      model.erase(k);
+    } else {
+      const int begin = rnd.Uniform(1000);
+      const std::string b = Key(begin);
+      const std::string e = Key(begin + rnd.Uniform(100));
+      ASSERT_LEVELDB_OK(db_->DeleteRange(WriteOptions(), b, e));
+      model.erase(model.lower_bound(b), model.lower_bound(e));
+    }
+
+    if (step % 500 == 499) {
+      if (step % 1000 == 999) {
+        dbfull()->CompactRange(nullptr, nullptr);
+      } else {
+        Reopen(&options);
+      }
+      std::string expected;
+      for (const auto& kv : model) {
+        expected += "(" + kv.first + "->" + kv.second + ")";
+      }
+      ASSERT_EQ(expected, Contents());
+      for (int i = 0; i < 1000; i++) {
+        auto it = model.find(Key(i));
+        ASSERT_EQ(it == model.end() ? "NOT_FOUND" : it->second, Get(Key(i)));
+      }
+    }
+  }
+}
+
+TEST_F(DBTest, UniversalCompaction) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.compaction_style = kCompactionStyleUniversal;
+  DestroyAndReopen(&options);
+
+  // Every flush adds a sorted run to level-0.
+  const int trigger = options.level0_file_num_compaction_trigger;
+  for (int run = 0; run < trigger - 1; run++) {
+    for (int i = 0; i < 100; i++) {
+      ASSERT_LEVELDB_OK(Put(Key(i), "v" + std::to_string(run)));
+    }
+    ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+    ASSERT_EQ(run + 1, NumTableFilesAtLevel(0));
+  }
+  ASSERT_EQ("v2", Get(Key(7)));
+
+  // Runs of similar size are merged into one once there are enough.
+  for (int i = 0; i < 100; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), "v3"));
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  for (int i = 0; i < 100 && NumTableFilesAtLevel(0) > 1; i++) {
+    DelayMilliseconds(10);
+  }
+  ASSERT_EQ("1", FilesPerLevel());
+  ASSERT_EQ("v3", Get(Key(7)));
+
+  // A full merge drops deletions.
+  ASSERT_LEVELDB_OK(Delete(Key(7)));
+  dbfull()->CompactRange(nullptr, nullptr);
+  ASSERT_EQ("1", FilesPerLevel());
+  ASSERT_EQ("[ ]", AllEntriesFor(Key(7)));
+  ASSERT_EQ("v3", Get(Key(8)));
+
+  Reopen(&options);
+  ASSERT_EQ("NOT_FOUND", Get(Key(7)));
+  ASSERT_EQ("v3", Get(Key(99)));
+}
+
+TEST_F(DBTest, UniversalCompactionKeepsOlderRuns) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.compaction_style = kCompactionStyleUniversal;
+  DestroyAndReopen(&options);
+
+  // One large run, then small runs that are merged without it.
+  Random rnd(301);
+  for (int i = 0; i < 100; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), RandomString(&rnd, 1000)));
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_LEVELDB_OK(Delete(Key(1)));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  const int trigger = options.level0_file_num_compaction_trigger;
+  for (int run = 0; run < trigger - 2; run++) {
+    ASSERT_LEVELDB_OK(Put(Key(2), "small"));
+    ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  }
+  for (int i = 0; i < 100 && NumTableFilesAtLevel(0) > 2; i++) {
+    DelayMilliseconds(10);
+  }
+  ASSERT_EQ("2", FilesPerLevel());
+
+  // The deletion still hides the value in the older run.
+  ASSERT_EQ("NOT_FOUND", Get(Key(1)));
+  const std::string entries = AllEntriesFor(Key(1));
+  ASSERT_EQ("[ DEL, ", entries.substr(0, 7));
+  ASSERT_EQ("small", Get(Key(2)));
+}
+
+TEST_F(DBTest, DynamicLevelBytes) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.level_compaction_dynamic_level_bytes = true;
+  options.write_buffer_size = 100000;
+  DestroyAndReopen(&options);
+
+  // While the database is small all data goes to the last level.
+  Random rnd(301);
+  std::vector<std::string> values;
+  for (int i = 0; i < 500; i++) {
+    values.push_back(RandomString(&rnd, 1000));
+    ASSERT_LEVELDB_OK(Put(Key(i), values[i]));
+  }
+  dbfull()->CompactRange(nullptr, nullptr);
+  ASSERT_EQ(0, NumTableFilesAtLevel(0));
+  for (int level = 1; level < last_options_.num_levels - 1; level++) {
+    ASSERT_EQ(0, NumTableFilesAtLevel(level)) << level;
+  }
+  ASSERT_GT(NumTableFilesAtLevel(last_options_.num_levels - 1), 0);
+
+  // Later flushes are compacted straight into it as well.
+  for (int i = 0; i < 500; i += 2) {
+    values[i] = RandomString(&rnd, 1000);
+    ASSERT_LEVELDB_OK(Put(Key(i), values[i]));
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  dbfull()->TEST_CompactRange(0, nullptr, nullptr);
+  ASSERT_EQ(0, NumTableFilesAtLevel(0));
+  for (int level = 1; level < last_options_.num_levels - 1; level++) {
+    ASSERT_EQ(0, NumTableFilesAtLevel(level)) << level;
+  }
+  for (int i = 0; i < 500; i++) {
+    ASSERT_EQ(values[i], Get(Key(i)));
+  }
+}
+
+TEST_F(DBTest, NumLevels) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.num_levels = 3;
+  DestroyAndReopen(&options);
+  ASSERT_LEVELDB_OK(Put("foo", "v1"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ("0,0,1", FilesPerLevel());
+  std::string value;
+  ASSERT_FALSE(db_->GetProperty("leveldb.num-files-at-level3", &value));
+
+  // Files would be out of reach with fewer levels.
+  options.num_levels = 2;
+  ASSERT_TRUE(TryReopen(&options).IsInvalidArgument());
+  options.num_levels = 5;
+  Reopen(&options);
+  ASSERT_EQ("v1", Get("foo"));
+  ASSERT_LEVELDB_OK(Put("bar", "v2"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ("0,0,2", FilesPerLevel());
+  Reopen(&options);
+  ASSERT_EQ("(bar->v2)(foo->v1)", Contents());
+}
+
+TEST_F(DBTest, SetOptions) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  DestroyAndReopen(&options);
+  ASSERT_TRUE(
+      db_->SetOptions({{"write_buffer_size", "1"}}).IsInvalidArgument());
+  ASSERT_TRUE(db_->SetOptions({{"level0_stop_writes_trigger", "x"}})
+                  .IsInvalidArgument());
+
+  // Level-0 is compacted once it holds two files.
+  ASSERT_LEVELDB_OK(
+      db_->SetOptions({{"level0_file_num_compaction_trigger", "2"},
+                       {"max_mem_compaction_level", "0"},
+                       {"max_bytes_for_level_multiplier", "4.5"}}));
+  ASSERT_LEVELDB_OK(Put("foo", "v1"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ("1", FilesPerLevel());
+  ASSERT_LEVELDB_OK(Put("foo", "v2"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  for (int i = 0; i < 100 && NumTableFilesAtLevel(0) > 0; i++) {
+    DelayMilliseconds(10);
+  }
+  ASSERT_EQ("0,1", FilesPerLevel());
+  ASSERT_EQ("v2", Get("foo"));
+}
+
+namespace {
+
+// Drops keys starting with "drop" and sets keys starting with "change"
+// to "new".
+class TestCompactionFilter : public CompactionFilter {
+ public:
+  bool Filter(int level, const Slice& key, const Slice& existing_value,
+              std::string* new_value, bool* value_changed) const override {
+    if (key.starts_with("drop")) {
+      return true;
+    }
+    if (key.starts_with("change") && existing_value != "new") {
+      new_value->assign("new");
+      *value_changed = true;
+    }
+    return false;
+  }
+
+  const char* Name() const override { return "TestCompactionFilter"; }
+};
+
+}  // namespace
+
+TEST_F(DBTest, CompactionFilter) {
+  TestCompactionFilter filter;
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.compaction_filter = &filter;
+  DestroyAndReopen(&options);
+
+  // Flushes are not filtered.
+  ASSERT_LEVELDB_OK(Put("drop1", "v1"));
+  ASSERT_LEVELDB_OK(Put("keep", "v1"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ("v1", Get("drop1"));
+
+  ASSERT_LEVELDB_OK(Put("drop2", "v1"));
+  const Snapshot* snapshot = db_->GetSnapshot();
+  ASSERT_LEVELDB_OK(Put("drop1", "v2"));
+  ASSERT_LEVELDB_OK(Put("change", "v1"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  db_->CompactRange(nullptr, nullptr);
+
+  // Values the snapshot sees are left alone; the older value of "drop1"
+  // stays hidden behind a deletion marker.
+  ASSERT_EQ("NOT_FOUND", Get("drop1"));
+  ASSERT_EQ("v1", Get("drop2"));
+  ASSERT_EQ("new", Get("change"));
+  ASSERT_EQ("v1", Get("keep"));
+  ASSERT_EQ("v1", Get("drop1", snapshot));
+  ASSERT_EQ("v1", Get("drop2", snapshot));
+  ASSERT_EQ("NOT_FOUND", Get("change", snapshot));
+  ASSERT_EQ("[ DEL, v1 ]", AllEntriesFor("drop1"));
+
+  db_->ReleaseSnapshot(snapshot);
+  const int last = last_options_.num_levels - 1;
+  for (int level = 0; level < last; level++) {
+    dbfull()->TEST_CompactRange(level, nullptr, nullptr);
+  }
+  ASSERT_EQ("[ ]", AllEntriesFor("drop1"));
+  ASSERT_EQ("[ ]", AllEntriesFor("drop2"));
+  ASSERT_EQ("(change->new)(keep->v1)", Contents());
+}
+
+namespace {
+
+// Appends the operands to the value, separated by commas.  Fails on an
+// operand of "bad".
+class AppendMergeOperator : public MergeOperator {
+ public:
+  bool FullMerge(const Slice& key, const Slice* existing_value,
+                 const std::vector<Slice>& operands,
+                 std::string* new_value) const override {
+    new_value->clear();
+    if (existing_value != nullptr) {
+      new_value->assign(existing_value->data(), existing_value->size());
+    }
+    for (const Slice& operand : operands) {
+      if (operand == "bad") {
+        return false;
+      }
+      if (!new_value->empty()) {
+        new_value->push_back(',');
+      }
+      new_value->append(operand.data(), operand.size());
+    }
+    return true;
+  }
+
+  const char* Name() const override { return "AppendMergeOperator"; }
+};
+
+}  // namespace
+
+TEST_F(DBTest, Merge) {
+  AppendMergeOperator merge_operator;
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.merge_operator = &merge_operator;
+  DestroyAndReopen(&options);
+
+  ASSERT_LEVELDB_OK(db_->Merge(WriteOptions(), "a", "1"));
+  ASSERT_LEVELDB_OK(db_->Merge(WriteOptions(), "a", "2"));
+  ASSERT_LEVELDB_OK(Put("b", "x"));
+  ASSERT_LEVELDB_OK(db_->Merge(WriteOptions(), "b", "y"));
+  ASSERT_LEVELDB_OK(db_->Merge(WriteOptions(), "c", "1"));
+  ASSERT_LEVELDB_OK(Delete("c"));
+  ASSERT_LEVELDB_OK(db_->Merge(WriteOptions(), "c", "2"));
+  ASSERT_EQ("1,2", Get("a"));
+  ASSERT_EQ("x,y", Get("b"));
+  ASSERT_EQ("2", Get("c"));
+  ASSERT_EQ("(a->1,2)(b->x,y)(c->2)", Contents());
+
+  // Operands spread over the memtable and several tables.
+  const Snapshot* snapshot = db_->GetSnapshot();
+  ASSERT_LEVELDB_OK(db_->Merge(WriteOptions(), "a", "3"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_LEVELDB_OK(db_->Merge(WriteOptions(), "a", "4"));
+  ASSERT_EQ("1,2,3,4", Get("a"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_EQ("1,2,3,4", Get("a"));
+  ASSERT_EQ("1,2", Get("a", snapshot));
+  ASSERT_EQ("(a->1,2,3,4)(b->x,y)(c->2)", Contents());
+
+  // Compactions combine operands, but keep those the snapshot must not
+  // see apart.
+  const int last = last_options_.num_levels - 1;
+  for (int level = 0; level < last; level++) {
+    dbfull()->TEST_CompactRange(level, nullptr, nullptr);
+  }
+  ASSERT_EQ("[ +4, +3, 1,2 ]", AllEntriesFor("a"));
+  ASSERT_EQ("[ x,y ]", AllEntriesFor("b"));
+  ASSERT_EQ("1,2", Get("a", snapshot));
+  db_->ReleaseSnapshot(snapshot);
+  ASSERT_LEVELDB_OK(db_->Merge(WriteOptions(), "a", "5"));
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  db_->CompactRange(nullptr, nullptr);
+  ASSERT_EQ("[ 1,2,3,4,5 ]", AllEntriesFor("a"));
+  ASSERT_EQ("(a->1,2,3,4,5)(b->x,y)(c->2)", Contents());
+
+  // Operands that cannot be applied make reads of their key fail, and are
+  // kept by compactions.
+  ASSERT_LEVELDB_OK(db_->Merge(WriteOptions(), "d", "bad"));
+  std::string value;
+  ASSERT_TRUE(db_->Get(ReadOptions(), "d", &value).IsCorruption());
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  db_->CompactRange(nullptr, nullptr);
+  ASSERT_EQ("[ +bad ]", AllEntriesFor("d"));
+  ASSERT_TRUE(db_->Get(ReadOptions(), "d", &value).IsCorruption());
+
+  options.merge_operator = nullptr;
+  DestroyAndReopen(&options);
+  ASSERT_TRUE(db_->Merge(WriteOptions(), "a", "1").IsInvalidArgument());
+}
+
+TEST_F(DBTest, MergeUInt64Add) {
+  const MergeOperator* merge_operator = NewUInt64AddOperator();
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.merge_operator = merge_operator;
+  DestroyAndReopen(&options);
+
+  std::string one;
+  PutFixed64(&one, 1);
+  for (int i = 0; i < 100; i++) {
+    ASSERT_LEVELDB_OK(db_->Merge(WriteOptions(), "counter", one));
+    if (i % 10 == 9) {
+      ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+    }
+  }
+  ASSERT_EQ(uint64_t{100}, DecodeFixed64(Get("counter").data()));
+  db_->CompactRange(nullptr, nullptr);
+  ASSERT_EQ(uint64_t{100}, DecodeFixed64(Get("counter").data()));
+
+  Close();
+  delete merge_operator;
+}
+
+// Write "kvs", sorted by key, to a table file built as an external
+// program would.
+static Status WriteExternalTable(
+    Env* env, const std::string& fname,
+    const std::vector<std::pair<std::string, std::string>>& kvs) {
+  WritableFile* file;
+  Status s = env->NewWritableFile(fname, &file);
+  if (!s.ok()) {
+    return s;
+  }
+  TableBuilder builder(Options(), file);
+  for (const auto& kv : kvs) {
+    builder.Add(kv.first, kv.second);
+  }
+  s = builder.Finish();
+  if (s.ok()) {
+    s = file->Close();
+  }
+  delete file;
+  return s;
+}
+
+TEST_F(DBTest, IngestExternalFile) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  DestroyAndReopen(&options);
+  ASSERT_LEVELDB_OK(Put("a", "va"));
+  ASSERT_LEVELDB_OK(Put("k5", "old"));
+  const Snapshot* snapshot = db_->GetSnapshot();
+
+  const std::string file1 = dbname_ + "_ingest1";
+  const std::string file2 = dbname_ + "_ingest2";
+  std::vector<std::pair<std::string, std::string>> kvs1, kvs2;
+  for (int i = 0; i < 10; i++) {
+    kvs1.push_back({"k" + std::to_string(i), "new" + std::to_string(i)});
+  }
+  for (int i = 0; i < 5; i++) {
+    kvs2.push_back({"m" + std::to_string(i), "m"});
+  }
+  ASSERT_LEVELDB_OK(WriteExternalTable(env_, file1, kvs1));
+  ASSERT_LEVELDB_OK(WriteExternalTable(env_, file2, kvs2));
+
+  // Overlapping files and missing files are rejected.
+  ASSERT_TRUE(db_->IngestExternalFile({file1, file1}).IsInvalidArgument());
+  ASSERT_TRUE(!db_->IngestExternalFile({dbname_ + "_missing"}).ok());
+  ASSERT_EQ("old", Get("k5"));
+
+  // The memtable is flushed to level-2.  The file overlapping it lands
+  // just above, the other one in the last level.
+  ASSERT_LEVELDB_OK(db_->IngestExternalFile({file2, file1}));
+  ASSERT_EQ("0,1,1,0,0,0,1", FilesPerLevel());
+  ASSERT_EQ("va", Get("a"));
+  ASSERT_EQ("new5", Get("k5"));
+  ASSERT_EQ("old", Get("k5", snapshot));
+  ASSERT_EQ("NOT_FOUND", Get("k0", snapshot));
+  ASSERT_EQ("m", Get("m4"));
+  db_->ReleaseSnapshot(snapshot);
+
+  // Later writes are newer than the ingested data, also after reopening.
+  Reopen(&options);
+  ASSERT_EQ("new5", Get("k5"));
+  ASSERT_LEVELDB_OK(Put("k5", "newer"));
+  ASSERT_EQ("newer", Get("k5"));
+  ASSERT_LEVELDB_OK(Delete("m0"));
+  dbfull()->TEST_CompactMemTable();
+  ASSERT_EQ("newer", Get("k5"));
+  ASSERT_EQ("NOT_FOUND", Get("m0"));
+  ASSERT_EQ("m", Get("m1"));
+
+  ASSERT_LEVELDB_OK(env_->RemoveFile(file1));
+  ASSERT_LEVELDB_OK(env_->RemoveFile(file2));
+}
+
+TEST_F(DBTest, MemTableRepFactories) {
+  MemTableRepFactory* factories[] = {NewInlineSkipListRepFactory(),
+                                     NewHashSkipListRepFactory(1, 100),
+                                     NewVectorRepFactory(16)};
+  for (MemTableRepFactory* factory : factories) {
+    Options options = CurrentOptions();
+    options.create_if_missing = true;
+    options.write_buffer_size = 100000;
+    options.memtable_factory = factory;
+    DestroyAndReopen(&options);
+
+    Random rnd(301);
+    std::map<std::string, std::string> model;
+    for (int i = 0; i < 2000; i++) {
+      const std::string k = Key(rnd.Uniform(500));
+      const std::string v = RandomString(&rnd, 100);
+      ASSERT_LEVELDB_OK(Put(k, v));
+      model[k] = v;
+      if (i % 100 == 0) {
+        ASSERT_LEVELDB_OK(Delete(k));
+        model.erase(k);
+      }
+    }
+    for (const auto& kv : model) {
+      ASSERT_EQ(kv.second, Get(kv.first));
+    }
+    ASSERT_EQ("NOT_FOUND", Get("missing"));
+
+    // Iteration is in key order across memtables and tables.
+    Iterator* iter = db_->NewIterator(ReadOptions());
+    auto expected = model.begin();
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next(), ++expected) {
+      ASSERT_TRUE(expected != model.end());
+      ASSERT_EQ(expected->first, iter->key().ToString());
+    }
+    ASSERT_TRUE(expected == model.end());
+    delete iter;
+
+    Reopen(&options);
+    for (const auto& kv : model) {
+      ASSERT_EQ(kv.second, Get(kv.first));
+    }
+    Close();
+  }
+  for (MemTableRepFactory* factory : factories) {
+    delete factory;
+  }
+}
+
 TEST_F(DBTest, MinorCompactionsHappen) {
   Options options = CurrentOptions();
   options.write_buffer_size = 10000;
@@ -1104,6 +2016,25 @@ TEST_F(DBTest, MinorCompactionsHappen) {
   }
 }
 
+TEST_F(DBTest, RateLimitedBackgroundWrites) {
+  RateLimiter* limiter = NewGenericRateLimiter(64 << 20, true);
+  Options options = CurrentOptions();
+  options.write_buffer_size = 10000;
+  options.rate_limiter = limiter;
+  Reopen(&options);
+
+  const int N = 500;
+  for (int i = 0; i < N; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), Key(i) + std::string(1000, 'v')));
+  }
+  dbfull()->CompactRange(nullptr, nullptr);
+  for (int i = 0; i < N; i++) {
+    ASSERT_EQ(Key(i) + std::string(1000, 'v'), Get(Key(i)));
+  }
+  Close();
+  delete limiter;
+}
+
 TEST_F(DBTest, RecoverWithLargeLog) {
   {
     Options options = CurrentOptions();
@@ -1161,8 +2092,9 @@ TEST_F(DBTest, RepeatedWritesToSameKey) {
   Reopen(&options);
 
   // We must have at most one file per level except for level-0,
-  // which may have up to kL0_StopWritesTrigger files.
-  const int kMaxFiles = config::kNumLevels + config::kL0_StopWritesTrigger;
+  // which may have up to level0_stop_writes_trigger files.
+  const int kMaxFiles =
+      options.num_levels + options.level0_stop_writes_trigger;
 
   Random rnd(301);
   std::string value = RandomString(&rnd, 2 * options.write_buffer_size);
@@ -1325,6 +2257,63 @@ TEST_F(DBTest, ApproximateSizes_MixOfSmallAndLarge) {
   } while (ChangeOptions());
 }
 
+TEST_F(DBTest, GetPropertiesOfAllTables) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.compression = kNoCompression;
+  DestroyAndReopen(&options);
+
+  TablePropertiesCollection props;
+  ASSERT_LEVELDB_OK(db_->GetPropertiesOfAllTables(&props));
+  ASSERT_TRUE(props.empty());
+
+  // Sequence numbers 1..100 for the values, 101..110 for the deletions.
+  for (int i = 0; i < 100; i++) {
+    ASSERT_LEVELDB_OK(Put(Key(i), std::string(100, 'v')));
+  }
+  for (int i = 0; i < 10; i++) {
+    ASSERT_LEVELDB_OK(Delete(Key(100 + i)));
+  }
+  ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
+  ASSERT_LEVELDB_OK(db_->GetPropertiesOfAllTables(&props));
+  ASSERT_EQ(1, props.size());
+  const TableProperties& p = props.begin()->second;
+  ASSERT_EQ(110, p.num_entries);
+  ASSERT_EQ(10, p.num_deletions);
+  ASSERT_EQ(0, p.num_range_deletions);
+  ASSERT_EQ(110 * (Key(0).size() + 8), p.raw_key_size);
+  ASSERT_EQ(100 * 100, p.raw_value_size);
+  ASSERT_EQ(1, p.smallest_seqno);
+  ASSERT_EQ(110, p.largest_seqno);
+  ASSERT_LE(3, p.num_data_blocks);
+  ASSERT_LE(p.raw_value_size, p.data_size);
+  ASSERT_LT(0, p.index_size);
+  ASSERT_EQ("NoCompression", p.compression_name);
+  ASSERT_EQ(options.filter_policy == nullptr ? ""
+                                             : options.filter_policy->Name(),
+            p.filter_policy_name);
+
+  // The properties are read back from the files.
+  Reopen(&options);
+  TablePropertiesCollection reopened;
+  ASSERT_LEVELDB_OK(db_->GetPropertiesOfAllTables(&reopened));
+  ASSERT_EQ(1, reopened.size());
+  ASSERT_EQ(p.ToString(), reopened.begin()->second.ToString());
+
+  // A compaction drops the deletions, which delete no older value.
+  dbfull()->TEST_CompactRange(2, nullptr, nullptr);
+  ASSERT_LEVELDB_OK(db_->GetPropertiesOfAllTables(&props));
+  ASSERT_EQ(1, props.size());
+  ASSERT_EQ(100, props.begin()->second.num_entries);
+  ASSERT_EQ(0, props.begin()->second.num_deletions);
+
+  // A table file that cannot be opened is an error, not a file without
+  // properties.
+  Reopen(&options);
+  ASSERT_TRUE(DeleteAnSSTFile());
+  ASSERT_TRUE(!db_->GetPropertiesOfAllTables(&props).ok());
+}
+
 TEST_F(DBTest, IteratorPinsRef) {
   Put("foo", "hello");
 
@@ -1411,7 +2400,7 @@ TEST_F(DBTest, HiddenValuesAreRemoved) {
 TEST_F(DBTest, DeletionMarkers1) {
   Put("foo", "v1");
   ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
-  const int last = config::kMaxMemCompactLevel;
+  const int last = last_options_.max_mem_compaction_level;
   ASSERT_EQ(NumTableFilesAtLevel(last), 1);  // foo => v1 is now in last level
 
   // Place a table at level last-1 to prevent merging with preceding mutation
@@ -1440,7 +2429,7 @@ TEST_F(DBTest, DeletionMarkers1) {
 TEST_F(DBTest, DeletionMarkers2) {
   Put("foo", "v1");
   ASSERT_LEVELDB_OK(dbfull()->TEST_CompactMemTable());
-  const int last = config::kMaxMemCompactLevel;
+  const int last = last_options_.max_mem_compaction_level;
   ASSERT_EQ(NumTableFilesAtLevel(last), 1);  // foo => v1 is now in last level
 
   // Place a table at level last-1 to prevent merging with preceding mutation
@@ -1465,7 +2454,8 @@ TEST_F(DBTest, DeletionMarkers2) {
 
 TEST_F(DBTest, OverlapInLevel0) {
   do {
-    ASSERT_EQ(config::kMaxMemCompactLevel, 2) << "Fix test to match config";
+    ASSERT_EQ(last_options_.max_mem_compaction_level, 2)
+        << "Fix test to match config";
 
     // Fill levels 1 and 2 to disable the pushing of new memtables to levels >
     // 0.
@@ -1637,8 +2627,8 @@ TEST_F(DBTest, CustomComparator) {
 }
 
 TEST_F(DBTest, ManualCompaction) {
-  ASSERT_EQ(config::kMaxMemCompactLevel, 2)
-      << "Need to update this test to match kMaxMemCompactLevel";
+  ASSERT_EQ(last_options_.max_mem_compaction_level, 2)
+      << "Need to update this test to match max_mem_compaction_level";
 
   MakeTables(3, "p", "q");
   ASSERT_EQ("1,1,1", FilesPerLevel());
@@ -1786,7 +2776,7 @@ TEST_F(DBTest, NoSpace) {
   // Force out-of-space errors.
   env_->no_space_.store(true, std::memory_order_release);
   for (int i = 0; i < 10; i++) {
-    for (int level = 0; level < config::kNumLevels - 1; level++) {
+    for (int level = 0; level < last_options_.num_levels - 1; level++) {
       dbfull()->TEST_CompactRange(level, nullptr, nullptr);
     }
   }
@@ -1871,7 +2861,7 @@ TEST_F(DBTest, ManifestWriteError) {
     // Memtable compaction (will succeed)
     dbfull()->TEST_CompactMemTable();
     ASSERT_EQ("bar", Get("foo"));
-    const int last = config::kMaxMemCompactLevel;
+    const int last = last_options_.max_mem_compaction_level;
     ASSERT_EQ(NumTableFilesAtLevel(last), 1);  // foo=>bar is now in last level
 
     // Merging compaction (will fail)
@@ -1977,6 +2967,53 @@ TEST_F(DBTest, BloomFilter) {
   delete options.filter_policy;
 }
 
+TEST_F(DBTest, CompactionReadahead) {
+  env_->count_random_reads_ = true;
+  Options options = CurrentOptions();
+  options.env = env_;
+  options.create_if_missing = true;
+  options.block_cache = NewLRUCache(0);  // Prevent cache hits
+
+  // Compact a single table file holding a few hundred blocks, first block
+  // by block, then with readahead.
+  const int N = 10000;
+  int reads[2];
+  for (int i = 0; i < 2; i++) {
+    options.compaction_readahead_size = (i == 0) ? 0 : 1 << 20;
+    DestroyAndReopen(&options);
+    for (int k = 0; k < N; k++) {
+      ASSERT_LEVELDB_OK(Put(Key(k), std::string(100, 'v')));
+    }
+    dbfull()->TEST_CompactMemTable();
+    ASSERT_EQ("0,0,1", FilesPerLevel());
+    env_->random_read_counter_.Reset();
+    dbfull()->TEST_CompactRange(2, nullptr, nullptr);
+    ASSERT_EQ("0,0,0,1", FilesPerLevel());
+    reads[i] = env_->random_read_counter_.Read();
+  }
+  std::fprintf(stderr, "compaction reads: %d => %d\n", reads[0], reads[1]);
+  ASSERT_GE(reads[0], 200);
+  ASSERT_LE(reads[1], 20);
+
+  // Iterators read ahead when asked to.
+  ReadOptions read_options;
+  read_options.readahead_size = 1 << 20;
+  env_->random_read_counter_.Reset();
+  Iterator* iter = db_->NewIterator(read_options);
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    ASSERT_EQ(Key(count), iter->key().ToString());
+    count++;
+  }
+  ASSERT_LEVELDB_OK(iter->status());
+  delete iter;
+  ASSERT_EQ(N, count);
+  ASSERT_LE(env_->random_read_counter_.Read(), 20);
+
+  Close();
+  delete options.block_cache;
+}
+
 TEST_F(DBTest, LogCloseError) {
   // Regression test for bug where we could ignore log file
   // Close() error when switching to a new log file.
@@ -2153,6 +3190,10 @@ class ModelDB : public DB {
         (*map_)[key.ToString()] = value.ToString();
       }
       void Delete(const Slice& key) override { map_->erase(key.ToString()); }
+      void DeleteRange(const Slice& begin, const Slice& end) override {
+        map_->erase(map_->lower_bound(begin.ToString()),
+                    map_->lower_bound(end.ToString()));
+      }
     };
     Handler handler;
     handler.map_ = &map_;
@@ -0,0 +1,419 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#ifndef STORAGE_LEVELDB_DB_INLINESKIPLIST_H_
+#define STORAGE_LEVELDB_DB_INLINESKIPLIST_H_
+
+// InlineSkipList is a variant of SkipList (see skiplist.h for the thread
+// safety rules and invariants, which are the same) tuned for memtables:
+//
+// (1) Keys are variable-length byte strings that are stored inline in
+// their nodes, right after the level-0 link.  Comparing against a node
+// touches a single cache line instead of following a pointer elsewhere.
+//
+// (2) Each node caches a 64-bit prefix of its key supplied by the
+// comparator.  Nodes whose prefixes differ from the search key are
+// ordered without looking at the key at all.
+//
+// (3) While a search walks a level, the node after the one being compared
+// is prefetched.
+//
+// Node layout, with the links of levels above 0 stored in front of the
+// node so that the key can follow the level-0 link at a fixed offset:
+//
+//    next[height-1] ... next[1] | next[0] prefix | key bytes
+//                               ^ Node*
+//
+// The Comparator must provide
+//
+//    int operator()(const char* a, const char* b) const;
+//    uint64_t KeyPrefix(const char* key) const;
+//
+// where KeyPrefix(a) < KeyPrefix(b) implies a < b.  A comparator without
+// such a prefix returns the same value for every key.
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+
+#include "util/allocator.h"
+#include "util/random.h"
+
+namespace leveldb {
+
+template <class Comparator>
+class InlineSkipList {
+ private:
+  struct Node;
+
+ public:
+  // Create a new InlineSkipList object that will use "cmp" for comparing
+  // keys, and will allocate memory using "*allocator".
+  explicit InlineSkipList(Comparator cmp, Allocator* allocator);
+
+  InlineSkipList(const InlineSkipList&) = delete;
+  InlineSkipList& operator=(const InlineSkipList&) = delete;
+
+  // Allocate a node with room for a key of "key_size" bytes and return a
+  // pointer to the key.  The caller fills in the key and passes the
+  // pointer to Insert().
+  char* AllocateKey(size_t key_size);
+
+  // Insert a key returned by AllocateKey().
+  // REQUIRES: nothing that compares equal to key is currently in the list.
+  void Insert(const char* key);
+
+  // Returns true iff an entry that compares equal to key is in the list.
+  bool Contains(const char* key) const;
+
+  // Iteration over the contents of a skip list
+  class Iterator {
+   public:
+    // Initialize an iterator over the specified list.
+    // The returned iterator is not valid.
+    explicit Iterator(const InlineSkipList* list);
+
+    // Returns true iff the iterator is positioned at a valid node.
+    bool Valid() const;
+
+    // Returns the key at the current position.
+    // REQUIRES: Valid()
+    const char* key() const;
+
+    // Advances to the next position.
+    // REQUIRES: Valid()
+    void Next();
+
+    // Advances to the previous position.
+    // REQUIRES: Valid()
+    void Prev();
+
+    // Advance to the first entry with a key >= target
+    void Seek(const char* target);
+
+    // Position at the first entry in list.
+    // Final state of iterator is Valid() iff list is not empty.
+    void SeekToFirst();
+
+    // Position at the last entry in list.
+    // Final state of iterator is Valid() iff list is not empty.
+    void SeekToLast();
+
+   private:
+    const InlineSkipList* list_;
+    Node* node_;
+    // Intentionally copyable
+  };
+
+ private:
+  enum { kMaxHeight = 12 };
+
+  inline int GetMaxHeight() const {
+    return max_height_.load(std::memory_order_relaxed);
+  }
+
+  Node* AllocateNode(size_t key_size, int height);
+  int RandomHeight();
+
+  // Three-way comparison of "key" (whose prefix is "prefix") with the key
+  // of "n".  A null "n" is considered infinite.
+  int CompareKeyToNode(const char* key, uint64_t prefix, Node* n) const;
+
+  // Return the earliest node that comes at or after key.
+  // Return nullptr if there is no such node.
+  //
+  // If prev is non-null, fills prev[level] with pointer to previous
+  // node at "level" for every level in [0..max_height_-1].
+  Node* FindGreaterOrEqual(const char* key, Node** prev) const;
+
+  // Return the latest node with a key < key.
+  // Return head_ if there is no such node.
+  Node* FindLessThan(const char* key) const;
+
+  // Return the last node in the list.
+  // Return head_ if list is empty.
+  Node* FindLast() const;
+
+  // Immutable after construction
+  Comparator const compare_;
+  Allocator* const allocator_;  // Used for allocations of nodes
+
+  Node* const head_;
+
+  // Modified only by Insert().  Read racily by readers, but stale
+  // values are ok.
+  std::atomic<int> max_height_;  // Height of the entire list
+
+  // Read/written only by Insert().
+  Random rnd_;
+};
+
+// Prefetch the cache line holding "addr" for reading.
+inline void InlineSkipListPrefetch(const void* addr) {
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_prefetch(addr, 0 /* read */, 1 /* low temporal locality */);
+#else
+  (void)addr;
+#endif
+}
+
+// Implementation details follow
+template <class Comparator>
+struct InlineSkipList<Comparator>::Node {
+  // Between AllocateKey() and Insert() "prefix" holds the node height.
+  void StashHeight(int height) { prefix = static_cast<uint64_t>(height); }
+  int UnstashHeight() const { return static_cast<int>(prefix); }
+
+  const char* Key() const { return reinterpret_cast<const char*>(this + 1); }
+
+  // Accessors/mutators for links.  Wrapped in methods so we can
+  // add the appropriate barriers as necessary.
+  Node* Next(int n) {
+    assert(n >= 0);
+    // Use an 'acquire load' so that we observe a fully initialized
+    // version of the returned Node.
+    return (&next_[0] - n)->load(std::memory_order_acquire);
+  }
+  void SetNext(int n, Node* x) {
+    assert(n >= 0);
+    // Use a 'release store' so that anybody who reads through this
+    // pointer observes a fully initialized version of the inserted node.
+    (&next_[0] - n)->store(x, std::memory_order_release);
+  }
+
+  // No-barrier variants that can be safely used in a few locations.
+  Node* NoBarrier_Next(int n) {
+    assert(n >= 0);
+    return (&next_[0] - n)->load(std::memory_order_relaxed);
+  }
+  void NoBarrier_SetNext(int n, Node* x) {
+    assert(n >= 0);
+    (&next_[0] - n)->store(x, std::memory_order_relaxed);
+  }
+
+  // Level-0 link.  The link of level n is stored at &next_[0] - n, so
+  // this must be the first member.
+  std::atomic<Node*> next_[1];
+
+  // Prefix of the key, immutable once the node is linked.
+  uint64_t prefix;
+};
+
+template <class Comparator>
+typename InlineSkipList<Comparator>::Node*
+InlineSkipList<Comparator>::AllocateNode(size_t key_size, int height) {
+  const size_t tower_bytes = sizeof(std::atomic<Node*>) * (height - 1);
+  char* const raw =
+      allocator_->AllocateAligned(tower_bytes + sizeof(Node) + key_size);
+  Node* x = reinterpret_cast<Node*>(raw + tower_bytes);
+  x->StashHeight(height);
+  return x;
+}
+
+template <class Comparator>
+inline char* InlineSkipList<Comparator>::AllocateKey(size_t key_size) {
+  return const_cast<char*>(AllocateNode(key_size, RandomHeight())->Key());
+}
+
+template <class Comparator>
+inline InlineSkipList<Comparator>::Iterator::Iterator(
+    const InlineSkipList* list) {
+  list_ = list;
+  node_ = nullptr;
+}
+
+template <class Comparator>
+inline bool InlineSkipList<Comparator>::Iterator::Valid() const {
+  return node_ != nullptr;
+}
+
+template <class Comparator>
+inline const char* InlineSkipList<Comparator>::Iterator::key() const {
+  assert(Valid());
+  return node_->Key();
+}
+
+template <class Comparator>
+inline void InlineSkipList<Comparator>::Iterator::Next() {
+  assert(Valid());
+  node_ = node_->Next(0);
+}
+
+template <class Comparator>
+inline void InlineSkipList<Comparator>::Iterator::Prev() {
+  // Instead of using explicit "prev" links, we just search for the
+  // last node that falls before key.
+  assert(Valid());
+  node_ = list_->FindLessThan(node_->Key());
+  if (node_ == list_->head_) {
+    node_ = nullptr;
+  }
+}
+
+template <class Comparator>
+inline void InlineSkipList<Comparator>::Iterator::Seek(const char* target) {
+  node_ = list_->FindGreaterOrEqual(target, nullptr);
+}
+
+template <class Comparator>
+inline void InlineSkipList<Comparator>::Iterator::SeekToFirst() {
+  node_ = list_->head_->Next(0);
+}
+
+template <class Comparator>
+inline void InlineSkipList<Comparator>::Iterator::SeekToLast() {
+  node_ = list_->FindLast();
+  if (node_ == list_->head_) {
+    node_ = nullptr;
+  }
+}
+
+template <class Comparator>
+int InlineSkipList<Comparator>::RandomHeight() {
+  // Increase height with probability 1 in kBranching
+  static const unsigned int kBranching = 4;
+  int height = 1;
+  while (height < kMaxHeight && rnd_.OneIn(kBranching)) {
+    height++;
+  }
+  assert(height > 0);
+  assert(height <= kMaxHeight);
+  return height;
+}
+
+template <class Comparator>
+inline int InlineSkipList<Comparator>::CompareKeyToNode(const char* key,
+                                                        uint64_t prefix,
+                                                        Node* n) const {
+  if (n == nullptr) {
+    return -1;
+  } else if (prefix != n->prefix) {
+    return (prefix < n->prefix) ? -1 : +1;
+  } else {
+    return compare_(key, n->Key());
+  }
+}
+
+template <class Comparator>
+typename InlineSkipList<Comparator>::Node*
+InlineSkipList<Comparator>::FindGreaterOrEqual(const char* key,
+                                               Node** prev) const {
+  const uint64_t prefix = compare_.KeyPrefix(key);
+  Node* x = head_;
+  int level = GetMaxHeight() - 1;
+  while (true) {
+    Node* next = x->Next(level);
+    if (next != nullptr) {
+      InlineSkipListPrefetch(next->NoBarrier_Next(level));
+    }
+    if (CompareKeyToNode(key, prefix, next) > 0) {
+      // Keep searching in this list
+      x = next;
+    } else {
+      if (prev != nullptr) prev[level] = x;
+      if (level == 0) {
+        return next;
+      } else {
+        // Switch to next list
+        level--;
+      }
+    }
+  }
+}
+
+template <class Comparator>
+typename InlineSkipList<Comparator>::Node*
+InlineSkipList<Comparator>::FindLessThan(const char* key) const {
+  const uint64_t prefix = compare_.KeyPrefix(key);
+  Node* x = head_;
+  int level = GetMaxHeight() - 1;
+  while (true) {
+    assert(x == head_ || CompareKeyToNode(key, prefix, x) > 0);
+    Node* next = x->Next(level);
+    if (CompareKeyToNode(key, prefix, next) <= 0) {
+      if (level == 0) {
+        return x;
+      } else {
+        // Switch to next list
+        level--;
+      }
+    } else {
+      x = next;
+    }
+  }
+}
+
+template <class Comparator>
+typename InlineSkipList<Comparator>::Node*
+InlineSkipList<Comparator>::FindLast() const {
+  Node* x = head_;
+  int level = GetMaxHeight() - 1;
+  while (true) {
+    Node* next = x->Next(level);
+    if (next == nullptr) {
+      if (level == 0) {
+        return x;
+      } else {
+        // Switch to next list
+        level--;
+      }
+    } else {
+      x = next;
+    }
+  }
+}
+
+template <class Comparator>
+InlineSkipList<Comparator>::InlineSkipList(Comparator cmp,
+                                           Allocator* allocator)
+    : compare_(cmp),
+      allocator_(allocator),
+      head_(AllocateNode(0, kMaxHeight)),
+      max_height_(1),
+      rnd_(0xdeadbeef) {
+  for (int i = 0; i < kMaxHeight; i++) {
+    head_->SetNext(i, nullptr);
+  }
+}
+
+template <class Comparator>
+void InlineSkipList<Comparator>::Insert(const char* key) {
+  Node* x = const_cast<Node*>(reinterpret_cast<const Node*>(key) - 1);
+  const int height = x->UnstashHeight();
+  x->prefix = compare_.KeyPrefix(key);
+
+  Node* prev[kMaxHeight];
+  Node* next = FindGreaterOrEqual(key, prev);
+
+  // Our data structure does not allow duplicate insertion
+  assert(next == nullptr || compare_(key, next->Key()) != 0);
+  (void)next;
+
+  if (height > GetMaxHeight()) {
+    for (int i = GetMaxHeight(); i < height; i++) {
+      prev[i] = head_;
+    }
+    // It is ok to mutate max_height_ without any synchronization
+    // with concurrent readers (see SkipList::Insert()).
+    max_height_.store(height, std::memory_order_relaxed);
+  }
+
+  for (int i = 0; i < height; i++) {
+    // NoBarrier_SetNext() suffices since we will add a barrier when
+    // we publish a pointer to "x" in prev[i].
+    x->NoBarrier_SetNext(i, prev[i]->NoBarrier_Next(i));
+    prev[i]->SetNext(i, x);
+  }
+}
+
+template <class Comparator>
+bool InlineSkipList<Comparator>::Contains(const char* key) const {
+  Node* x = FindGreaterOrEqual(key, nullptr);
+  return x != nullptr && compare_(key, x->Key()) == 0;
+}
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_INLINESKIPLIST_H_
@@ -20,9 +20,16 @@ enum RecordType {
   // For fragments
   kFirstType = 2,
   kMiddleType = 3,
-  kLastType = 4
+  kLastType = 4,
+
+  // Compressed records.  The logical record starts with a single
+  // CompressionType byte followed by the compressed contents, and is
+  // fragmented like any other record: a kCompressedFirstType fragment is
+  // followed by kMiddleType/kLastType fragments.
+  kCompressedFullType = 5,
+  kCompressedFirstType = 6
 };
-static const int kMaxRecordType = kLastType;
+static const int kMaxRecordType = kCompressedFirstType;
 
 static const int kBlockSize = 32768;
 
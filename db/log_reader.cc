@@ -7,6 +7,8 @@
 #include <cstdio>
 
 #include "leveldb/env.h"
+#include "leveldb/options.h"
+#include "port/port.h"
 #include "util/coding.h"
 #include "util/crc32c.h"
 
@@ -63,6 +65,7 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch) {
   scratch->clear();
   record->clear();
   bool in_fragmented_record = false;
+  bool compressed_record = false;
   // Record offset of the logical record that we're reading
   // 0 is a dummy value to make compilers happy
   uint64_t prospective_record_offset = 0;
@@ -90,6 +93,7 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch) {
 
     switch (record_type) {
       case kFullType:
+      case kCompressedFullType:
         if (in_fragmented_record) {
           // Handle bug in earlier versions of log::Writer where
           // it could emit an empty kFirstType record at the tail end
@@ -101,11 +105,20 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch) {
         }
         prospective_record_offset = physical_record_offset;
         scratch->clear();
-        *record = fragment;
+        in_fragmented_record = false;
+        if (record_type == kCompressedFullType) {
+          if (!UncompressRecord(fragment, record)) {
+            ReportCorruption(fragment.size(), "bad compressed record");
+            break;
+          }
+        } else {
+          *record = fragment;
+        }
         last_record_offset_ = prospective_record_offset;
         return true;
 
       case kFirstType:
+      case kCompressedFirstType:
         if (in_fragmented_record) {
           // Handle bug in earlier versions of log::Writer where
           // it could emit an empty kFirstType record at the tail end
@@ -118,6 +131,7 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch) {
         prospective_record_offset = physical_record_offset;
         scratch->assign(fragment.data(), fragment.size());
         in_fragmented_record = true;
+        compressed_record = (record_type == kCompressedFirstType);
         break;
 
       case kMiddleType:
@@ -135,7 +149,16 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch) {
                            "missing start of fragmented record(2)");
         } else {
           scratch->append(fragment.data(), fragment.size());
-          *record = Slice(*scratch);
+          if (compressed_record) {
+            if (!UncompressRecord(Slice(*scratch), record)) {
+              ReportCorruption(scratch->size(), "bad compressed record");
+              in_fragmented_record = false;
+              scratch->clear();
+              break;
+            }
+          } else {
+            *record = Slice(*scratch);
+          }
           last_record_offset_ = prospective_record_offset;
           return true;
         }
@@ -175,6 +198,39 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch) {
 
 uint64_t Reader::LastRecordOffset() { return last_record_offset_; }
 
+bool Reader::UncompressRecord(const Slice& input, Slice* record) {
+  if (input.empty()) {
+    return false;
+  }
+  const char* data = input.data() + 1;
+  const size_t n = input.size() - 1;
+  size_t ulength = 0;
+  switch (static_cast<unsigned char>(input[0])) {
+    case kSnappyCompression:
+      if (!port::Snappy_GetUncompressedLength(data, n, &ulength)) {
+        return false;
+      }
+      uncompressed_.resize(ulength);
+      if (!port::Snappy_Uncompress(data, n, &uncompressed_[0])) {
+        return false;
+      }
+      break;
+    case kZstdCompression:
+      if (!port::Zstd_GetUncompressedLength(data, n, &ulength)) {
+        return false;
+      }
+      uncompressed_.resize(ulength);
+      if (!port::Zstd_Uncompress(data, n, &uncompressed_[0])) {
+        return false;
+      }
+      break;
+    default:
+      return false;
+  }
+  *record = Slice(uncompressed_);
+  return true;
+}
+
 void Reader::ReportCorruption(uint64_t bytes, const char* reason) {
   ReportDrop(bytes, Status::Corruption(reason));
 }
@@ -6,6 +6,7 @@
 #define STORAGE_LEVELDB_DB_LOG_READER_H_
 
 #include <cstdint>
+#include <string>
 
 #include "db/log_format.h"
 #include "leveldb/slice.h"
@@ -80,6 +81,11 @@ class Reader {
   // Return type, or one of the preceding special values
   unsigned int ReadPhysicalRecord(Slice* result);
 
+  // Uncompress the logical record "input" (as written by
+  // Writer::CompressRecord) into uncompressed_ and point *record at it.
+  // Returns false if the record could not be uncompressed.
+  bool UncompressRecord(const Slice& input, Slice* record);
+
   // Reports dropped bytes to the reporter.
   // buffer_ must be updated to remove the dropped bytes prior to invocation.
   void ReportCorruption(uint64_t bytes, const char* reason);
@@ -104,6 +110,9 @@ class Reader {
   // particular, a run of kMiddleType and kLastType records can be silently
   // skipped in this mode
   bool resyncing_;
+
+  // Backing storage for the last record returned if it was compressed
+  std::string uncompressed_;
 };
 
 }  // namespace log
@@ -7,6 +7,7 @@
 #include <cstdint>
 
 #include "leveldb/env.h"
+#include "port/port.h"
 #include "util/coding.h"
 #include "util/crc32c.h"
 
@@ -20,18 +21,58 @@ static void InitTypeCrc(uint32_t* type_crc) {
   }
 }
 
-Writer::Writer(WritableFile* dest) : dest_(dest), block_offset_(0) {
+Writer::Writer(WritableFile* dest)
+    : dest_(dest),
+      block_offset_(0),
+      compression_(kNoCompression),
+      compression_level_(0) {
   InitTypeCrc(type_crc_);
 }
 
 Writer::Writer(WritableFile* dest, uint64_t dest_length)
-    : dest_(dest), block_offset_(dest_length % kBlockSize) {
+    : dest_(dest),
+      block_offset_(dest_length % kBlockSize),
+      compression_(kNoCompression),
+      compression_level_(0) {
+  InitTypeCrc(type_crc_);
+}
+
+Writer::Writer(WritableFile* dest, uint64_t dest_length,
+               CompressionType compression, int compression_level)
+    : dest_(dest),
+      block_offset_(dest_length % kBlockSize),
+      compression_(compression),
+      compression_level_(compression_level) {
   InitTypeCrc(type_crc_);
 }
 
 Writer::~Writer() = default;
 
-Status Writer::AddRecord(const Slice& slice) {
+bool Writer::CompressRecord(const Slice& slice) {
+  bool ok = false;
+  switch (compression_) {
+    case kNoCompression:
+      return false;
+    case kSnappyCompression:
+      ok = port::Snappy_Compress(slice.data(), slice.size(), &compressed_);
+      break;
+    case kZstdCompression:
+      ok = port::Zstd_Compress(compression_level_, slice.data(), slice.size(),
+                               &compressed_);
+      break;
+  }
+  // Keep the record uncompressed if the compression library is not
+  // available or if it saved less than 12.5% of the record.
+  if (!ok || compressed_.size() + 1 >= slice.size() - (slice.size() / 8u)) {
+    return false;
+  }
+  compressed_.insert(0, 1, static_cast<char>(compression_));
+  return true;
+}
+
+Status Writer::AddRecord(const Slice& record) {
+  const bool compressed = CompressRecord(record);
+  const Slice slice = compressed ? Slice(compressed_) : record;
   const char* ptr = slice.data();
   size_t left = slice.size();
 
@@ -62,9 +103,9 @@ Status Writer::AddRecord(const Slice& slice) {
     RecordType type;
     const bool end = (left == fragment_length);
     if (begin && end) {
-      type = kFullType;
+      type = compressed ? kCompressedFullType : kFullType;
     } else if (begin) {
-      type = kFirstType;
+      type = compressed ? kCompressedFirstType : kFirstType;
     } else if (end) {
       type = kLastType;
     } else {
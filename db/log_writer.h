@@ -6,8 +6,10 @@
 #define STORAGE_LEVELDB_DB_LOG_WRITER_H_
 
 #include <cstdint>
+#include <string>
 
 #include "db/log_format.h"
+#include "leveldb/options.h"
 #include "leveldb/slice.h"
 #include "leveldb/status.h"
 
@@ -30,6 +32,14 @@ class Writer
     // "*dest" must remain live while this Writer is in use.
     Writer(WritableFile *dest, uint64_t dest_length);
 
+    // Create a writer that will append data to "*dest", which must have
+    // initial length "dest_length".  Each record is compressed with
+    // "compression" (using "compression_level" for zstd) when that makes
+    // it noticeably smaller; other records are written uncompressed.
+    // "*dest" must remain live while this Writer is in use.
+    Writer(WritableFile *dest, uint64_t dest_length,
+           CompressionType compression, int compression_level);
+
     Writer(const Writer &) = delete;
     Writer &operator=(const Writer &) = delete;
 
@@ -40,9 +50,17 @@ class Writer
   private:
     Status EmitPhysicalRecord(RecordType type, const char *ptr, size_t length);
 
+    // Compress "slice" into compressed_ (prefixed with the compression
+    // type).  Returns false if the record should be written as is.
+    bool CompressRecord(const Slice &slice);
+
     WritableFile *dest_;
     int block_offset_; // Current offset in block
 
+    const CompressionType compression_;
+    const int compression_level_;
+    std::string compressed_; // Scratch space for compressed records
+
     // crc32c values for all supported record types.  These are
     // pre-computed to reduce the overhead of computing the crc of the
     // record type stored in the header.
@@ -8,6 +8,9 @@
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
 #include "util/coding.h"
+#include "util/dynamic_bloom.h"
+#include "util/hash.h"
+#include "util/mutexlock.h"
 
 namespace leveldb {
 
@@ -18,12 +21,75 @@ static Slice GetLengthPrefixedSlice(const char* data) {
   return Slice(p, len);
 }
 
+static MemTableRepFactory* DefaultMemTableRepFactory() {
+  static MemTableRepFactory* const factory = NewSkipListRepFactory();
+  return factory;
+}
+
+// Number of locks striping the keys of a memtable with in-place updates.
+static const int kNumInplaceLocks = 256;
+
+static DynamicBloom* NewMemTableBloom(const Options& options,
+                                      Allocator* allocator) {
+  const double bits =
+      8.0 * options.write_buffer_size * options.memtable_bloom_size_ratio;
+  if (bits < 1) {
+    return nullptr;
+  }
+  return new DynamicBloom(allocator, static_cast<uint32_t>(bits));
+}
+
 MemTable::MemTable(const InternalKeyComparator& comparator)
-    : comparator_(comparator), refs_(0), table_(comparator_, &arena_) {}
+    : comparator_(comparator),
+      refs_(0),
+      table_(DefaultMemTableRepFactory()->CreateMemTableRep(comparator_,
+                                                            &arena_)),
+      range_del_table_(
+          DefaultMemTableRepFactory()->CreateMemTableRep(comparator_,
+                                                         &arena_)),
+      has_range_deletions_(false),
+      num_entries_(0),
+      num_deletes_(0),
+      bloom_(nullptr),
+      inplace_locks_(nullptr) {}
 
-MemTable::~MemTable() { assert(refs_ == 0); }
+MemTable::MemTable(const InternalKeyComparator& comparator,
+                   const Options& options)
+    : comparator_(comparator),
+      refs_(0),
+      arena_(options.memtable_huge_page_size, options.memtable_numa_aware),
+      table_((options.memtable_factory != nullptr
+                  ? options.memtable_factory
+                  : DefaultMemTableRepFactory())
+                 ->CreateMemTableRep(comparator_, &arena_)),
+      range_del_table_(
+          DefaultMemTableRepFactory()->CreateMemTableRep(comparator_,
+                                                         &arena_)),
+      has_range_deletions_(false),
+      num_entries_(0),
+      num_deletes_(0),
+      bloom_(NewMemTableBloom(options, &arena_)),
+      inplace_locks_(options.inplace_update_support
+                         ? new port::Mutex[kNumInplaceLocks]
+                         : nullptr) {}
 
-size_t MemTable::ApproximateMemoryUsage() { return arena_.MemoryUsage(); }
+MemTable::~MemTable() {
+  assert(refs_ == 0);
+  delete table_;
+  delete range_del_table_;
+  delete bloom_;
+  delete[] inplace_locks_;
+}
+
+size_t MemTable::ApproximateMemoryUsage() {
+  return arena_.MemoryUsage() + table_->ApproximateMemoryUsage() +
+         range_del_table_->ApproximateMemoryUsage();
+}
+
+void MemTable::MarkImmutable() {
+  table_->MarkReadOnly();
+  range_del_table_->MarkReadOnly();
+}
 
 int MemTable::KeyComparator::operator()(const char* aptr,
                                         const char* bptr) const {
@@ -33,6 +99,15 @@ int MemTable::KeyComparator::operator()(const char* aptr,
   return comparator.Compare(a, b);
 }
 
+int MemTable::KeyComparator::operator()(const char* entry,
+                                        const Slice& key) const {
+  return comparator.Compare(GetLengthPrefixedSlice(entry), key);
+}
+
+bool MemTable::KeyComparator::UserKeysAreBytewise() const {
+  return comparator.user_comparator() == BytewiseComparator();
+}
+
 // Encode a suitable internal key target for "target" and return it.
 // Uses *scratch as scratch space, and the returned pointer will point
 // into this scratch space.
@@ -45,33 +120,42 @@ static const char* EncodeKey(std::string* scratch, const Slice& target) {
 
 class MemTableIterator : public Iterator {
  public:
-  explicit MemTableIterator(MemTable::Table* table) : iter_(table) {}
+  explicit MemTableIterator(MemTableRep::Iterator* iter) : iter_(iter) {}
 
   MemTableIterator(const MemTableIterator&) = delete;
   MemTableIterator& operator=(const MemTableIterator&) = delete;
 
-  ~MemTableIterator() override = default;
+  ~MemTableIterator() override { delete iter_; }
 
-  bool Valid() const override { return iter_.Valid(); }
-  void Seek(const Slice& k) override { iter_.Seek(EncodeKey(&tmp_, k)); }
-  void SeekToFirst() override { iter_.SeekToFirst(); }
-  void SeekToLast() override { iter_.SeekToLast(); }
-  void Next() override { iter_.Next(); }
-  void Prev() override { iter_.Prev(); }
-  Slice key() const override { return GetLengthPrefixedSlice(iter_.key()); }
+  bool Valid() const override { return iter_->Valid(); }
+  void Seek(const Slice& k) override { iter_->Seek(EncodeKey(&tmp_, k)); }
+  void SeekToFirst() override { iter_->SeekToFirst(); }
+  void SeekToLast() override { iter_->SeekToLast(); }
+  void Next() override { iter_->Next(); }
+  void Prev() override { iter_->Prev(); }
+  Slice key() const override { return GetLengthPrefixedSlice(iter_->key()); }
   Slice value() const override {
-    Slice key_slice = GetLengthPrefixedSlice(iter_.key());
+    Slice key_slice = GetLengthPrefixedSlice(iter_->key());
     return GetLengthPrefixedSlice(key_slice.data() + key_slice.size());
   }
 
   Status status() const override { return Status::OK(); }
 
  private:
-  MemTable::Table::Iterator iter_;
+  MemTableRep::Iterator* const iter_;
   std::string tmp_;  // For passing to EncodeKey
 };
 
-Iterator* MemTable::NewIterator() { return new MemTableIterator(&table_); }
+Iterator* MemTable::NewIterator() {
+  return new MemTableIterator(table_->GetIterator());
+}
+
+Iterator* MemTable::NewRangeTombstoneIterator() {
+  if (!has_range_deletions_.load(std::memory_order_acquire)) {
+    return nullptr;
+  }
+  return new MemTableIterator(range_del_table_->GetIterator());
+}
 
 void MemTable::Add(SequenceNumber s, ValueType type, const Slice& key,
                    const Slice& value) {
@@ -87,7 +171,9 @@ void MemTable::Add(SequenceNumber s, ValueType type, const Slice& key,
   const size_t encoded_len = VarintLength(internal_key_size) +
                              internal_key_size + VarintLength(val_size) +
                              val_size;
-  char* buf = arena_.Allocate(encoded_len);
+  MemTableRep* const table =
+      (type == kTypeRangeDeletion) ? range_del_table_ : table_;
+  char* buf = table->Allocate(encoded_len);
   char* p = EncodeVarint32(buf, internal_key_size);
   std::memcpy(p, key.data(), key_size);
   p += key_size;
@@ -96,14 +182,76 @@ void MemTable::Add(SequenceNumber s, ValueType type, const Slice& key,
   p = EncodeVarint32(p, val_size);
   std::memcpy(p, value.data(), val_size);
   assert(p + val_size == buf + encoded_len);
-  table_.Insert(buf);
+  // Add() has a single writer, so the counters need no read-modify-write.
+  num_entries_.store(num_entries_.load(std::memory_order_relaxed) + 1,
+                     std::memory_order_relaxed);
+  if (type == kTypeDeletion) {
+    num_deletes_.store(num_deletes_.load(std::memory_order_relaxed) + 1,
+                       std::memory_order_relaxed);
+  }
+  if (type == kTypeRangeDeletion) {
+    range_del_table_->Insert(buf);
+    has_range_deletions_.store(true, std::memory_order_release);
+    return;
+  }
+  if (bloom_ != nullptr) {
+    bloom_->Add(key);
+  }
+  table_->Insert(buf);
+}
+
+// Raise *max_seq to the sequence number of the newest tombstone in
+// "range_del_table" that covers user_key and is not above "read_seq".
+static void UpdateCoveringTombstone(MemTableRep* range_del_table,
+                                    const Comparator* ucmp,
+                                    const Slice& user_key,
+                                    SequenceNumber read_seq,
+                                    SequenceNumber* max_seq) {
+  // Tombstones are sorted by their begin key, so only a prefix of them
+  // can cover user_key.
+  MemTableRep::Iterator* iter = range_del_table->GetIterator();
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    const char* entry = iter->key();
+    uint32_t key_length;
+    const char* key_ptr = GetVarint32Ptr(entry, entry + 5, &key_length);
+    if (ucmp->Compare(Slice(key_ptr, key_length - 8), user_key) > 0) {
+      break;
+    }
+    const SequenceNumber seq = DecodeFixed64(key_ptr + key_length - 8) >> 8;
+    if (seq > *max_seq && seq <= read_seq &&
+        ucmp->Compare(GetLengthPrefixedSlice(key_ptr + key_length),
+                      user_key) > 0) {
+      *max_seq = seq;
+    }
+  }
+  delete iter;
 }
 
-bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) {
+bool MemTable::Get(const LookupKey& key, std::string* value, Status* s,
+                   SequenceNumber* max_covering_tombstone_seq,
+                   std::vector<std::string>* merge_operands) {
+  SequenceNumber covering = 0;
+  if (max_covering_tombstone_seq != nullptr) {
+    if (has_range_deletions_.load(std::memory_order_acquire)) {
+      Slice internal_key = key.internal_key();
+      const SequenceNumber read_seq =
+          DecodeFixed64(internal_key.data() + internal_key.size() - 8) >> 8;
+      UpdateCoveringTombstone(range_del_table_,
+                              comparator_.comparator.user_comparator(),
+                              key.user_key(), read_seq,
+                              max_covering_tombstone_seq);
+    }
+    covering = *max_covering_tombstone_seq;
+  }
+  if (bloom_ != nullptr && !bloom_->MayContain(key.user_key())) {
+    return false;
+  }
   Slice memkey = key.memtable_key();
-  Table::Iterator iter(&table_);
-  iter.Seek(memkey.data());
-  if (iter.Valid()) {
+  MemTableRep::Iterator* iter = table_->GetLookupIterator();
+  bool found = false;
+  // Entries of the key follow each other from newest to oldest; all but
+  // the last one found are merge operands.
+  for (iter->Seek(memkey.data()); iter->Valid(); iter->Next()) {
     // entry format is:
     //    klength  varint32
     //    userkey  char[klength]
@@ -113,26 +261,95 @@ bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) {
     // Check that it belongs to same user key.  We do not check the
     // sequence number since the Seek() call above should have skipped
     // all entries with overly large sequence numbers.
-    const char* entry = iter.key();
+    const char* entry = iter->key();
     uint32_t key_length;
     const char* key_ptr = GetVarint32Ptr(entry, entry + 5, &key_length);
     if (comparator_.comparator.user_comparator()->Compare(
-            Slice(key_ptr, key_length - 8), key.user_key()) == 0) {
-      // Correct user key
-      const uint64_t tag = DecodeFixed64(key_ptr + key_length - 8);
-      switch (static_cast<ValueType>(tag & 0xff)) {
-        case kTypeValue: {
+            Slice(key_ptr, key_length - 8), key.user_key()) != 0) {
+      break;
+    }
+    // Correct user key
+    const uint64_t tag = DecodeFixed64(key_ptr + key_length - 8);
+    ValueType type = static_cast<ValueType>(tag & 0xff);
+    if ((tag >> 8) < covering) {
+      type = kTypeDeletion;  // Deleted by a newer range tombstone
+    }
+    switch (type) {
+      case kTypeValue: {
+        if (inplace_locks_ != nullptr) {
+          // Update() may be overwriting the value.
+          MutexLock l(LockFor(key.user_key()));
+          Slice v = GetLengthPrefixedSlice(key_ptr + key_length);
+          value->assign(v.data(), v.size());
+        } else {
           Slice v = GetLengthPrefixedSlice(key_ptr + key_length);
           value->assign(v.data(), v.size());
-          return true;
         }
-        case kTypeDeletion:
-          *s = Status::NotFound(Slice());
-          return true;
+        found = true;
+        break;
+      }
+      case kTypeDeletion:
+        *s = Status::NotFound(Slice());
+        found = true;
+        break;
+      case kTypeMerge:
+        if (merge_operands == nullptr) {
+          *s = Status::NotSupported("merge operand", key.user_key());
+          found = true;
+        } else {
+          merge_operands->push_back(
+              GetLengthPrefixedSlice(key_ptr + key_length).ToString());
+        }
+        break;
+      case kTypeRangeDeletion:
+        assert(false);  // Never stored with the other entries
+        break;
+    }
+    if (found) {
+      break;
+    }
+  }
+  delete iter;
+  return found;
+}
+
+bool MemTable::Update(const Slice& key, const Slice& value) {
+  if (inplace_locks_ == nullptr ||
+      has_range_deletions_.load(std::memory_order_acquire)) {
+    return false;
+  }
+  LookupKey lkey(key, kMaxSequenceNumber);
+  MemTableRep::Iterator* iter = table_->GetLookupIterator();
+  iter->Seek(lkey.memtable_key().data());
+  bool updated = false;
+  if (iter->Valid()) {
+    const char* entry = iter->key();
+    uint32_t key_length;
+    const char* key_ptr = GetVarint32Ptr(entry, entry + 5, &key_length);
+    const uint64_t tag = DecodeFixed64(key_ptr + key_length - 8);
+    if (static_cast<ValueType>(tag & 0xff) == kTypeValue &&
+        comparator_.comparator.user_comparator()->Compare(
+            Slice(key_ptr, key_length - 8), key) == 0) {
+      char* value_ptr = const_cast<char*>(key_ptr + key_length);
+      uint32_t old_size;
+      GetVarint32Ptr(value_ptr, value_ptr + 5, &old_size);
+      if (value.size() <= old_size) {
+        // The new length prefix is no longer than the old one, so the
+        // value still ends within the entry.
+        MutexLock l(LockFor(key));
+        char* p = EncodeVarint32(value_ptr, value.size());
+        std::memcpy(p, value.data(), value.size());
+        updated = true;
       }
     }
   }
-  return false;
+  delete iter;
+  return updated;
+}
+
+port::Mutex* MemTable::LockFor(const Slice& user_key) {
+  return &inplace_locks_[Hash(user_key.data(), user_key.size(), 0) %
+                         kNumInplaceLocks];
 }
 
 }  // namespace leveldb
@@ -5,15 +5,19 @@
 #ifndef STORAGE_LEVELDB_DB_MEMTABLE_H_
 #define STORAGE_LEVELDB_DB_MEMTABLE_H_
 
+#include <atomic>
 #include <string>
+#include <vector>
 
 #include "db/dbformat.h"
-#include "db/skiplist.h"
 #include "leveldb/db.h"
-#include "util/arena.h"
+#include "leveldb/memtablerep.h"
+#include "port/port.h"
+#include "util/concurrent_arena.h"
 
 namespace leveldb {
 
+class DynamicBloom;
 class InternalKeyComparator;
 class MemTableIterator;
 
@@ -23,6 +27,10 @@ class MemTable {
   // is zero and the caller must call Ref() at least once.
   explicit MemTable(const InternalKeyComparator& comparator);
 
+  // Create a memtable whose entries are indexed by a MemTableRep obtained
+  // from options.memtable_factory (a skiplist if null).
+  MemTable(const InternalKeyComparator& comparator, const Options& options);
+
   MemTable(const MemTable&) = delete;
   MemTable& operator=(const MemTable&) = delete;
 
@@ -42,6 +50,17 @@ class MemTable {
   // data structure. It is safe to call when MemTable is being modified.
   size_t ApproximateMemoryUsage();
 
+  // Number of entries added, range tombstones included.  It is safe to
+  // call when MemTable is being modified.
+  uint64_t NumEntries() const {
+    return num_entries_.load(std::memory_order_relaxed);
+  }
+
+  // Number of deletion markers (kTypeDeletion) added.
+  uint64_t NumDeletes() const {
+    return num_deletes_.load(std::memory_order_relaxed);
+  }
+
   // Return an iterator that yields the contents of the memtable.
   //
   // The caller must ensure that the underlying MemTable remains live
@@ -50,9 +69,16 @@ class MemTable {
   // db/format.{h,cc} module.
   Iterator* NewIterator();
 
+  // Return an iterator over the range tombstones of the memtable, or
+  // nullptr if it has none.  Its entries are stored as in a table's
+  // range deletion block (see db/range_tombstone.h).
+  Iterator* NewRangeTombstoneIterator();
+
   // Add an entry into memtable that maps key to value at the
   // specified sequence number and with the specified type.
-  // Typically value will be empty if type==kTypeDeletion.
+  // Typically value will be empty if type==kTypeDeletion.  A range
+  // tombstone (kTypeRangeDeletion) deleting [key, value) is kept apart
+  // from the other entries.
   void Add(SequenceNumber seq, ValueType type, const Slice& key,
            const Slice& value);
 
@@ -60,26 +86,58 @@ class MemTable {
   // If memtable contains a deletion for key, store a NotFound() error
   // in *status and return true.
   // Else, return false.
-  bool Get(const LookupKey& key, std::string* value, Status* s);
+  //
+  // If max_covering_tombstone_seq is non-null, *max_covering_tombstone_seq
+  // is raised to the sequence number of the newest range tombstone visible
+  // to the lookup that covers key, and entries older than it are treated
+  // as deleted.  The caller passes it on to older sources.
+  //
+  // Merge operands (kTypeMerge) newer than the value or deletion found
+  // are appended to *merge_operands, newest first, for the caller to
+  // apply; if only merge operands are found, return false so that older
+  // sources are searched.  Without merge_operands, finding a merge
+  // operand stores a NotSupported() error in *status.
+  bool Get(const LookupKey& key, std::string* value, Status* s,
+           SequenceNumber* max_covering_tombstone_seq = nullptr,
+           std::vector<std::string>* merge_operands = nullptr);
+
+  // If the newest entry for key is a value of at least value.size() bytes,
+  // overwrite it with value, keeping its sequence number, and return true.
+  // Else, or if the memtable was not created with
+  // options.inplace_update_support or holds range tombstones, return
+  // false and change nothing.
+  // REQUIRES: no snapshot may read the overwritten value.
+  bool Update(const Slice& key, const Slice& value);
+
+  // Called once no more entries will be added.
+  void MarkImmutable();
 
  private:
   friend class MemTableIterator;
-  friend class MemTableBackwardIterator;
 
-  struct KeyComparator {
+  struct KeyComparator : public MemTableRep::KeyComparator {
     const InternalKeyComparator comparator;
     explicit KeyComparator(const InternalKeyComparator& c) : comparator(c) {}
-    int operator()(const char* a, const char* b) const;
+    int operator()(const char* a, const char* b) const override;
+    int operator()(const char* entry, const Slice& key) const override;
+    bool UserKeysAreBytewise() const override;
   };
 
-  typedef SkipList<const char*, KeyComparator> Table;
-
   ~MemTable();  // Private since only Unref() should be used to delete it
 
+  // Guards the values of the keys hashing to it against in-place updates.
+  port::Mutex* LockFor(const Slice& user_key);
+
   KeyComparator comparator_;
   int refs_;
-  Arena arena_;
-  Table table_;
+  ConcurrentArena arena_;
+  MemTableRep* const table_;
+  MemTableRep* const range_del_table_;
+  std::atomic<bool> has_range_deletions_;
+  std::atomic<uint64_t> num_entries_;
+  std::atomic<uint64_t> num_deletes_;
+  DynamicBloom* const bloom_;  // User keys added; null if disabled
+  port::Mutex* const inplace_locks_;  // Null unless inplace_update_support
 };
 
 }  // namespace leveldb
@@ -0,0 +1,462 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/memtablerep.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "db/inlineskiplist.h"
+#include "db/skiplist.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
+#include "util/arena.h"
+#include "util/coding.h"
+#include "util/hash.h"
+#include "util/mutexlock.h"
+
+namespace leveldb {
+
+MemTableRep::~MemTableRep() = default;
+
+char* MemTableRep::Allocate(size_t len) {
+  return static_cast<Allocator*>(allocator_)->Allocate(len);
+}
+
+MemTableRepFactory::~MemTableRepFactory() = default;
+
+namespace {
+
+typedef MemTableRep::KeyComparator KeyComparator;
+typedef SkipList<const char*, const KeyComparator&> EntryList;
+
+// Compares two entries of a memtable whose user keys are ordered
+// bytewise.  Equivalent to KeyComparator, but inlined into the skiplist
+// without its two virtual calls per comparison.
+inline int CompareBytewiseEntries(const char* a, const char* b) {
+  uint32_t a_length, b_length;
+  const char* a_key = GetVarint32Ptr(a, a + 5, &a_length);
+  const char* b_key = GetVarint32Ptr(b, b + 5, &b_length);
+  assert(a_length >= 8 && b_length >= 8);
+  int r = Slice(a_key, a_length - 8).compare(Slice(b_key, b_length - 8));
+  if (r == 0) {
+    // Larger tags (newer sequence numbers) come first.
+    const uint64_t a_tag = DecodeFixed64(a_key + a_length - 8);
+    const uint64_t b_tag = DecodeFixed64(b_key + b_length - 8);
+    if (a_tag > b_tag) {
+      r = -1;
+    } else if (a_tag < b_tag) {
+      r = +1;
+    }
+  }
+  return r;
+}
+
+struct BytewiseEntryComparator {
+  int operator()(const char* a, const char* b) const {
+    return CompareBytewiseEntries(a, b);
+  }
+};
+
+// Adapts a skiplist iterator.  Optionally owns the list and the arena it
+// was allocated from.
+template <typename List>
+class SkipListIterator : public MemTableRep::Iterator {
+ public:
+  explicit SkipListIterator(const List* list, Arena* arena = nullptr)
+      : list_(list), arena_(arena), iter_(list) {}
+
+  ~SkipListIterator() override {
+    if (arena_ != nullptr) {
+      delete list_;
+      delete arena_;
+    }
+  }
+
+  bool Valid() const override { return iter_.Valid(); }
+  const char* key() const override { return iter_.key(); }
+  void Next() override { iter_.Next(); }
+  void Prev() override { iter_.Prev(); }
+  void Seek(const char* target) override { iter_.Seek(target); }
+  void SeekToFirst() override { iter_.SeekToFirst(); }
+  void SeekToLast() override { iter_.SeekToLast(); }
+
+ private:
+  const List* const list_;
+  Arena* const arena_;
+  typename List::Iterator iter_;
+};
+
+// "Compare" is either BytewiseEntryComparator or const KeyComparator&.
+template <typename Compare>
+class SkipListRep : public MemTableRep {
+ public:
+  SkipListRep(Compare cmp, Allocator* allocator)
+      : MemTableRep(allocator), list_(cmp, allocator) {}
+
+  void Insert(const char* entry) override { list_.Insert(entry); }
+
+  size_t ApproximateMemoryUsage() override { return 0; }
+
+  Iterator* GetIterator() override {
+    return new SkipListIterator<List>(&list_);
+  }
+
+ private:
+  typedef SkipList<const char*, Compare> List;
+
+  List list_;
+};
+
+// Returns the user key of a memtable entry.
+Slice EntryUserKey(const char* entry) {
+  uint32_t len;
+  const char* p = GetVarint32Ptr(entry, entry + 5, &len);
+  assert(len >= 8);
+  return Slice(p, len - 8);
+}
+
+// Orders entries for InlineSkipList.  With bytewise user keys the first
+// eight bytes of the user key, zero-padded, are an order-preserving prefix.
+struct InlineKeyComparator {
+  const KeyComparator& compare;
+  const bool bytewise;
+
+  int operator()(const char* a, const char* b) const {
+    return bytewise ? CompareBytewiseEntries(a, b) : compare(a, b);
+  }
+
+  uint64_t KeyPrefix(const char* entry) const {
+    if (!bytewise) {
+      return 0;
+    }
+    const Slice user_key = EntryUserKey(entry);
+    const size_t n = std::min<size_t>(user_key.size(), 8);
+    uint64_t prefix = 0;
+    for (size_t i = 0; i < 8; i++) {
+      prefix <<= 8;
+      if (i < n) prefix |= static_cast<uint8_t>(user_key[i]);
+    }
+    return prefix;
+  }
+};
+
+typedef InlineSkipList<InlineKeyComparator> InlineEntryList;
+
+class InlineSkipListIterator : public MemTableRep::Iterator {
+ public:
+  explicit InlineSkipListIterator(const InlineEntryList* list)
+      : iter_(list) {}
+
+  bool Valid() const override { return iter_.Valid(); }
+  const char* key() const override { return iter_.key(); }
+  void Next() override { iter_.Next(); }
+  void Prev() override { iter_.Prev(); }
+  void Seek(const char* target) override { iter_.Seek(target); }
+  void SeekToFirst() override { iter_.SeekToFirst(); }
+  void SeekToLast() override { iter_.SeekToLast(); }
+
+ private:
+  InlineEntryList::Iterator iter_;
+};
+
+class InlineSkipListRep : public MemTableRep {
+ public:
+  InlineSkipListRep(const KeyComparator& cmp, Allocator* allocator)
+      : MemTableRep(allocator),
+        list_(InlineKeyComparator{cmp, cmp.UserKeysAreBytewise()},
+              allocator) {}
+
+  char* Allocate(size_t len) override { return list_.AllocateKey(len); }
+
+  void Insert(const char* entry) override { list_.Insert(entry); }
+
+  size_t ApproximateMemoryUsage() override { return 0; }
+
+  Iterator* GetIterator() override {
+    return new InlineSkipListIterator(&list_);
+  }
+
+ private:
+  InlineEntryList list_;
+};
+
+class SkipListRepFactory : public MemTableRepFactory {
+ public:
+  const char* Name() const override { return "leveldb.SkipListRep"; }
+
+  MemTableRep* CreateMemTableRep(const KeyComparator& cmp,
+                                 MemTableAllocator* arena) override {
+    Allocator* const allocator = static_cast<Allocator*>(arena);
+    if (cmp.UserKeysAreBytewise()) {
+      return new SkipListRep<BytewiseEntryComparator>(
+          BytewiseEntryComparator(), allocator);
+    }
+    return new SkipListRep<const KeyComparator&>(cmp, allocator);
+  }
+};
+
+
+class InlineSkipListRepFactory : public MemTableRepFactory {
+ public:
+  const char* Name() const override { return "leveldb.InlineSkipListRep"; }
+
+  MemTableRep* CreateMemTableRep(const KeyComparator& cmp,
+                                 MemTableAllocator* arena) override {
+    Allocator* const allocator = static_cast<Allocator*>(arena);
+    return new InlineSkipListRep(cmp, allocator);
+  }
+};
+
+class HashSkipListRep : public MemTableRep {
+ public:
+  HashSkipListRep(const KeyComparator& cmp, Allocator* allocator,
+                  size_t prefix_length, size_t bucket_count)
+      : MemTableRep(allocator),
+        compare_(cmp),
+        prefix_length_(prefix_length),
+        bucket_count_(bucket_count),
+        arena_(allocator),
+        buckets_(new std::atomic<EntryList*>[bucket_count]) {
+    for (size_t i = 0; i < bucket_count_; i++) {
+      buckets_[i].store(nullptr, std::memory_order_relaxed);
+    }
+  }
+
+  // The bucket lists live in the arena and need no destruction.
+  ~HashSkipListRep() override { delete[] buckets_; }
+
+  void Insert(const char* entry) override {
+    std::atomic<EntryList*>* slot = Bucket(EntryUserKey(entry));
+    EntryList* list = slot->load(std::memory_order_relaxed);
+    if (list == nullptr) {
+      char* mem = arena_->AllocateAligned(sizeof(EntryList));
+      list = new (mem) EntryList(compare_, arena_);
+      // Publish the list only once it is fully constructed.
+      slot->store(list, std::memory_order_release);
+    }
+    list->Insert(entry);
+  }
+
+  size_t ApproximateMemoryUsage() override { return 0; }
+
+  // Collects every bucket into a temporary skiplist so that entries can be
+  // visited in total order.
+  Iterator* GetIterator() override {
+    Arena* arena = new Arena;
+    EntryList* all = new EntryList(compare_, arena);
+    for (size_t i = 0; i < bucket_count_; i++) {
+      EntryList* list = buckets_[i].load(std::memory_order_acquire);
+      if (list != nullptr) {
+        EntryList::Iterator iter(list);
+        for (iter.SeekToFirst(); iter.Valid(); iter.Next()) {
+          all->Insert(iter.key());
+        }
+      }
+    }
+    return new SkipListIterator<EntryList>(all, arena);
+  }
+
+  Iterator* GetLookupIterator() override { return new LookupIterator(this); }
+
+ private:
+  // Only searches the bucket of the target's prefix.
+  class LookupIterator : public MemTableRep::Iterator {
+   public:
+    explicit LookupIterator(HashSkipListRep* rep)
+        : rep_(rep), list_(nullptr), iter_(nullptr) {}
+
+    bool Valid() const override { return list_ != nullptr && iter_.Valid(); }
+    const char* key() const override { return iter_.key(); }
+    void Next() override { iter_.Next(); }
+    void Prev() override { iter_.Prev(); }
+
+    void Seek(const char* target) override {
+      list_ = rep_->Bucket(EntryUserKey(target))
+                  ->load(std::memory_order_acquire);
+      if (list_ != nullptr) {
+        iter_ = EntryList::Iterator(list_);
+        iter_.Seek(target);
+      }
+    }
+
+    // Total order is not supported.
+    void SeekToFirst() override { list_ = nullptr; }
+    void SeekToLast() override { list_ = nullptr; }
+
+   private:
+    HashSkipListRep* const rep_;
+    const EntryList* list_;
+    EntryList::Iterator iter_;
+  };
+
+  std::atomic<EntryList*>* Bucket(const Slice& user_key) const {
+    const size_t n = std::min(prefix_length_, user_key.size());
+    return &buckets_[Hash(user_key.data(), n, 0) % bucket_count_];
+  }
+
+  const KeyComparator& compare_;
+  const size_t prefix_length_;
+  const size_t bucket_count_;
+  Allocator* const arena_;  // Holds the bucket lists
+  std::atomic<EntryList*>* const buckets_;
+};
+
+class HashSkipListRepFactory : public MemTableRepFactory {
+ public:
+  HashSkipListRepFactory(size_t prefix_length, size_t bucket_count)
+      : prefix_length_(prefix_length), bucket_count_(bucket_count) {}
+
+  const char* Name() const override { return "leveldb.HashSkipListRep"; }
+
+  MemTableRep* CreateMemTableRep(const KeyComparator& cmp,
+                                 MemTableAllocator* arena) override {
+    Allocator* const allocator = static_cast<Allocator*>(arena);
+    return new HashSkipListRep(cmp, allocator, prefix_length_, bucket_count_);
+  }
+
+ private:
+  const size_t prefix_length_;
+  const size_t bucket_count_;
+};
+
+struct EntryLess {
+  const KeyComparator& compare;
+  bool operator()(const char* a, const char* b) const {
+    return compare(a, b) < 0;
+  }
+};
+
+typedef std::vector<const char*> EntryVector;
+
+// Iterates over a sorted vector of entries it shares with the rep.
+class VectorIterator : public MemTableRep::Iterator {
+ public:
+  VectorIterator(const KeyComparator& cmp,
+                 std::shared_ptr<const EntryVector> entries)
+      : compare_(cmp), entries_(std::move(entries)), pos_(entries_->size()) {}
+
+  bool Valid() const override { return pos_ < entries_->size(); }
+  const char* key() const override { return (*entries_)[pos_]; }
+  void Next() override { pos_++; }
+  void Prev() override { pos_ = (pos_ == 0) ? entries_->size() : pos_ - 1; }
+
+  void Seek(const char* target) override {
+    pos_ = std::lower_bound(entries_->begin(), entries_->end(), target,
+                            EntryLess{compare_}) -
+           entries_->begin();
+  }
+
+  void SeekToFirst() override { pos_ = 0; }
+  void SeekToLast() override {
+    pos_ = entries_->empty() ? 0 : entries_->size() - 1;
+  }
+
+ private:
+  const KeyComparator& compare_;
+  const std::shared_ptr<const EntryVector> entries_;
+  size_t pos_;  // entries_->size() if not valid
+};
+
+// Appends entries in arrival order.  Readers share a sorted copy of the
+// entries, which the first reader after an insert brings up to date by
+// sorting only the entries added since and merging them in.  Once the rep
+// is read-only the copy is complete and never changes again.
+class VectorRep : public MemTableRep {
+ public:
+  VectorRep(const KeyComparator& cmp, MemTableAllocator* allocator,
+            size_t reserve)
+      : MemTableRep(allocator),
+        compare_(cmp),
+        sorted_(std::make_shared<EntryVector>()),
+        read_only_(false) {
+    entries_.reserve(reserve);
+  }
+
+  void Insert(const char* entry) override {
+    MutexLock l(&mu_);
+    assert(!read_only_);
+    entries_.push_back(entry);
+  }
+
+  void MarkReadOnly() override {
+    MutexLock l(&mu_);
+    read_only_ = true;
+  }
+
+  size_t ApproximateMemoryUsage() override {
+    MutexLock l(&mu_);
+    return (entries_.capacity() + sorted_->capacity()) * sizeof(const char*);
+  }
+
+  Iterator* GetIterator() override {
+    mu_.Lock();
+    std::shared_ptr<const EntryVector> sorted = sorted_;
+    if (sorted->size() == entries_.size()) {
+      mu_.Unlock();
+      return new VectorIterator(compare_, std::move(sorted));
+    }
+    EntryVector added(entries_.begin() + sorted->size(), entries_.end());
+    mu_.Unlock();
+
+    std::sort(added.begin(), added.end(), EntryLess{compare_});
+    std::shared_ptr<EntryVector> merged = std::make_shared<EntryVector>();
+    merged->reserve(sorted->size() + added.size());
+    std::merge(sorted->begin(), sorted->end(), added.begin(), added.end(),
+               std::back_inserter(*merged), EntryLess{compare_});
+
+    mu_.Lock();
+    if (merged->size() > sorted_->size()) {
+      sorted_ = merged;
+    }
+    mu_.Unlock();
+    return new VectorIterator(compare_, std::move(merged));
+  }
+
+ private:
+  const KeyComparator& compare_;
+  port::Mutex mu_;
+  EntryVector entries_ GUARDED_BY(mu_);
+  std::shared_ptr<const EntryVector> sorted_ GUARDED_BY(mu_);
+  bool read_only_ GUARDED_BY(mu_);
+};
+
+class VectorRepFactory : public MemTableRepFactory {
+ public:
+  explicit VectorRepFactory(size_t reserve) : reserve_(reserve) {}
+
+  const char* Name() const override { return "leveldb.VectorRep"; }
+
+  MemTableRep* CreateMemTableRep(const KeyComparator& cmp,
+                                 MemTableAllocator* allocator) override {
+    return new VectorRep(cmp, allocator, reserve_);
+  }
+
+ private:
+  const size_t reserve_;
+};
+
+}  // namespace
+
+MemTableRepFactory* NewSkipListRepFactory() { return new SkipListRepFactory; }
+
+MemTableRepFactory* NewInlineSkipListRepFactory() {
+  return new InlineSkipListRepFactory;
+}
+
+MemTableRepFactory* NewHashSkipListRepFactory(size_t prefix_length,
+                                              size_t bucket_count) {
+  return new HashSkipListRepFactory(prefix_length, bucket_count);
+}
+
+MemTableRepFactory* NewVectorRepFactory(size_t reserve) {
+  return new VectorRepFactory(reserve);
+}
+
+}  // namespace leveldb
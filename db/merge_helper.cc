@@ -0,0 +1,27 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/merge_helper.h"
+
+#include "leveldb/merge_operator.h"
+
+namespace leveldb {
+
+Status FullMerge(const MergeOperator* merge_operator, const Slice& user_key,
+                 const Slice* existing_value,
+                 const std::vector<std::string>& operands,
+                 std::string* result) {
+  if (merge_operator == nullptr) {
+    return Status::InvalidArgument("merge operand without a merge operator",
+                                   user_key);
+  }
+  std::vector<Slice> oldest_first(operands.rbegin(), operands.rend());
+  if (!merge_operator->FullMerge(user_key, existing_value, oldest_first,
+                                 result)) {
+    return Status::Corruption("merge failed for", user_key);
+  }
+  return Status::OK();
+}
+
+}  // namespace leveldb
@@ -0,0 +1,176 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/range_tombstone.h"
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+#include "leveldb/table_builder.h"
+
+namespace leveldb {
+
+RangeTombstoneList::RangeTombstoneList(const Comparator* user_comparator)
+    : ucmp_(user_comparator), finished_(false) {}
+
+void RangeTombstoneList::Add(const RangeTombstone& tombstone) {
+  assert(!finished_);
+  if (ucmp_->Compare(tombstone.begin, tombstone.end) < 0) {
+    tombstones_.push_back(tombstone);
+  }
+}
+
+Status RangeTombstoneList::AddAll(Iterator* iter) {
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    ParsedInternalKey ikey;
+    if (!ParseInternalKey(iter->key(), &ikey) ||
+        ikey.type != kTypeRangeDeletion) {
+      return Status::Corruption("bad range tombstone");
+    }
+    Add(RangeTombstone(ikey.user_key, iter->value(), ikey.sequence));
+  }
+  return iter->status();
+}
+
+void RangeTombstoneList::AddAll(const RangeTombstoneList& other) {
+  assert(!finished_);
+  tombstones_.insert(tombstones_.end(), other.tombstones_.begin(),
+                     other.tombstones_.end());
+}
+
+void RangeTombstoneList::Finish() {
+  assert(!finished_);
+  finished_ = true;
+  if (tombstones_.empty()) {
+    return;
+  }
+
+  const Comparator* ucmp = ucmp_;
+  auto key_less = [ucmp](const std::string& a, const std::string& b) {
+    return ucmp->Compare(a, b) < 0;
+  };
+  auto key_equal = [ucmp](const std::string& a, const std::string& b) {
+    return ucmp->Compare(a, b) == 0;
+  };
+
+  // Every begin and end key starts a fragment.
+  std::vector<std::string> points;
+  points.reserve(2 * tombstones_.size());
+  for (const RangeTombstone& t : tombstones_) {
+    points.push_back(t.begin);
+    points.push_back(t.end);
+  }
+  std::sort(points.begin(), points.end(), key_less);
+  points.erase(std::unique(points.begin(), points.end(), key_equal),
+               points.end());
+
+  std::vector<const RangeTombstone*> by_begin;
+  for (const RangeTombstone& t : tombstones_) {
+    by_begin.push_back(&t);
+  }
+  std::sort(by_begin.begin(), by_begin.end(),
+            [ucmp](const RangeTombstone* a, const RangeTombstone* b) {
+              return ucmp->Compare(a->begin, b->begin) < 0;
+            });
+
+  // Sweep the points, keeping the tombstones that cover the current one.
+  std::vector<const RangeTombstone*> active;
+  size_t next = 0;
+  for (const std::string& point : points) {
+    size_t kept = 0;
+    for (size_t i = 0; i < active.size(); i++) {
+      if (ucmp->Compare(active[i]->end, point) > 0) {
+        active[kept++] = active[i];
+      }
+    }
+    active.resize(kept);
+    while (next < by_begin.size() &&
+           ucmp->Compare(by_begin[next]->begin, point) == 0) {
+      active.push_back(by_begin[next++]);
+    }
+
+    Fragment fragment;
+    fragment.start = point;
+    for (const RangeTombstone* t : active) {
+      fragment.seqs.push_back(t->seq);
+    }
+    std::sort(fragment.seqs.begin(), fragment.seqs.end(),
+              std::greater<SequenceNumber>());
+    if (fragments_.empty() || fragments_.back().seqs != fragment.seqs) {
+      fragments_.push_back(std::move(fragment));
+    }
+  }
+}
+
+SequenceNumber RangeTombstoneList::MaxCoveringSequence(
+    const Slice& user_key, SequenceNumber read_sequence) const {
+  assert(finished_);
+  // Find the last fragment starting at or before user_key.
+  size_t left = 0;
+  size_t right = fragments_.size();
+  while (left < right) {
+    size_t mid = left + (right - left) / 2;
+    if (ucmp_->Compare(fragments_[mid].start, user_key) <= 0) {
+      left = mid + 1;
+    } else {
+      right = mid;
+    }
+  }
+  if (left == 0) {
+    return 0;
+  }
+  for (SequenceNumber seq : fragments_[left - 1].seqs) {
+    if (seq <= read_sequence) {
+      return seq;
+    }
+  }
+  return 0;
+}
+
+bool ClipRangeTombstone(const Comparator* ucmp, const std::string* lower,
+                        const std::string* upper, RangeTombstone* tombstone) {
+  if (lower != nullptr && ucmp->Compare(tombstone->begin, *lower) < 0) {
+    tombstone->begin = *lower;
+  }
+  if (upper != nullptr && ucmp->Compare(tombstone->end, *upper) > 0) {
+    tombstone->end = *upper;
+  }
+  return ucmp->Compare(tombstone->begin, tombstone->end) < 0;
+}
+
+void SortRangeTombstones(const InternalKeyComparator& icmp,
+                         std::vector<RangeTombstone>* tombstones) {
+  const Comparator* ucmp = icmp.user_comparator();
+  std::sort(tombstones->begin(), tombstones->end(),
+            [ucmp](const RangeTombstone& a, const RangeTombstone& b) {
+              int r = ucmp->Compare(a.begin, b.begin);
+              return r < 0 || (r == 0 && a.seq > b.seq);
+            });
+}
+
+void AddRangeTombstonesToTable(const InternalKeyComparator& icmp,
+                               const std::vector<RangeTombstone>& tombstones,
+                               bool has_entries, TableBuilder* builder,
+                               InternalKey* smallest, InternalKey* largest) {
+  for (const RangeTombstone& t : tombstones) {
+    const InternalKey start = t.StartKey();
+    const InternalKey end = t.EndKey();
+    builder->AddRangeTombstone(start.Encode(), t.end);
+    if (!has_entries) {
+      *smallest = start;
+      *largest = end;
+      has_entries = true;
+    } else {
+      if (icmp.Compare(start, *smallest) < 0) {
+        *smallest = start;
+      }
+      if (icmp.Compare(end, *largest) > 0) {
+        *largest = end;
+      }
+    }
+  }
+}
+
+}  // namespace leveldb
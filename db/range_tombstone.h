@@ -0,0 +1,135 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A range tombstone, written by DB::DeleteRange(), deletes every entry
+// whose user key is in [begin, end) and whose sequence number is smaller
+// than that of the tombstone.
+//
+// Tombstones are kept apart from point entries: in a separate rep of
+// each memtable and in a "leveldb.rangedel" meta block of each table.
+// Both store a tombstone as the entry
+//
+//    key    InternalKey(begin, sequence, kTypeRangeDeletion)
+//    value  end
+//
+// A table file's key range covers all of its tombstones, so a lookup
+// consults every file that may hold a tombstone for the key.  The largest
+// key of a file whose last tombstone ends at "end" is
+// InternalKey(end, kMaxSequenceNumber, kTypeRangeDeletion), which sorts
+// before every real entry for "end".
+
+#ifndef STORAGE_LEVELDB_DB_RANGE_TOMBSTONE_H_
+#define STORAGE_LEVELDB_DB_RANGE_TOMBSTONE_H_
+
+#include <string>
+#include <vector>
+
+#include "db/dbformat.h"
+#include "leveldb/iterator.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class TableBuilder;
+
+struct RangeTombstone {
+  RangeTombstone() : seq(0) {}
+  RangeTombstone(const Slice& b, const Slice& e, SequenceNumber s)
+      : begin(b.ToString()), end(e.ToString()), seq(s) {}
+
+  // The key the tombstone is stored under.
+  InternalKey StartKey() const {
+    return InternalKey(begin, seq, kTypeRangeDeletion);
+  }
+
+  // The largest key of a table holding the tombstone.
+  InternalKey EndKey() const {
+    return InternalKey(end, kMaxSequenceNumber, kTypeRangeDeletion);
+  }
+
+  std::string begin;
+  std::string end;  // Exclusive
+  SequenceNumber seq;
+};
+
+// A set of range tombstones that answers which of them cover a key.
+// Tombstones are split into non-overlapping fragments, so a query is a
+// binary search.
+//
+// Add() and Finish() require external synchronization; after Finish(),
+// the const methods may be called from several threads.
+class RangeTombstoneList {
+ public:
+  explicit RangeTombstoneList(const Comparator* user_comparator);
+
+  RangeTombstoneList(const RangeTombstoneList&) = delete;
+  RangeTombstoneList& operator=(const RangeTombstoneList&) = delete;
+
+  // REQUIRES: Finish() has not been called.
+  void Add(const RangeTombstone& tombstone);
+
+  // Add every tombstone stored in *iter.
+  // REQUIRES: Finish() has not been called.
+  Status AddAll(Iterator* iter);
+
+  // Add every tombstone in *other.
+  // REQUIRES: Finish() has not been called.
+  void AddAll(const RangeTombstoneList& other);
+
+  // Build the fragments.  Must be called before MaxCoveringSequence().
+  void Finish();
+
+  bool empty() const { return tombstones_.empty(); }
+
+  // Returns the largest sequence number not above "read_sequence" of a
+  // tombstone covering "user_key", or zero if there is none.
+  // REQUIRES: Finish() has been called.
+  SequenceNumber MaxCoveringSequence(const Slice& user_key,
+                                     SequenceNumber read_sequence) const;
+
+  // Returns true if the entry "key" is deleted by a tombstone visible at
+  // "read_sequence".
+  bool ShouldDelete(const ParsedInternalKey& key,
+                    SequenceNumber read_sequence) const {
+    return MaxCoveringSequence(key.user_key, read_sequence) > key.sequence;
+  }
+
+  // The tombstones in the order they were added.
+  const std::vector<RangeTombstone>& tombstones() const {
+    return tombstones_;
+  }
+
+ private:
+  // Covers [start, start of the next fragment).
+  struct Fragment {
+    std::string start;
+    std::vector<SequenceNumber> seqs;  // Decreasing
+  };
+
+  const Comparator* const ucmp_;
+  std::vector<RangeTombstone> tombstones_;
+  std::vector<Fragment> fragments_;
+  bool finished_;
+};
+
+// Clip *tombstone to [*lower, *upper); a null bound leaves that side
+// open.  Returns false if nothing of the tombstone is left.
+bool ClipRangeTombstone(const Comparator* ucmp, const std::string* lower,
+                        const std::string* upper, RangeTombstone* tombstone);
+
+// Sort "tombstones" in the order they are stored in a table.
+void SortRangeTombstones(const InternalKeyComparator& icmp,
+                         std::vector<RangeTombstone>* tombstones);
+
+// Add the sorted "tombstones" to *builder and widen [*smallest, *largest]
+// to cover them.  "has_entries" tells whether *smallest and *largest
+// already hold the bounds of point entries.
+void AddRangeTombstonesToTable(const InternalKeyComparator& icmp,
+                               const std::vector<RangeTombstone>& tombstones,
+                               bool has_entries, TableBuilder* builder,
+                               InternalKey* smallest, InternalKey* largest);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_RANGE_TOMBSTONE_H_
@@ -24,6 +24,8 @@
 //   Store per-table metadata (smallest, largest, largest-seq#, ...)
 //   in the table's meta section to speed up ScanTable.
 
+#include <algorithm>
+
 #include "db/builder.h"
 #include "db/db_impl.h"
 #include "db/dbformat.h"
@@ -31,6 +33,7 @@
 #include "db/log_reader.h"
 #include "db/log_writer.h"
 #include "db/memtable.h"
+#include "db/range_tombstone.h"
 #include "db/table_cache.h"
 #include "db/version_edit.h"
 #include "db/write_batch_internal.h"
@@ -177,7 +180,7 @@ class Repairer {
     std::string scratch;
     Slice record;
     WriteBatch batch;
-    MemTable* mem = new MemTable(icmp_);
+    MemTable* mem = new MemTable(icmp_, options_);
     mem->Ref();
     int counter = 0;
     while (reader.ReadRecord(&record, &scratch)) {
@@ -203,7 +206,19 @@ class Repairer {
     FileMetaData meta;
     meta.number = next_file_number_++;
     Iterator* iter = mem->NewIterator();
-    status = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta);
+    std::vector<RangeTombstone> range_dels;
+    Iterator* range_del_iter = mem->NewRangeTombstoneIterator();
+    if (range_del_iter != nullptr) {
+      RangeTombstoneList list(icmp_.user_comparator());
+      status = list.AddAll(range_del_iter);
+      delete range_del_iter;
+      range_dels = list.tombstones();
+      SortRangeTombstones(icmp_, &range_dels);
+    }
+    if (status.ok()) {
+      status = BuildTable(dbname_, env_, options_, table_cache_, iter,
+                          range_dels, &meta);
+    }
     delete iter;
     mem->Unref();
     mem = nullptr;
@@ -235,6 +250,8 @@ class Repairer {
   void ScanTable(uint64_t number) {
     TableInfo t;
     t.meta.number = number;
+    // The age of the table is unknown: count it from the repair.
+    t.meta.creation_time = env_->NowMicros() / 1000000;
     std::string fname = TableFileName(dbname_, number);
     Status status = env_->GetFileSize(fname, &t.meta.file_size);
     if (!status.ok()) {
@@ -268,6 +285,10 @@ class Repairer {
       }
 
       counter++;
+      t.meta.num_entries++;
+      if (parsed.type == kTypeDeletion) {
+        t.meta.num_deletions++;
+      }
       if (empty) {
         empty = false;
         t.meta.smallest.DecodeFrom(key);
@@ -281,6 +302,17 @@ class Repairer {
       status = iter->status();
     }
     delete iter;
+    if (status.ok()) {
+      // The key range of the table also covers its range tombstones.
+      RangeTombstoneList range_dels(icmp_.user_comparator());
+      status = table_cache_->AddRangeTombstones(
+          t.meta.number, t.meta.file_size, &range_dels);
+      for (const RangeTombstone& tombstone : range_dels.tombstones()) {
+        AddRangeTombstoneToTableInfo(tombstone, empty, &t);
+        empty = false;
+        counter++;
+      }
+    }
     Log(options_.info_log, "Table #%llu: %d entries %s",
         (unsigned long long)t.meta.number, counter, status.ToString().c_str());
 
@@ -291,6 +323,24 @@ class Repairer {
     }
   }
 
+  // Widen the key range of *t to cover "tombstone".  "empty" tells
+  // whether the range holds no key yet.
+  void AddRangeTombstoneToTableInfo(const RangeTombstone& tombstone,
+                                    bool empty, TableInfo* t) {
+    const InternalKey start = tombstone.StartKey();
+    const InternalKey end = tombstone.EndKey();
+    if (empty || icmp_.Compare(start, t->meta.smallest) < 0) {
+      t->meta.smallest = start;
+    }
+    if (empty || icmp_.Compare(end, t->meta.largest) > 0) {
+      t->meta.largest = end;
+    }
+    if (tombstone.seq > t->max_sequence) {
+      t->max_sequence = tombstone.seq;
+    }
+    t->meta.has_range_deletions = true;
+  }
+
   void RepairTable(const std::string& src, TableInfo t) {
     // We will copy src contents to a new table and then rename the
     // new table over the source.
@@ -307,11 +357,32 @@ class Repairer {
     // Copy data.
     Iterator* iter = NewTableIterator(t.meta);
     int counter = 0;
+    SequenceNumber smallest_seq = kMaxSequenceNumber;
+    SequenceNumber largest_seq = 0;
+    ParsedInternalKey parsed;
     for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
       builder->Add(iter->key(), iter->value());
       counter++;
+      if (ParseInternalKey(iter->key(), &parsed)) {
+        smallest_seq = std::min(smallest_seq, parsed.sequence);
+        largest_seq = std::max(largest_seq, parsed.sequence);
+      }
     }
     delete iter;
+    if (counter > 0) {
+      builder->SetEntryStats(t.meta.num_deletions, smallest_seq, largest_seq);
+    }
+    RangeTombstoneList range_dels(icmp_.user_comparator());
+    if (table_cache_->AddRangeTombstones(t.meta.number, t.meta.file_size,
+                                         &range_dels)
+            .ok()) {
+      for (const RangeTombstone& tombstone : range_dels.tombstones()) {
+        builder->AddRangeTombstone(tombstone.StartKey().Encode(),
+                                   tombstone.end);
+        AddRangeTombstoneToTableInfo(tombstone, counter == 0, &t);
+        counter++;
+      }
+    }
 
     ArchiveFile(src);
     if (counter == 0) {
@@ -368,8 +439,7 @@ class Repairer {
     for (size_t i = 0; i < tables_.size(); i++) {
       // TODO(opt): separate out into multiple levels
       const TableInfo& t = tables_[i];
-      edit_.AddFile(0, t.meta.number, t.meta.file_size, t.meta.smallest,
-                    t.meta.largest);
+      edit_.AddFile(0, t.meta);
     }
 
     // std::fprintf(stderr,
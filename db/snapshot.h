@@ -5,6 +5,8 @@
 #ifndef STORAGE_LEVELDB_DB_SNAPSHOT_H_
 #define STORAGE_LEVELDB_DB_SNAPSHOT_H_
 
+#include <vector>
+
 #include "db/dbformat.h"
 #include "leveldb/db.h"
 
@@ -53,6 +55,13 @@ class SnapshotList {
     return head_.prev_;
   }
 
+  // Appends the sequence numbers of all snapshots, oldest first, to *seqs.
+  void GetAll(std::vector<SequenceNumber>* seqs) const {
+    for (const SnapshotImpl* s = head_.next_; s != &head_; s = s->next_) {
+      seqs->push_back(s->sequence_number_);
+    }
+  }
+
   // Creates a SnapshotImpl and appends it to the end of the list.
   SnapshotImpl* New(SequenceNumber sequence_number) {
     assert(empty() || newest()->sequence_number_ <= sequence_number);
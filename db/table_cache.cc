@@ -4,9 +4,13 @@
 
 #include "db/table_cache.h"
 
+#include <algorithm>
+
 #include "db/filename.h"
+#include "db/range_tombstone.h"
 #include "leveldb/env.h"
 #include "leveldb/table.h"
+#include "leveldb/table_properties.h"
 #include "util/coding.h"
 
 namespace leveldb {
@@ -14,10 +18,12 @@ namespace leveldb {
 struct TableAndFile {
   RandomAccessFile* file;
   Table* table;
+  RangeTombstoneList* range_dels;  // Null if the table has none
 };
 
 static void DeleteEntry(const Slice& key, void* value) {
   TableAndFile* tf = reinterpret_cast<TableAndFile*>(value);
+  delete tf->range_dels;
   delete tf->table;
   delete tf->file;
   delete tf;
@@ -59,6 +65,24 @@ Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
     if (s.ok()) {
       s = Table::Open(options_, file, file_size, &table);
     }
+    RangeTombstoneList* range_dels = nullptr;
+    if (s.ok()) {
+      Iterator* iter = table->NewRangeTombstoneIterator();
+      if (iter != nullptr) {
+        const Comparator* ucmp =
+            static_cast<const InternalKeyComparator*>(options_.comparator)
+                ->user_comparator();
+        range_dels = new RangeTombstoneList(ucmp);
+        s = range_dels->AddAll(iter);
+        range_dels->Finish();
+        delete iter;
+        if (!s.ok()) {
+          delete range_dels;
+          delete table;
+          table = nullptr;
+        }
+      }
+    }
 
     if (!s.ok()) {
       assert(table == nullptr);
@@ -69,6 +93,7 @@ Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
       TableAndFile* tf = new TableAndFile;
       tf->file = file;
       tf->table = table;
+      tf->range_dels = range_dels;
       *handle = cache_->Insert(key, tf, 1, &DeleteEntry);
     }
   }
@@ -99,7 +124,7 @@ Iterator* TableCache::NewIterator(const ReadOptions& options,
 
 Status TableCache::Get(const ReadOptions& options, uint64_t file_number,
                        uint64_t file_size, const Slice& k, void* arg,
-                       void (*handle_result)(void*, const Slice&,
+                       bool (*handle_result)(void*, const Slice&,
                                              const Slice&)) {
   Cache::Handle* handle = nullptr;
   Status s = FindTable(file_number, file_size, &handle);
@@ -111,6 +136,62 @@ Status TableCache::Get(const ReadOptions& options, uint64_t file_number,
   return s;
 }
 
+Status TableCache::AddRangeTombstones(uint64_t file_number,
+                                      uint64_t file_size,
+                                      RangeTombstoneList* list) {
+  Cache::Handle* handle = nullptr;
+  Status s = FindTable(file_number, file_size, &handle);
+  if (s.ok()) {
+    const RangeTombstoneList* range_dels =
+        reinterpret_cast<TableAndFile*>(cache_->Value(handle))->range_dels;
+    if (range_dels != nullptr) {
+      list->AddAll(*range_dels);
+    }
+    cache_->Release(handle);
+  }
+  return s;
+}
+
+Status TableCache::GetTableProperties(uint64_t file_number,
+                                      uint64_t file_size,
+                                      TableProperties* props,
+                                      bool* has_properties) {
+  *has_properties = false;
+  Cache::Handle* handle = nullptr;
+  Status s = FindTable(file_number, file_size, &handle);
+  if (s.ok()) {
+    const TableProperties* table_props =
+        reinterpret_cast<TableAndFile*>(cache_->Value(handle))
+            ->table->GetProperties();
+    if (table_props != nullptr) {
+      *props = *table_props;
+      *has_properties = true;
+    }
+    cache_->Release(handle);
+  }
+  return s;
+}
+
+Status TableCache::GetCoveringTombstone(uint64_t file_number,
+                                        uint64_t file_size,
+                                        const Slice& user_key,
+                                        SequenceNumber read_sequence,
+                                        SequenceNumber* max_sequence) {
+  Cache::Handle* handle = nullptr;
+  Status s = FindTable(file_number, file_size, &handle);
+  if (s.ok()) {
+    const RangeTombstoneList* range_dels =
+        reinterpret_cast<TableAndFile*>(cache_->Value(handle))->range_dels;
+    if (range_dels != nullptr) {
+      *max_sequence = std::max(
+          *max_sequence,
+          range_dels->MaxCoveringSequence(user_key, read_sequence));
+    }
+    cache_->Release(handle);
+  }
+  return s;
+}
+
 void TableCache::Evict(uint64_t file_number) {
   char buf[sizeof(file_number)];
   EncodeFixed64(buf, file_number);
@@ -18,6 +18,8 @@
 namespace leveldb {
 
 class Env;
+class RangeTombstoneList;
+struct TableProperties;
 
 class TableCache {
  public:
@@ -39,10 +41,29 @@ class TableCache {
                         uint64_t file_size, Table** tableptr = nullptr);
 
   // If a seek to internal key "k" in specified file finds an entry,
-  // call (*handle_result)(arg, found_key, found_value).
+  // call (*handle_result)(arg, found_key, found_value), and call it again
+  // with each following entry for as long as it returns true.
   Status Get(const ReadOptions& options, uint64_t file_number,
              uint64_t file_size, const Slice& k, void* arg,
-             void (*handle_result)(void*, const Slice&, const Slice&));
+             bool (*handle_result)(void*, const Slice&, const Slice&));
+
+  // Add the range tombstones of the specified file to *list.
+  Status AddRangeTombstones(uint64_t file_number, uint64_t file_size,
+                            RangeTombstoneList* list);
+
+  // Store in *props the properties of the specified file and set
+  // *has_properties.  If the file was written before properties were
+  // recorded, returns OK and sets *has_properties to false.
+  Status GetTableProperties(uint64_t file_number, uint64_t file_size,
+                            TableProperties* props, bool* has_properties);
+
+  // Raise *max_sequence to the largest sequence number not above
+  // "read_sequence" of a range tombstone in the specified file that
+  // covers "user_key".
+  Status GetCoveringTombstone(uint64_t file_number, uint64_t file_size,
+                              const Slice& user_key,
+                              SequenceNumber read_sequence,
+                              SequenceNumber* max_sequence);
 
   // Evict any entry for the specified file number
   void Evict(uint64_t file_number);
@@ -20,20 +20,40 @@ enum Tag {
   kDeletedFile = 6,
   kNewFile = 7,
   // 8 was used for large value refs
-  kPrevLogNumber = 9
+  kPrevLogNumber = 9,
+  // A new file followed by a list of optional fields
+  kNewFileWithFields = 10,
+  kNumLevels = 11
 };
 
+// Tags of the optional fields of a kNewFileWithFields entry.  Each field
+// is written as its tag followed by a length-prefixed value, and the list
+// ends with kEndOfFields.
+enum NewFileField {
+  kEndOfFields = 0,
+  kHasRangeDeletions = 1,
+  kNumEntries = 2,
+  kNumDeletions = 3,
+  kCreationTime = 4
+};
+
+static bool HasOptionalFields(const FileMetaData& f) {
+  return f.has_range_deletions || f.num_entries > 0 || f.creation_time > 0;
+}
+
 void VersionEdit::Clear() {
   comparator_.clear();
   log_number_ = 0;
   prev_log_number_ = 0;
   last_sequence_ = 0;
   next_file_number_ = 0;
+  num_levels_ = 0;
   has_comparator_ = false;
   has_log_number_ = false;
   has_prev_log_number_ = false;
   has_next_file_number_ = false;
   has_last_sequence_ = false;
+  has_num_levels_ = false;
   compact_pointers_.clear();
   deleted_files_.clear();
   new_files_.clear();
@@ -60,6 +80,10 @@ void VersionEdit::EncodeTo(std::string* dst) const {
     PutVarint32(dst, kLastSequence);
     PutVarint64(dst, last_sequence_);
   }
+  if (has_num_levels_) {
+    PutVarint32(dst, kNumLevels);
+    PutVarint32(dst, num_levels_);
+  }
 
   for (size_t i = 0; i < compact_pointers_.size(); i++) {
     PutVarint32(dst, kCompactPointer);
@@ -75,12 +99,36 @@ void VersionEdit::EncodeTo(std::string* dst) const {
 
   for (size_t i = 0; i < new_files_.size(); i++) {
     const FileMetaData& f = new_files_[i].second;
-    PutVarint32(dst, kNewFile);
+    const bool with_fields = HasOptionalFields(f);
+    PutVarint32(dst, with_fields ? kNewFileWithFields : kNewFile);
     PutVarint32(dst, new_files_[i].first);  // level
     PutVarint64(dst, f.number);
     PutVarint64(dst, f.file_size);
     PutLengthPrefixedSlice(dst, f.smallest.Encode());
     PutLengthPrefixedSlice(dst, f.largest.Encode());
+    if (with_fields) {
+      if (f.has_range_deletions) {
+        PutVarint32(dst, kHasRangeDeletions);
+        PutLengthPrefixedSlice(dst, Slice());
+      }
+      if (f.num_entries > 0) {
+        std::string count;
+        PutVarint64(&count, f.num_entries);
+        PutVarint32(dst, kNumEntries);
+        PutLengthPrefixedSlice(dst, count);
+        count.clear();
+        PutVarint64(&count, f.num_deletions);
+        PutVarint32(dst, kNumDeletions);
+        PutLengthPrefixedSlice(dst, count);
+      }
+      if (f.creation_time > 0) {
+        std::string time;
+        PutVarint64(&time, f.creation_time);
+        PutVarint32(dst, kCreationTime);
+        PutLengthPrefixedSlice(dst, time);
+      }
+      PutVarint32(dst, kEndOfFields);
+    }
   }
 }
 
@@ -95,7 +143,7 @@ static bool GetInternalKey(Slice* input, InternalKey* dst) {
 
 static bool GetLevel(Slice* input, int* level) {
   uint32_t v;
-  if (GetVarint32(input, &v) && v < config::kNumLevels) {
+  if (GetVarint32(input, &v) && v < config::kMaxNumLevels) {
     *level = v;
     return true;
   } else {
@@ -103,6 +151,44 @@ static bool GetLevel(Slice* input, int* level) {
   }
 }
 
+static bool GetNewFileFields(Slice* input, FileMetaData* f) {
+  while (true) {
+    uint32_t field;
+    Slice value;
+    if (!GetVarint32(input, &field)) {
+      return false;
+    }
+    if (field == kEndOfFields) {
+      return true;
+    }
+    if (!GetLengthPrefixedSlice(input, &value)) {
+      return false;
+    }
+    switch (field) {
+      case kHasRangeDeletions:
+        f->has_range_deletions = true;
+        break;
+      case kNumEntries:
+        if (!GetVarint64(&value, &f->num_entries)) {
+          return false;
+        }
+        break;
+      case kNumDeletions:
+        if (!GetVarint64(&value, &f->num_deletions)) {
+          return false;
+        }
+        break;
+      case kCreationTime:
+        if (!GetVarint64(&value, &f->creation_time)) {
+          return false;
+        }
+        break;
+      default:
+        return false;
+    }
+  }
+}
+
 Status VersionEdit::DecodeFrom(const Slice& src) {
   Clear();
   Slice input = src;
@@ -159,6 +245,17 @@ Status VersionEdit::DecodeFrom(const Slice& src) {
         }
         break;
 
+      case kNumLevels: {
+        uint32_t v;
+        if (GetVarint32(&input, &v) && v <= config::kMaxNumLevels) {
+          num_levels_ = v;
+          has_num_levels_ = true;
+        } else {
+          msg = "number of levels";
+        }
+        break;
+      }
+
       case kCompactPointer:
         if (GetLevel(&input, &level) && GetInternalKey(&input, &key)) {
           compact_pointers_.push_back(std::make_pair(level, key));
@@ -186,6 +283,19 @@ Status VersionEdit::DecodeFrom(const Slice& src) {
         }
         break;
 
+      case kNewFileWithFields:
+        if (GetLevel(&input, &level) && GetVarint64(&input, &f.number) &&
+            GetVarint64(&input, &f.file_size) &&
+            GetInternalKey(&input, &f.smallest) &&
+            GetInternalKey(&input, &f.largest) &&
+            GetNewFileFields(&input, &f)) {
+          new_files_.push_back(std::make_pair(level, f));
+          f = FileMetaData();
+        } else {
+          msg = "new-file entry";
+        }
+        break;
+
       default:
         msg = "unknown tag";
         break;
@@ -226,6 +336,10 @@ std::string VersionEdit::DebugString() const {
     r.append("\n  LastSeq: ");
     AppendNumberTo(&r, last_sequence_);
   }
+  if (has_num_levels_) {
+    r.append("\n  NumLevels: ");
+    AppendNumberTo(&r, num_levels_);
+  }
   for (size_t i = 0; i < compact_pointers_.size(); i++) {
     r.append("\n  CompactPointer: ");
     AppendNumberTo(&r, compact_pointers_[i].first);
@@ -250,6 +364,19 @@ std::string VersionEdit::DebugString() const {
     r.append(f.smallest.DebugString());
     r.append(" .. ");
     r.append(f.largest.DebugString());
+    if (f.has_range_deletions) {
+      r.append(" (range deletions)");
+    }
+    if (f.num_entries > 0) {
+      r.append(" entries=");
+      AppendNumberTo(&r, f.num_entries);
+      r.append(" deletions=");
+      AppendNumberTo(&r, f.num_deletions);
+    }
+    if (f.creation_time > 0) {
+      r.append(" created=");
+      AppendNumberTo(&r, f.creation_time);
+    }
   }
   r.append("\n}\n");
   return r;
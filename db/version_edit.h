@@ -16,7 +16,15 @@ namespace leveldb {
 class VersionSet;
 
 struct FileMetaData {
-  FileMetaData() : refs(0), allowed_seeks(1 << 30), file_size(0) {}
+  FileMetaData()
+      : refs(0),
+        allowed_seeks(1 << 30),
+        number(0),
+        file_size(0),
+        has_range_deletions(false),
+        num_entries(0),
+        num_deletions(0),
+        creation_time(0) {}
 
   int refs;
   int allowed_seeks;  // Seeks allowed until compaction
@@ -24,6 +32,10 @@ struct FileMetaData {
   uint64_t file_size;    // File size in bytes
   InternalKey smallest;  // Smallest internal key served by table
   InternalKey largest;   // Largest internal key served by table
+  bool has_range_deletions;  // Does the table hold range tombstones?
+  uint64_t num_entries;      // Number of point entries, 0 if unknown
+  uint64_t num_deletions;    // Number of point deletions among them
+  uint64_t creation_time;    // Seconds since the epoch, 0 if unknown
 };
 
 class VersionEdit {
@@ -53,6 +65,10 @@ class VersionEdit {
     has_last_sequence_ = true;
     last_sequence_ = seq;
   }
+  void SetNumLevels(int num_levels) {
+    has_num_levels_ = true;
+    num_levels_ = num_levels;
+  }
   void SetCompactPointer(int level, const InternalKey& key) {
     compact_pointers_.push_back(std::make_pair(level, key));
   }
@@ -70,6 +86,21 @@ class VersionEdit {
     new_files_.push_back(std::make_pair(level, f));
   }
 
+  // Add the file described by "f" at the specified level, keeping the
+  // persistent fields of "f".
+  void AddFile(int level, const FileMetaData& f) {
+    FileMetaData copy;
+    copy.number = f.number;
+    copy.file_size = f.file_size;
+    copy.smallest = f.smallest;
+    copy.largest = f.largest;
+    copy.has_range_deletions = f.has_range_deletions;
+    copy.num_entries = f.num_entries;
+    copy.num_deletions = f.num_deletions;
+    copy.creation_time = f.creation_time;
+    new_files_.push_back(std::make_pair(level, copy));
+  }
+
   // Delete the specified "file" from the specified "level".
   void RemoveFile(int level, uint64_t file) {
     deleted_files_.insert(std::make_pair(level, file));
@@ -90,11 +121,13 @@ class VersionEdit {
   uint64_t prev_log_number_;
   uint64_t next_file_number_;
   SequenceNumber last_sequence_;
+  int num_levels_;
   bool has_comparator_;
   bool has_log_number_;
   bool has_prev_log_number_;
   bool has_next_file_number_;
   bool has_last_sequence_;
+  bool has_num_levels_;
 
   std::vector<std::pair<int, InternalKey>> compact_pointers_;
   DeletedFileSet deleted_files_;
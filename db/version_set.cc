@@ -6,6 +6,7 @@
 
 #include <algorithm>
 #include <cstdio>
+#include <limits>
 
 #include "db/filename.h"
 #include "db/log_reader.h"
@@ -43,9 +44,9 @@ static double MaxBytesForLevel(const Options* options, int level) {
   // the level-0 compaction threshold based on number of files.
 
   // Result for both level-0 and level-1
-  double result = 10. * 1048576.0;
+  double result = options->max_bytes_for_level_base;
   while (level > 1) {
-    result *= 10;
+    result *= options->max_bytes_for_level_multiplier;
     level--;
   }
   return result;
@@ -72,7 +73,7 @@ Version::~Version() {
   next_->prev_ = prev_;
 
   // Drop references to files
-  for (int level = 0; level < config::kNumLevels; level++) {
+  for (int level = 0; level < config::kMaxNumLevels; level++) {
     for (size_t i = 0; i < files_[level].size(); i++) {
       FileMetaData* f = files_[level][i];
       assert(f->refs > 0);
@@ -237,7 +238,7 @@ void Version::AddIterators(const ReadOptions& options,
   // For levels > 0, we can use a concatenating iterator that sequentially
   // walks through the non-overlapping files in the level, opening them
   // lazily.
-  for (int level = 1; level < config::kNumLevels; level++) {
+  for (int level = 1; level < vset_->NumLevels(); level++) {
     if (!files_[level].empty()) {
       iters->push_back(NewConcatenatingIterator(options, level));
     }
@@ -257,21 +258,33 @@ struct Saver {
   const Comparator* ucmp;
   Slice user_key;
   std::string* value;
+  // Merge operands found so far, newest first.
+  std::vector<std::string>* merge_operands;
+  // Sequence number of the newest range tombstone covering user_key
+  // seen so far, or zero.
+  SequenceNumber covering_tombstone;
 };
 }  // namespace
-static void SaveValue(void* arg, const Slice& ikey, const Slice& v) {
+static bool SaveValue(void* arg, const Slice& ikey, const Slice& v) {
   Saver* s = reinterpret_cast<Saver*>(arg);
   ParsedInternalKey parsed_key;
   if (!ParseInternalKey(ikey, &parsed_key)) {
     s->state = kCorrupt;
-  } else {
-    if (s->ucmp->Compare(parsed_key.user_key, s->user_key) == 0) {
-      s->state = (parsed_key.type == kTypeValue) ? kFound : kDeleted;
-      if (s->state == kFound) {
-        s->value->assign(v.data(), v.size());
-      }
+  } else if (s->ucmp->Compare(parsed_key.user_key, s->user_key) == 0) {
+    if (parsed_key.sequence < s->covering_tombstone) {
+      s->state = kDeleted;
+    } else if (parsed_key.type == kTypeValue) {
+      s->state = kFound;
+      s->value->assign(v.data(), v.size());
+    } else if (parsed_key.type == kTypeMerge) {
+      // Older entries of the key follow.
+      s->merge_operands->push_back(v.ToString());
+      return true;
+    } else {
+      s->state = kDeleted;
     }
   }
+  return false;
 }
 
 static bool NewestFirst(FileMetaData* a, FileMetaData* b) {
@@ -302,7 +315,7 @@ void Version::ForEachOverlapping(Slice user_key, Slice internal_key, void* arg,
   }
 
   // Search other levels.
-  for (int level = 1; level < config::kNumLevels; level++) {
+  for (int level = 1; level < vset_->NumLevels(); level++) {
     size_t num_files = files_[level].size();
     if (num_files == 0) continue;
 
@@ -322,7 +335,9 @@ void Version::ForEachOverlapping(Slice user_key, Slice internal_key, void* arg,
 }
 
 Status Version::Get(const ReadOptions& options, const LookupKey& k,
-                    std::string* value, GetStats* stats) {
+                    std::string* value, GetStats* stats,
+                    std::vector<std::string>* merge_operands,
+                    SequenceNumber covering_tombstone) {
   stats->seek_file = nullptr;
   stats->seek_file_level = -1;
 
@@ -331,6 +346,7 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
     GetStats* stats;
     const ReadOptions* options;
     Slice ikey;
+    SequenceNumber read_sequence;
     FileMetaData* last_file_read;
     int last_file_read_level;
 
@@ -351,6 +367,18 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
       state->last_file_read = f;
       state->last_file_read_level = level;
 
+      // Tombstones in a file are newer than the entries of the files
+      // searched after it, so they are applied before its own entries.
+      if (f->has_range_deletions) {
+        state->s = state->vset->table_cache_->GetCoveringTombstone(
+            f->number, f->file_size, state->saver.user_key,
+            state->read_sequence, &state->saver.covering_tombstone);
+        if (!state->s.ok()) {
+          state->found = true;
+          return false;
+        }
+      }
+
       state->s = state->vset->table_cache_->Get(*state->options, f->number,
                                                 f->file_size, state->ikey,
                                                 &state->saver, SaveValue);
@@ -387,21 +415,43 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
 
   state.options = &options;
   state.ikey = k.internal_key();
+  state.read_sequence =
+      DecodeFixed64(state.ikey.data() + state.ikey.size() - 8) >> 8;
   state.vset = vset_;
 
   state.saver.state = kNotFound;
   state.saver.ucmp = vset_->icmp_.user_comparator();
   state.saver.user_key = k.user_key();
   state.saver.value = value;
+  state.saver.merge_operands = merge_operands;
+  state.saver.covering_tombstone = covering_tombstone;
 
   ForEachOverlapping(state.saver.user_key, state.ikey, &state, &State::Match);
 
   return state.found ? state.s : Status::NotFound(Slice());
 }
 
+Status Version::AddRangeTombstones(RangeTombstoneList* list) {
+  for (int level = 0; level < vset_->NumLevels(); level++) {
+    for (FileMetaData* f : files_[level]) {
+      if (f->has_range_deletions) {
+        Status s = vset_->table_cache_->AddRangeTombstones(f->number,
+                                                           f->file_size, list);
+        if (!s.ok()) {
+          return s;
+        }
+      }
+    }
+  }
+  return Status::OK();
+}
+
 bool Version::UpdateStats(const GetStats& stats) {
   FileMetaData* f = stats.seek_file;
-  if (f != nullptr) {
+  // Universal compaction only merges whole sorted runs, never single files
+  // picked by seeks.
+  if (f != nullptr &&
+      vset_->options_->compaction_style != kCompactionStyleUniversal) {
     f->allowed_seeks--;
     if (f->allowed_seeks <= 0 && file_to_compact_ == nullptr) {
       file_to_compact_ = f;
@@ -470,17 +520,26 @@ bool Version::OverlapInLevel(int level, const Slice* smallest_user_key,
 int Version::PickLevelForMemTableOutput(const Slice& smallest_user_key,
                                         const Slice& largest_user_key) {
   int level = 0;
+  if (vset_->options_->compaction_style == kCompactionStyleUniversal) {
+    // Every flush adds a new sorted run to level-0.
+    return level;
+  }
+  if (vset_->options_->level_compaction_dynamic_level_bytes) {
+    // Only levels from base_level_ down may hold data.  A file that
+    // overlaps nothing is moved there by the next compaction.
+    return level;
+  }
   if (!OverlapInLevel(0, &smallest_user_key, &largest_user_key)) {
     // Push to next level if there is no overlap in next level,
     // and the #bytes overlapping in the level after that are limited.
     InternalKey start(smallest_user_key, kMaxSequenceNumber, kValueTypeForSeek);
     InternalKey limit(largest_user_key, 0, static_cast<ValueType>(0));
     std::vector<FileMetaData*> overlaps;
-    while (level < config::kMaxMemCompactLevel) {
+    while (level < vset_->options_->max_mem_compaction_level) {
       if (OverlapInLevel(level + 1, &smallest_user_key, &largest_user_key)) {
         break;
       }
-      if (level + 2 < config::kNumLevels) {
+      if (level + 2 < vset_->NumLevels()) {
         // Check that file does not overlap too many grandparent bytes.
         GetOverlappingInputs(level + 2, &start, &limit, &overlaps);
         const int64_t sum = TotalFileSize(overlaps);
@@ -494,12 +553,27 @@ int Version::PickLevelForMemTableOutput(const Slice& smallest_user_key,
   return level;
 }
 
+int Version::PickLevelForIngestedFile(const Slice& smallest_user_key,
+                                      const Slice& largest_user_key) {
+  if (vset_->options_->compaction_style == kCompactionStyleUniversal ||
+      OverlapInLevel(0, &smallest_user_key, &largest_user_key)) {
+    return 0;
+  }
+  int level = 0;
+  while (level + 1 < vset_->NumLevels() &&
+         !OverlapInLevel(level + 1, &smallest_user_key, &largest_user_key)) {
+    level++;
+  }
+  // Only levels from base_level_ down may hold data.
+  return level >= base_level_ ? level : 0;
+}
+
 // Store in "*inputs" all files in "level" that overlap [begin,end]
 void Version::GetOverlappingInputs(int level, const InternalKey* begin,
                                    const InternalKey* end,
                                    std::vector<FileMetaData*>* inputs) {
   assert(level >= 0);
-  assert(level < config::kNumLevels);
+  assert(level < vset_->NumLevels());
   inputs->clear();
   Slice user_begin, user_end;
   if (begin != nullptr) {
@@ -539,7 +613,7 @@ void Version::GetOverlappingInputs(int level, const InternalKey* begin,
 
 std::string Version::DebugString() const {
   std::string r;
-  for (int level = 0; level < config::kNumLevels; level++) {
+  for (int level = 0; level < vset_->NumLevels(); level++) {
     // E.g.,
     //   --- level 1 ---
     //   17:123['a' .. 'd']
@@ -591,7 +665,7 @@ class VersionSet::Builder {
 
   VersionSet* vset_;
   Version* base_;
-  LevelState levels_[config::kNumLevels];
+  LevelState levels_[config::kMaxNumLevels];
 
  public:
   // Initialize a builder with the files from *base and other info from *vset
@@ -599,13 +673,13 @@ class VersionSet::Builder {
     base_->Ref();
     BySmallestKey cmp;
     cmp.internal_comparator = &vset_->icmp_;
-    for (int level = 0; level < config::kNumLevels; level++) {
+    for (int level = 0; level < config::kMaxNumLevels; level++) {
       levels_[level].added_files = new FileSet(cmp);
     }
   }
 
   ~Builder() {
-    for (int level = 0; level < config::kNumLevels; level++) {
+    for (int level = 0; level < config::kMaxNumLevels; level++) {
       const FileSet* added = levels_[level].added_files;
       std::vector<FileMetaData*> to_unref;
       to_unref.reserve(added->size());
@@ -672,7 +746,7 @@ class VersionSet::Builder {
   void SaveTo(Version* v) {
     BySmallestKey cmp;
     cmp.internal_comparator = &vset_->icmp_;
-    for (int level = 0; level < config::kNumLevels; level++) {
+    for (int level = 0; level < config::kMaxNumLevels; level++) {
       // Merge the set of added files with the set of pre-existing files.
       // Drop any deleted files.  Store the result in *v.
       const std::vector<FileMetaData*>& base_files = base_->files_[level];
@@ -896,6 +970,8 @@ Status VersionSet::Recover(bool* save_manifest) {
   uint64_t last_sequence = 0;
   uint64_t log_number = 0;
   uint64_t prev_log_number = 0;
+  // Databases written before the number of levels was recorded have 7.
+  int num_levels = 7;
   Builder builder(this, current_);
   int read_records = 0;
 
@@ -942,6 +1018,10 @@ Status VersionSet::Recover(bool* save_manifest) {
         last_sequence = edit.last_sequence_;
         have_last_sequence = true;
       }
+
+      if (edit.has_num_levels_) {
+        num_levels = edit.num_levels_;
+      }
     }
   }
   delete file;
@@ -964,9 +1044,23 @@ Status VersionSet::Recover(bool* save_manifest) {
     MarkFileNumberUsed(log_number);
   }
 
+  Version* v = nullptr;
   if (s.ok()) {
-    Version* v = new Version(this);
+    v = new Version(this);
     builder.SaveTo(v);
+    for (int level = NumLevels(); level < config::kMaxNumLevels; level++) {
+      if (!v->files_[level].empty()) {
+        char buf[100];
+        std::snprintf(buf, sizeof(buf), "%d levels, but files at level %d",
+                      NumLevels(), level);
+        s = Status::InvalidArgument("options.num_levels", buf);
+        delete v;
+        break;
+      }
+    }
+  }
+
+  if (s.ok()) {
     // Install recovered version
     Finalize(v);
     AppendVersion(v);
@@ -976,8 +1070,9 @@ Status VersionSet::Recover(bool* save_manifest) {
     log_number_ = log_number;
     prev_log_number_ = prev_log_number;
 
-    // See if we can reuse the existing MANIFEST file.
-    if (ReuseManifest(dscname, current)) {
+    // See if we can reuse the existing MANIFEST file.  A new one records
+    // a changed number of levels.
+    if (num_levels == NumLevels() && ReuseManifest(dscname, current)) {
       // No need to save new manifest
     } else {
       *save_manifest = true;
@@ -1033,7 +1128,20 @@ void VersionSet::Finalize(Version* v) {
   int best_level = -1;
   double best_score = -1;
 
-  for (int level = 0; level < config::kNumLevels - 1; level++) {
+  ComputeLevelTargets(v);
+  if (options_->compaction_style == kCompactionStyleUniversal) {
+    // Each level-0 file is a sorted run that reads must consult, so bound
+    // the number of runs.  Data that leveled compaction pushed to higher
+    // levels before the style was switched is left alone.
+    v->compaction_level_ = 0;
+    v->compaction_score_ =
+        v->files_[0].size() /
+        static_cast<double>(options_->level0_file_num_compaction_trigger);
+    v->pending_compaction_bytes_ = EstimatePendingCompactionBytes(v);
+    return;
+  }
+
+  for (int level = 0; level < NumLevels() - 1; level++) {
     double score;
     if (level == 0) {
       // We treat level-0 specially by bounding the number of files
@@ -1048,12 +1156,11 @@ void VersionSet::Finalize(Version* v) {
       // setting, or very high compression ratios, or lots of
       // overwrites/deletions).
       score = v->files_[level].size() /
-              static_cast<double>(config::kL0_CompactionTrigger);
+              static_cast<double>(options_->level0_file_num_compaction_trigger);
     } else {
       // Compute the ratio of current size to size limit.
       const uint64_t level_bytes = TotalFileSize(v->files_[level]);
-      score =
-          static_cast<double>(level_bytes) / MaxBytesForLevel(options_, level);
+      score = static_cast<double>(level_bytes) / v->max_bytes_for_level_[level];
     }
 
     if (score > best_score) {
@@ -1064,6 +1171,148 @@ void VersionSet::Finalize(Version* v) {
 
   v->compaction_level_ = best_level;
   v->compaction_score_ = best_score;
+  v->pending_compaction_bytes_ = EstimatePendingCompactionBytes(v);
+
+  if (options_->deletion_compaction_ratio > 0) {
+    double best_ratio = options_->deletion_compaction_ratio;
+    for (int level = 0; level < NumLevels() - 1; level++) {
+      for (FileMetaData* f : v->files_[level]) {
+        if (f->num_entries < config::kMinEntriesForDeletionRatio) {
+          continue;
+        }
+        const double ratio =
+            static_cast<double>(f->num_deletions) / f->num_entries;
+        if (ratio >= best_ratio) {
+          v->deletion_compaction_file_ = f;
+          v->deletion_compaction_level_ = level;
+          best_ratio = ratio;
+        }
+      }
+    }
+  }
+
+  if (options_->periodic_compaction_seconds > 0) {
+    for (int level = 0; level < NumLevels() - 1; level++) {
+      for (FileMetaData* f : v->files_[level]) {
+        if (f->creation_time > 0 &&
+            (v->periodic_compaction_file_ == nullptr ||
+             f->creation_time < v->periodic_compaction_file_->creation_time)) {
+          v->periodic_compaction_file_ = f;
+          v->periodic_compaction_level_ = level;
+        }
+      }
+    }
+  }
+}
+
+bool VersionSet::PeriodicCompactionDue() const {
+  const FileMetaData* f = current_->periodic_compaction_file_;
+  if (f == nullptr) {
+    return false;
+  }
+  const uint64_t now = env_->NowMicros() / 1000000;
+  return now >= f->creation_time &&
+         now - f->creation_time >= options_->periodic_compaction_seconds;
+}
+
+void VersionSet::ComputeLevelTargets(Version* v) const {
+  for (int level = 0; level < NumLevels(); level++) {
+    v->max_bytes_for_level_[level] = MaxBytesForLevel(options_, level);
+  }
+  v->base_level_ = 1;
+  if (!options_->level_compaction_dynamic_level_bytes) {
+    return;
+  }
+  const double base_bytes = options_->max_bytes_for_level_base;
+  const double multiplier = options_->max_bytes_for_level_multiplier;
+
+  int first_non_empty_level = -1;
+  uint64_t max_level_bytes = 0;
+  for (int level = 1; level < NumLevels(); level++) {
+    const uint64_t level_bytes = TotalFileSize(v->files_[level]);
+    if (level_bytes > 0 && first_non_empty_level == -1) {
+      first_non_empty_level = level;
+    }
+    max_level_bytes = std::max(max_level_bytes, level_bytes);
+  }
+
+  double base_level_bytes;
+  if (first_non_empty_level == -1) {
+    // Level-0 is compacted straight into the last level.
+    v->base_level_ = NumLevels() - 1;
+    base_level_bytes = base_bytes;
+  } else {
+    // Target of the first non-empty level if the last level is on target.
+    double bytes = max_level_bytes;
+    for (int level = NumLevels() - 1; level > first_non_empty_level; level--) {
+      bytes /= multiplier;
+    }
+    // Data is never moved up, so levels above the first non-empty one can
+    // only start to be used once their target reaches base_bytes.
+    v->base_level_ = first_non_empty_level;
+    while (v->base_level_ > 1 && bytes > base_bytes) {
+      v->base_level_--;
+      bytes /= multiplier;
+    }
+    // If even level-1 would be too large, the last level grows beyond its
+    // target instead.
+    base_level_bytes = std::min(bytes, base_bytes);
+  }
+
+  double bytes = base_level_bytes;
+  for (int level = v->base_level_; level < NumLevels(); level++) {
+    if (level > v->base_level_) {
+      bytes *= multiplier;
+    }
+    // Keep targets of at least base_bytes so that the deeper levels
+    // are not favoured over level-0 while the database is small.
+    v->max_bytes_for_level_[level] = std::max(bytes, base_bytes);
+  }
+}
+
+uint64_t VersionSet::EstimatePendingCompactionBytes(Version* v) const {
+  if (options_->compaction_style == kCompactionStyleUniversal) {
+    // Merging the runs down to one rewrites all but the oldest at least
+    // once more.
+    const std::vector<FileMetaData*>& runs = v->files_[0];
+    if (static_cast<int>(runs.size()) <
+        options_->level0_file_num_compaction_trigger) {
+      return 0;
+    }
+    const FileMetaData* oldest = runs[0];
+    for (size_t i = 1; i < runs.size(); i++) {
+      if (runs[i]->number < oldest->number) {
+        oldest = runs[i];
+      }
+    }
+    return TotalFileSize(runs) - oldest->file_size;
+  }
+
+  // Level-0 files are compacted as a whole once there are enough of them.
+  uint64_t pending = 0;
+  uint64_t bytes_into_level = 0;
+  if (static_cast<int>(v->files_[0].size()) >=
+      options_->level0_file_num_compaction_trigger) {
+    bytes_into_level = TotalFileSize(v->files_[0]);
+    pending += bytes_into_level;
+  }
+
+  // Every other level must push its excess over the target size down to
+  // the next level, which rewrites the overlapping part of that level too.
+  for (int level = v->base_level_; level < NumLevels() - 1; level++) {
+    const uint64_t level_bytes =
+        TotalFileSize(v->files_[level]) + bytes_into_level;
+    const double target = v->max_bytes_for_level_[level];
+    if (level_bytes > target) {
+      bytes_into_level = level_bytes - static_cast<uint64_t>(target);
+      const double next_level_bytes = TotalFileSize(v->files_[level + 1]);
+      pending += static_cast<uint64_t>(
+          bytes_into_level * (next_level_bytes / level_bytes + 1));
+    } else {
+      bytes_into_level = 0;
+    }
+  }
+  return pending;
 }
 
 Status VersionSet::WriteSnapshot(log::Writer* log) {
@@ -1072,9 +1321,10 @@ Status VersionSet::WriteSnapshot(log::Writer* log) {
   // Save metadata
   VersionEdit edit;
   edit.SetComparatorName(icmp_.user_comparator()->Name());
+  edit.SetNumLevels(NumLevels());
 
   // Save compaction pointers
-  for (int level = 0; level < config::kNumLevels; level++) {
+  for (int level = 0; level < config::kMaxNumLevels; level++) {
     if (!compact_pointer_[level].empty()) {
       InternalKey key;
       key.DecodeFrom(compact_pointer_[level]);
@@ -1083,11 +1333,11 @@ Status VersionSet::WriteSnapshot(log::Writer* log) {
   }
 
   // Save files
-  for (int level = 0; level < config::kNumLevels; level++) {
+  for (int level = 0; level < config::kMaxNumLevels; level++) {
     const std::vector<FileMetaData*>& files = current_->files_[level];
     for (size_t i = 0; i < files.size(); i++) {
       const FileMetaData* f = files[i];
-      edit.AddFile(level, f->number, f->file_size, f->smallest, f->largest);
+      edit.AddFile(level, *f);
     }
   }
 
@@ -1098,25 +1348,27 @@ Status VersionSet::WriteSnapshot(log::Writer* log) {
 
 int VersionSet::NumLevelFiles(int level) const {
   assert(level >= 0);
-  assert(level < config::kNumLevels);
+  assert(level < NumLevels());
   return current_->files_[level].size();
 }
 
 const char* VersionSet::LevelSummary(LevelSummaryStorage* scratch) const {
-  // Update code if kNumLevels changes
-  static_assert(config::kNumLevels == 7, "");
-  std::snprintf(
-      scratch->buffer, sizeof(scratch->buffer), "files[ %d %d %d %d %d %d %d ]",
-      int(current_->files_[0].size()), int(current_->files_[1].size()),
-      int(current_->files_[2].size()), int(current_->files_[3].size()),
-      int(current_->files_[4].size()), int(current_->files_[5].size()),
-      int(current_->files_[6].size()));
+  char* p = scratch->buffer;
+  char* const limit = scratch->buffer + sizeof(scratch->buffer);
+  p += std::snprintf(p, limit - p, "files[");
+  for (int level = 0; level < NumLevels() && p < limit; level++) {
+    p += std::snprintf(p, limit - p, " %d",
+                       int(current_->files_[level].size()));
+  }
+  if (p < limit) {
+    std::snprintf(p, limit - p, " ]");
+  }
   return scratch->buffer;
 }
 
 uint64_t VersionSet::ApproximateOffsetOf(Version* v, const InternalKey& ikey) {
   uint64_t result = 0;
-  for (int level = 0; level < config::kNumLevels; level++) {
+  for (int level = 0; level < NumLevels(); level++) {
     const std::vector<FileMetaData*>& files = v->files_[level];
     for (size_t i = 0; i < files.size(); i++) {
       if (icmp_.Compare(files[i]->largest, ikey) <= 0) {
@@ -1149,7 +1401,7 @@ uint64_t VersionSet::ApproximateOffsetOf(Version* v, const InternalKey& ikey) {
 void VersionSet::AddLiveFiles(std::set<uint64_t>* live) {
   for (Version* v = dummy_versions_.next_; v != &dummy_versions_;
        v = v->next_) {
-    for (int level = 0; level < config::kNumLevels; level++) {
+    for (int level = 0; level < config::kMaxNumLevels; level++) {
       const std::vector<FileMetaData*>& files = v->files_[level];
       for (size_t i = 0; i < files.size(); i++) {
         live->insert(files[i]->number);
@@ -1160,14 +1412,14 @@ void VersionSet::AddLiveFiles(std::set<uint64_t>* live) {
 
 int64_t VersionSet::NumLevelBytes(int level) const {
   assert(level >= 0);
-  assert(level < config::kNumLevels);
+  assert(level < NumLevels());
   return TotalFileSize(current_->files_[level]);
 }
 
 int64_t VersionSet::MaxNextLevelOverlappingBytes() {
   int64_t result = 0;
   std::vector<FileMetaData*> overlaps;
-  for (int level = 1; level < config::kNumLevels - 1; level++) {
+  for (int level = 1; level < NumLevels() - 1; level++) {
     for (size_t i = 0; i < current_->files_[level].size(); i++) {
       const FileMetaData* f = current_->files_[level][i];
       current_->GetOverlappingInputs(level + 1, &f->smallest, &f->largest,
@@ -1220,6 +1472,7 @@ Iterator* VersionSet::MakeInputIterator(Compaction* c) {
   ReadOptions options;
   options.verify_checksums = options_->paranoid_checks;
   options.fill_cache = false;
+  options.readahead_size = options_->compaction_readahead_size;
 
   // Level-0 files have to be merged together.  For other levels,
   // we will make a concatenating iterator per level.
@@ -1250,17 +1503,29 @@ Iterator* VersionSet::MakeInputIterator(Compaction* c) {
 }
 
 Compaction* VersionSet::PickCompaction() {
+  if (options_->compaction_style == kCompactionStyleUniversal) {
+    if (current_->compaction_score_ < 1) {
+      return nullptr;
+    }
+    return PickUniversalCompaction(false);
+  }
+
   Compaction* c;
   int level;
 
   // We prefer compactions triggered by too much data in a level over
-  // the compactions triggered by seeks.
+  // the compactions triggered by seeks, those over the compactions
+  // triggered by deletion markers, and those over the compactions of old
+  // files.
   const bool size_compaction = (current_->compaction_score_ >= 1);
   const bool seek_compaction = (current_->file_to_compact_ != nullptr);
+  const bool deletion_compaction =
+      (current_->deletion_compaction_file_ != nullptr);
+  const bool periodic_compaction = PeriodicCompactionDue();
   if (size_compaction) {
     level = current_->compaction_level_;
     assert(level >= 0);
-    assert(level + 1 < config::kNumLevels);
+    assert(level + 1 < NumLevels());
     c = new Compaction(options_, level);
 
     // Pick the first file that comes after compact_pointer_[level]
@@ -1280,6 +1545,18 @@ Compaction* VersionSet::PickCompaction() {
     level = current_->file_to_compact_level_;
     c = new Compaction(options_, level);
     c->inputs_[0].push_back(current_->file_to_compact_);
+  } else if (deletion_compaction) {
+    level = current_->deletion_compaction_level_;
+    c = new Compaction(options_, level);
+    c->inputs_[0].push_back(current_->deletion_compaction_file_);
+    // Moving the file down as it is would keep its deletion markers.
+    c->allow_trivial_move_ = false;
+  } else if (periodic_compaction) {
+    level = current_->periodic_compaction_level_;
+    c = new Compaction(options_, level);
+    c->inputs_[0].push_back(current_->periodic_compaction_file_);
+    // Moving the file down as it is would keep its age and its stale data.
+    c->allow_trivial_move_ = false;
   } else {
     return nullptr;
   }
@@ -1303,6 +1580,65 @@ Compaction* VersionSet::PickCompaction() {
   return c;
 }
 
+Compaction* VersionSet::PickUniversalCompaction(bool full) {
+  // Sorted runs from newest to oldest.  A merge always starts at the
+  // newest run: its output then holds the newest data of the DB, so that
+  // its new file number keeps ordering runs by age.
+  std::vector<FileMetaData*> runs = current_->files_[0];
+  if (runs.empty()) {
+    return nullptr;
+  }
+  std::sort(runs.begin(), runs.end(), NewestFirst);
+  const size_t n = runs.size();
+  const size_t min_width = options_->universal_min_merge_width;
+  const size_t max_width = options_->universal_max_merge_width;
+
+  size_t width = 0;
+  if (full) {
+    width = n;
+  } else if (n >= 2) {
+    // Bound space amplification: the newer runs may hold stale versions
+    // of most of the oldest run.
+    const uint64_t oldest_bytes = runs[n - 1]->file_size;
+    const uint64_t newer_bytes = TotalFileSize(runs) - oldest_bytes;
+    if (newer_bytes * 100 >=
+        oldest_bytes * options_->universal_max_size_amplification_percent) {
+      width = n;
+    }
+  }
+  if (width == 0) {
+    // Add older runs while each is not much larger than the runs picked
+    // so far together, so that every merge at least about doubles the
+    // size of the data it rewrites.
+    uint64_t picked_bytes = runs[0]->file_size;
+    width = 1;
+    while (width < n && width < max_width &&
+           runs[width]->file_size * 100 <=
+               picked_bytes * (100 + options_->universal_size_ratio)) {
+      picked_bytes += runs[width]->file_size;
+      width++;
+    }
+    if (width < min_width) {
+      // No runs of similar size, yet too many runs: merge just enough
+      // of the newest to get back under the trigger.
+      width = n - options_->level0_file_num_compaction_trigger + 2;
+      width = std::min(std::max(width, min_width), std::min(n, max_width));
+    }
+  }
+  if (width < 2 && !full) {
+    return nullptr;
+  }
+
+  Compaction* c = new Compaction(options_, 0);
+  c->output_level_ = 0;
+  c->max_output_file_size_ = std::numeric_limits<uint64_t>::max();
+  c->includes_oldest_run_ = (width == n);
+  c->inputs_[0].assign(runs.begin(), runs.begin() + width);
+  c->input_version_ = current_;
+  c->input_version_->Ref();
+  return c;
+}
+
 // Finds the largest key in a vector of files. Returns true if files is not
 // empty.
 bool FindLargestKey(const InternalKeyComparator& icmp,
@@ -1384,21 +1720,25 @@ void AddBoundaryInputs(const InternalKeyComparator& icmp,
 
 void VersionSet::SetupOtherInputs(Compaction* c) {
   const int level = c->level();
+  if (level == 0) {
+    c->output_level_ = current_->base_level_;
+  }
+  const int output_level = c->output_level_;
   InternalKey smallest, largest;
 
   AddBoundaryInputs(icmp_, current_->files_[level], &c->inputs_[0]);
   GetRange(c->inputs_[0], &smallest, &largest);
 
-  current_->GetOverlappingInputs(level + 1, &smallest, &largest,
+  current_->GetOverlappingInputs(output_level, &smallest, &largest,
                                  &c->inputs_[1]);
-  AddBoundaryInputs(icmp_, current_->files_[level + 1], &c->inputs_[1]);
+  AddBoundaryInputs(icmp_, current_->files_[output_level], &c->inputs_[1]);
 
   // Get entire range covered by compaction
   InternalKey all_start, all_limit;
   GetRange2(c->inputs_[0], c->inputs_[1], &all_start, &all_limit);
 
   // See if we can grow the number of inputs in "level" without
-  // changing the number of "level+1" files we pick up.
+  // changing the number of "output_level" files we pick up.
   if (!c->inputs_[1].empty()) {
     std::vector<FileMetaData*> expanded0;
     current_->GetOverlappingInputs(level, &all_start, &all_limit, &expanded0);
@@ -1412,9 +1752,9 @@ void VersionSet::SetupOtherInputs(Compaction* c) {
       InternalKey new_start, new_limit;
       GetRange(expanded0, &new_start, &new_limit);
       std::vector<FileMetaData*> expanded1;
-      current_->GetOverlappingInputs(level + 1, &new_start, &new_limit,
+      current_->GetOverlappingInputs(output_level, &new_start, &new_limit,
                                      &expanded1);
-      AddBoundaryInputs(icmp_, current_->files_[level + 1], &expanded1);
+      AddBoundaryInputs(icmp_, current_->files_[output_level], &expanded1);
       if (expanded1.size() == c->inputs_[1].size()) {
         Log(options_->info_log,
             "Expanding@%d %d+%d (%ld+%ld bytes) to %d+%d (%ld+%ld bytes)\n",
@@ -1431,9 +1771,9 @@ void VersionSet::SetupOtherInputs(Compaction* c) {
   }
 
   // Compute the set of grandparent files that overlap this compaction
-  // (parent == level+1; grandparent == level+2)
-  if (level + 2 < config::kNumLevels) {
-    current_->GetOverlappingInputs(level + 2, &all_start, &all_limit,
+  // (parent == output_level; grandparent == output_level+1)
+  if (output_level + 1 < NumLevels()) {
+    current_->GetOverlappingInputs(output_level + 1, &all_start, &all_limit,
                                    &c->grandparents_);
   }
 
@@ -1452,6 +1792,10 @@ Compaction* VersionSet::CompactRange(int level, const InternalKey* begin,
   if (inputs.empty()) {
     return nullptr;
   }
+  if (level == 0 && options_->compaction_style == kCompactionStyleUniversal) {
+    // Sorted runs cannot be merged by key range, so merge all of them.
+    return PickUniversalCompaction(true);
+  }
 
   // Avoid compacting too much in one shot in case the range is large.
   // But we cannot do this for level-0 since level-0 files can overlap
@@ -1480,12 +1824,15 @@ Compaction* VersionSet::CompactRange(int level, const InternalKey* begin,
 
 Compaction::Compaction(const Options* options, int level)
     : level_(level),
+      output_level_(level + 1),
       max_output_file_size_(MaxFileSizeForLevel(options, level)),
       input_version_(nullptr),
       grandparent_index_(0),
       seen_key_(false),
-      overlapped_bytes_(0) {
-  for (int i = 0; i < config::kNumLevels; i++) {
+      overlapped_bytes_(0),
+      includes_oldest_run_(true),
+      allow_trivial_move_(true) {
+  for (int i = 0; i < config::kMaxNumLevels; i++) {
     level_ptrs_[i] = 0;
   }
 }
@@ -1501,7 +1848,8 @@ bool Compaction::IsTrivialMove() const {
   // Avoid a move if there is lots of overlapping grandparent data.
   // Otherwise, the move could create a parent file that will require
   // a very expensive merge later on.
-  return (num_input_files(0) == 1 && num_input_files(1) == 0 &&
+  return (allow_trivial_move_ && output_level_ > level_ &&
+          num_input_files(0) == 1 && num_input_files(1) == 0 &&
           TotalFileSize(grandparents_) <=
               MaxGrandParentOverlapBytes(vset->options_));
 }
@@ -1509,15 +1857,20 @@ bool Compaction::IsTrivialMove() const {
 void Compaction::AddInputDeletions(VersionEdit* edit) {
   for (int which = 0; which < 2; which++) {
     for (size_t i = 0; i < inputs_[which].size(); i++) {
-      edit->RemoveFile(level_ + which, inputs_[which][i]->number);
+      edit->RemoveFile(which == 0 ? level_ : output_level_,
+                       inputs_[which][i]->number);
     }
   }
 }
 
 bool Compaction::IsBaseLevelForKey(const Slice& user_key) {
   // Maybe use binary search to find right entry instead of linear search?
+  if (!includes_oldest_run_) {
+    return false;
+  }
   const Comparator* user_cmp = input_version_->vset_->icmp_.user_comparator();
-  for (int lvl = level_ + 2; lvl < config::kNumLevels; lvl++) {
+  const int num_levels = input_version_->vset_->NumLevels();
+  for (int lvl = output_level_ + 1; lvl < num_levels; lvl++) {
     const std::vector<FileMetaData*>& files = input_version_->files_[lvl];
     while (level_ptrs_[lvl] < files.size()) {
       FileMetaData* f = files[level_ptrs_[lvl]];
@@ -1535,6 +1888,19 @@ bool Compaction::IsBaseLevelForKey(const Slice& user_key) {
   return true;
 }
 
+bool Compaction::IsBaseLevelForRange(const Slice& begin, const Slice& end) {
+  if (!includes_oldest_run_) {
+    return false;
+  }
+  const int num_levels = input_version_->vset_->NumLevels();
+  for (int lvl = output_level_ + 1; lvl < num_levels; lvl++) {
+    if (input_version_->OverlapInLevel(lvl, &begin, &end)) {
+      return false;
+    }
+  }
+  return true;
+}
+
 bool Compaction::ShouldStopBefore(const Slice& internal_key) {
   const VersionSet* vset = input_version_->vset_;
   // Scan to find earliest grandparent file that contains key.
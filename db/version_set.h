@@ -31,6 +31,7 @@ class Writer;
 }
 
 class Compaction;
+class RangeTombstoneList;
 class Iterator;
 class MemTable;
 class TableBuilder;
@@ -71,9 +72,18 @@ class Version {
 
   // Lookup the value for key.  If found, store it in *val and
   // return OK.  Else return a non-OK status.  Fills *stats.
+  // Merge operands newer than the value or deletion found are appended
+  // to *merge_operands, newest first.
+  // Entries with sequence numbers below "covering_tombstone", the
+  // sequence number of a newer range tombstone covering key, are
+  // treated as deleted.
   // REQUIRES: lock is not held
   Status Get(const ReadOptions&, const LookupKey& key, std::string* val,
-             GetStats* stats);
+             GetStats* stats, std::vector<std::string>* merge_operands,
+             SequenceNumber covering_tombstone = 0);
+
+  // Add the range tombstones of every file in this version to *list.
+  Status AddRangeTombstones(RangeTombstoneList* list);
 
   // Adds "stats" into the current state.  Returns true if a new
   // compaction may need to be triggered, false otherwise.
@@ -109,8 +119,18 @@ class Version {
   int PickLevelForMemTableOutput(const Slice& smallest_user_key,
                                  const Slice& largest_user_key);
 
+  // Return the deepest level at which a table of data newer than any in
+  // this version can be placed: nothing in that level or above it may
+  // overlap [smallest_user_key,largest_user_key].
+  int PickLevelForIngestedFile(const Slice& smallest_user_key,
+                               const Slice& largest_user_key);
+
   int NumFiles(int level) const { return files_[level].size(); }
 
+  // Estimated number of bytes compactions must rewrite to bring every
+  // level back under its size target.
+  uint64_t PendingCompactionBytes() const { return pending_compaction_bytes_; }
+
   // Return a human readable string that describes this version's contents.
   std::string DebugString() const;
 
@@ -127,8 +147,14 @@ class Version {
         refs_(0),
         file_to_compact_(nullptr),
         file_to_compact_level_(-1),
+        deletion_compaction_file_(nullptr),
+        deletion_compaction_level_(-1),
+        periodic_compaction_file_(nullptr),
+        periodic_compaction_level_(-1),
         compaction_score_(-1),
-        compaction_level_(-1) {}
+        compaction_level_(-1),
+        base_level_(1),
+        pending_compaction_bytes_(0) {}
 
   Version(const Version&) = delete;
   Version& operator=(const Version&) = delete;
@@ -151,17 +177,36 @@ class Version {
   int refs_;          // Number of live refs to this version
 
   // List of files per level
-  std::vector<FileMetaData*> files_[config::kNumLevels];
+  std::vector<FileMetaData*> files_[config::kMaxNumLevels];
 
   // Next file to compact based on seek stats.
   FileMetaData* file_to_compact_;
   int file_to_compact_level_;
 
+  // File with the largest fraction of deletion markers above
+  // Options::deletion_compaction_ratio, or null.  Computed by Finalize().
+  FileMetaData* deletion_compaction_file_;
+  int deletion_compaction_level_;
+
+  // Oldest file subject to Options::periodic_compaction_seconds, or null.
+  // Computed by Finalize(); whether it is due depends on the time.
+  FileMetaData* periodic_compaction_file_;
+  int periodic_compaction_level_;
+
   // Level that should be compacted next and its compaction score.
   // Score < 1 means compaction is not strictly needed.  These fields
   // are initialized by Finalize().
   double compaction_score_;
   int compaction_level_;
+
+  // Level that level-0 is compacted into and the size targets of it and
+  // of the levels below it, computed by Finalize().  Levels between
+  // level-0 and base_level_ are empty.
+  int base_level_;
+  double max_bytes_for_level_[config::kMaxNumLevels];
+
+  // Computed by Finalize(), used to slow down writes.
+  uint64_t pending_compaction_bytes_;
 };
 
 class VersionSet {
@@ -202,12 +247,20 @@ class VersionSet {
     }
   }
 
+  // Return the number of levels (see Options::num_levels).
+  int NumLevels() const { return options_->num_levels; }
+
   // Return the number of Table files at the specified level.
   int NumLevelFiles(int level) const;
 
   // Return the combined file size of all files at the specified level.
   int64_t NumLevelBytes(int level) const;
 
+  // Return the compaction backlog of the current version, in bytes.
+  uint64_t EstimatedPendingCompactionBytes() const {
+    return current_->pending_compaction_bytes_;
+  }
+
   // Return the last sequence number.
   uint64_t LastSequence() const { return last_sequence_; }
 
@@ -227,6 +280,11 @@ class VersionSet {
   // being compacted, or zero if there is no such log file.
   uint64_t PrevLogNumber() const { return prev_log_number_; }
 
+  // Recompute the compaction score of the current version, after the
+  // options it depends on were changed.
+  // REQUIRES: lock is held
+  void UpdateCompactionScore() { Finalize(current_); }
+
   // Pick level and inputs for a new compaction.
   // Returns nullptr if there is no compaction to be done.
   // Otherwise returns a pointer to a heap-allocated object that
@@ -251,7 +309,9 @@ class VersionSet {
   // Returns true iff some level needs a compaction.
   bool NeedsCompaction() const {
     Version* v = current_;
-    return (v->compaction_score_ >= 1) || (v->file_to_compact_ != nullptr);
+    return (v->compaction_score_ >= 1) || (v->file_to_compact_ != nullptr) ||
+           (v->deletion_compaction_file_ != nullptr) ||
+           PeriodicCompactionDue();
   }
 
   // Add all files listed in any live version to *live.
@@ -279,6 +339,19 @@ class VersionSet {
 
   void Finalize(Version* v);
 
+  // Returns true iff the periodic compaction file of the current version
+  // is older than Options::periodic_compaction_seconds.
+  bool PeriodicCompactionDue() const;
+
+  // Set v->base_level_ and v->max_bytes_for_level_.
+  void ComputeLevelTargets(Version* v) const;
+
+  uint64_t EstimatePendingCompactionBytes(Version* v) const;
+
+  // Pick the level-0 sorted runs to merge with universal compaction, or
+  // all of them if "full".  Returns nullptr if no merge is needed.
+  Compaction* PickUniversalCompaction(bool full);
+
   void GetRange(const std::vector<FileMetaData*>& inputs, InternalKey* smallest,
                 InternalKey* largest);
 
@@ -312,7 +385,7 @@ class VersionSet {
 
   // Per-level key at which the next compaction at that level should start.
   // Either an empty string, or a valid InternalKey.
-  std::string compact_pointer_[config::kNumLevels];
+  std::string compact_pointer_[config::kMaxNumLevels];
 };
 
 // A Compaction encapsulates information about a compaction.
@@ -321,9 +394,16 @@ class Compaction {
   ~Compaction();
 
   // Return the level that is being compacted.  Inputs from "level"
-  // and "level+1" will be merged to produce a set of "level+1" files.
+  // and "output_level" will be merged to produce a set of "output_level"
+  // files.
   int level() const { return level_; }
 
+  // Return the level the outputs are added to: usually "level+1", but
+  // level-0 may be compacted into a deeper level (see
+  // Options::level_compaction_dynamic_level_bytes), and a universal
+  // compaction merges level-0 sorted runs only.
+  int output_level() const { return output_level_; }
+
   // Return the object that holds the edits to the descriptor done
   // by this compaction.
   VersionEdit* edit() { return &edit_; }
@@ -331,24 +411,31 @@ class Compaction {
   // "which" must be either 0 or 1
   int num_input_files(int which) const { return inputs_[which].size(); }
 
-  // Return the ith input file at "level()+which" ("which" must be 0 or 1).
+  // Return the ith input file at "level()" if "which" is 0, else at
+  // "output_level()".
   FileMetaData* input(int which, int i) const { return inputs_[which][i]; }
 
   // Maximum size of files to build during this compaction.
   uint64_t MaxOutputFileSize() const { return max_output_file_size_; }
 
   // Is this a trivial compaction that can be implemented by just
-  // moving a single input file to the next level (no merging or splitting)
+  // moving a single input file to the output level (no merging or
+  // splitting)
   bool IsTrivialMove() const;
 
   // Add all inputs to this compaction as delete operations to *edit.
   void AddInputDeletions(VersionEdit* edit);
 
   // Returns true if the information we have available guarantees that
-  // the compaction is producing data in "level+1" for which no data exists
-  // in levels greater than "level+1".
+  // the compaction is producing data in "output_level" for which no data
+  // exists in older files.
   bool IsBaseLevelForKey(const Slice& user_key);
 
+  // Returns true if no file older than the inputs overlaps
+  // [begin, end].  Unlike IsBaseLevelForKey() it may be called with
+  // ranges in any order.
+  bool IsBaseLevelForRange(const Slice& begin, const Slice& end);
+
   // Returns true iff we should stop building the current output
   // before processing "internal_key".
   bool ShouldStopBefore(const Slice& internal_key);
@@ -364,28 +451,37 @@ class Compaction {
   Compaction(const Options* options, int level);
 
   int level_;
+  int output_level_;
   uint64_t max_output_file_size_;
   Version* input_version_;
   VersionEdit edit_;
 
-  // Each compaction reads inputs from "level_" and "level_+1"
+  // Each compaction reads inputs from "level_" and "output_level_"
   std::vector<FileMetaData*> inputs_[2];  // The two sets of inputs
 
   // State used to check for number of overlapping grandparent files
-  // (parent == level_ + 1, grandparent == level_ + 2)
+  // (parent == output_level_, grandparent == output_level_ + 1)
   std::vector<FileMetaData*> grandparents_;
   size_t grandparent_index_;  // Index in grandparent_starts_
   bool seen_key_;             // Some output key has been seen
   int64_t overlapped_bytes_;  // Bytes of overlap between current output
                               // and grandparent files
 
+  // False if level-0 holds files older than the inputs of this universal
+  // compaction, which may hide entries the compaction would otherwise drop.
+  bool includes_oldest_run_;
+
+  // False if the inputs must be rewritten even when they could be moved
+  // to the output level as they are.
+  bool allow_trivial_move_;
+
   // State for implementing IsBaseLevelForKey
 
   // level_ptrs_ holds indices into input_version_->levels_: our state
   // is that we are positioned at one of the file ranges for each
   // higher level than the ones involved in this compaction (i.e. for
-  // all L >= level_ + 2).
-  size_t level_ptrs_[config::kNumLevels];
+  // all L > output_level_).
+  size_t level_ptrs_[config::kMaxNumLevels];
 };
 
 }  // namespace leveldb
@@ -35,7 +35,10 @@ class WriteBatchInternal {
 
   static void SetContents(WriteBatch* batch, const Slice& contents);
 
-  static Status InsertInto(const WriteBatch* batch, MemTable* memtable);
+  // If "inplace_update" is true, Puts overwrite existing values in place
+  // where MemTable::Update() allows it.
+  static Status InsertInto(const WriteBatch* batch, MemTable* memtable,
+                           bool inplace_update = false);
 
   static void Append(WriteBatch* dst, const WriteBatch* src);
 };
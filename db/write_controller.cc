@@ -0,0 +1,62 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "db/write_controller.h"
+
+#include <algorithm>
+
+namespace leveldb {
+
+static const uint64_t kMicrosPerSecond = 1000000;
+
+// The bucket never holds more than this much time worth of tokens, so a
+// writer that was idle for a while cannot burst far above the rate.
+static const uint64_t kMaxBurstMicros = 1000;
+
+WriteController::WriteController()
+    : delayed_write_rate_(0), bytes_left_(0), last_refill_micros_(0) {}
+
+void WriteController::SetDelayedWriteRate(uint64_t bytes_per_second) {
+  if (bytes_per_second != 0 && delayed_write_rate_ == 0) {
+    // Start from an empty bucket whenever throttling begins.
+    bytes_left_ = 0;
+    last_refill_micros_ = 0;
+  }
+  delayed_write_rate_ = bytes_per_second;
+}
+
+uint64_t WriteController::GetDelay(uint64_t now_micros, uint64_t num_bytes) {
+  if (delayed_write_rate_ == 0) {
+    return 0;
+  }
+
+  const uint64_t max_bytes =
+      std::max<uint64_t>(1, delayed_write_rate_ * kMaxBurstMicros /
+                                kMicrosPerSecond);
+  if (last_refill_micros_ != 0 && now_micros > last_refill_micros_) {
+    const uint64_t elapsed =
+        std::min(now_micros - last_refill_micros_, kMicrosPerSecond);
+    bytes_left_ = std::min(
+        max_bytes,
+        bytes_left_ + elapsed * delayed_write_rate_ / kMicrosPerSecond);
+  }
+  if (last_refill_micros_ < now_micros) {
+    last_refill_micros_ = now_micros;
+  }
+
+  if (num_bytes <= bytes_left_) {
+    bytes_left_ -= num_bytes;
+    return 0;
+  }
+
+  // Wait until the missing tokens have been refilled.  Those tokens are
+  // consumed by this write, so credit starts again after the wait.
+  const uint64_t needed = num_bytes - bytes_left_;
+  bytes_left_ = 0;
+  const uint64_t delay = needed * kMicrosPerSecond / delayed_write_rate_;
+  last_refill_micros_ += delay;
+  return last_refill_micros_ - now_micros;
+}
+
+}  // namespace leveldb
@@ -0,0 +1,48 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// WriteController paces foreground writes while compactions are falling
+// behind.  Instead of sleeping for a fixed period per write, writers draw
+// from a token bucket that is refilled at a target rate; the rate is
+// chosen by the DB from the amount of outstanding compaction work.
+
+#ifndef STORAGE_LEVELDB_DB_WRITE_CONTROLLER_H_
+#define STORAGE_LEVELDB_DB_WRITE_CONTROLLER_H_
+
+#include <cstdint>
+
+namespace leveldb {
+
+// Write rates (in bytes per second) are never throttled below this.
+static const uint64_t kMinDelayedWriteRate = 16 * 1024;
+
+class WriteController {
+ public:
+  WriteController();
+
+  WriteController(const WriteController&) = delete;
+  WriteController& operator=(const WriteController&) = delete;
+
+  // Set the rate at which the token bucket is refilled.  Zero disables
+  // throttling.
+  void SetDelayedWriteRate(uint64_t bytes_per_second);
+  uint64_t delayed_write_rate() const { return delayed_write_rate_; }
+
+  // Return the number of microseconds the caller should wait before
+  // writing "num_bytes" so that writes do not exceed the current rate.
+  // The caller is expected to wait for the returned time; the tokens
+  // refilled during that wait are already accounted for.
+  //
+  // REQUIRES: External synchronization.
+  uint64_t GetDelay(uint64_t now_micros, uint64_t num_bytes);
+
+ private:
+  uint64_t delayed_write_rate_;  // Bytes per second, 0 if not throttled
+  uint64_t bytes_left_;          // Tokens currently in the bucket
+  uint64_t last_refill_micros_;  // Time up to which tokens were credited
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_WRITE_CONTROLLER_H_
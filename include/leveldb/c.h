@@ -281,6 +281,8 @@ LEVELDB_EXPORT leveldb_writeoptions_t *leveldb_writeoptions_create(void);
 LEVELDB_EXPORT void leveldb_writeoptions_destroy(leveldb_writeoptions_t *);
 LEVELDB_EXPORT void
 leveldb_writeoptions_set_sync(leveldb_writeoptions_t *, uint8_t);
+LEVELDB_EXPORT void
+leveldb_writeoptions_set_disable_wal(leveldb_writeoptions_t *, uint8_t);
 
 /* Cache */
 
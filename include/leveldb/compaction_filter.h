@@ -0,0 +1,44 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A CompactionFilter lets an application drop or rewrite entries while
+// they are being compacted, e.g. to expire entries past a TTL or to strip
+// obsolete fields, without paying for a separate scan-and-delete pass.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_COMPACTION_FILTER_H_
+#define STORAGE_LEVELDB_INCLUDE_COMPACTION_FILTER_H_
+
+#include <string>
+
+#include "leveldb/export.h"
+
+namespace leveldb {
+
+class Slice;
+
+class LEVELDB_EXPORT CompactionFilter {
+ public:
+  virtual ~CompactionFilter();
+
+  // Called for the newest value of "key" found by a compaction out of
+  // "level", provided no live snapshot can observe that value.  Older
+  // values, values still visible to a snapshot, and deletions are never
+  // passed in.  Memtable flushes do not invoke the filter.
+  //
+  // Return true to remove the entry; reads then behave as if the key had
+  // been deleted.  Otherwise, to replace the value, store the new value
+  // in *new_value and set *value_changed to true.
+  //
+  // Called from the background compaction thread, possibly concurrently
+  // with other methods of the DB, so it must be thread-safe.
+  virtual bool Filter(int level, const Slice& key, const Slice& existing_value,
+                      std::string* new_value, bool* value_changed) const = 0;
+
+  // Return the name of this filter.
+  virtual const char* Name() const = 0;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_COMPACTION_FILTER_H_
@@ -7,10 +7,14 @@
 
 #include <cstdint>
 #include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
 
 #include "leveldb/export.h"
 #include "leveldb/iterator.h"
 #include "leveldb/options.h"
+#include "leveldb/table_properties.h"
 
 namespace leveldb {
 
@@ -72,11 +76,41 @@ class LEVELDB_EXPORT DB {
   // Note: consider setting options.sync = true.
   virtual Status Delete(const WriteOptions& options, const Slice& key) = 0;
 
+  // Remove the database entries (if any) for the keys in [begin, end).
+  // Returns OK on success, and a non-OK status on error.  It is not an
+  // error if the range is empty.  The deletion is recorded as a single
+  // range tombstone, so it costs the same however many keys it covers.
+  // Note: consider setting options.sync = true.
+  virtual Status DeleteRange(const WriteOptions& options, const Slice& begin,
+                             const Slice& end);
+
+  // Record "value" as a merge operand for "key" without reading the key.
+  // Reads return the result of applying the operands written since the
+  // last Put() or Delete() of "key" to its value (see merge_operator.h).
+  // Requires options.merge_operator to be set.
+  // Note: consider setting options.sync = true.
+  virtual Status Merge(const WriteOptions& options, const Slice& key,
+                       const Slice& value);
+
   // Apply the specified updates to the database.
   // Returns OK on success, non-OK on failure.
   // Note: consider setting options.sync = true.
   virtual Status Write(const WriteOptions& options, WriteBatch* updates) = 0;
 
+  // Add the contents of the table files at "paths" to the database, as
+  // if all their entries had been Put() by a single write.  The files
+  // must have been built with a TableBuilder using the comparator of
+  // this database, and their key ranges must not overlap.  Each file is
+  // copied once into the database, which then places it at the deepest
+  // level where it overlaps nothing, bypassing the log, the memtable and
+  // the compactions that would move the data down.  The files at "paths"
+  // are left untouched.
+  //
+  // Writes wait while the files are ingested, and the memtable is
+  // flushed first if it is not empty.  The default implementation
+  // returns NotSupported.
+  virtual Status IngestExternalFile(const std::vector<std::string>& paths);
+
   // If the database contains an entry for "key" store the
   // corresponding value in *value and return OK.
   //
@@ -134,6 +168,12 @@ class LEVELDB_EXPORT DB {
   virtual void GetApproximateSizes(const Range* range, int n,
                                    uint64_t* sizes) = 0;
 
+  // Store in *props the statistics recorded in the table files of the
+  // current DB state (see table_properties.h), keyed by file name.
+  // Files written before such statistics were recorded are left out.
+  // The default implementation returns NotSupported.
+  virtual Status GetPropertiesOfAllTables(TablePropertiesCollection* props);
+
   // Compact the underlying storage for the key range [*begin,*end].
   // In particular, deleted and overwritten versions are discarded,
   // and the data is rearranged to reduce the cost of operations
@@ -145,6 +185,17 @@ class LEVELDB_EXPORT DB {
   // Therefore the following call will compact the entire database:
   //    db->CompactRange(nullptr, nullptr);
   virtual void CompactRange(const Slice* begin, const Slice* end) = 0;
+
+  // Change options of the open DB.  "options" maps option names to their
+  // new values, e.g. {"level0_stop_writes_trigger", "24"}.  Only options
+  // documented in options.h as changeable with SetOptions() are accepted;
+  // values are clipped like those passed to Open().
+  //
+  // Returns InvalidArgument, without changing any option, if a name is
+  // not accepted or a value cannot be parsed.  The default
+  // implementation returns NotSupported.
+  virtual Status SetOptions(
+      const std::map<std::string, std::string>& options);
 };
 
 // Destroy the contents of the specified database.
@@ -0,0 +1,163 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A MemTableRep is the in-memory index a MemTable keeps its entries in.
+// The default representation is a skiplist; Options::memtable_factory
+// selects another one:
+//
+//   skiplist       Sorted at all times.  Good all-round choice.
+//   inline skiplist
+//                  A skiplist that stores entries inside its nodes and
+//                  caches a prefix of each key, so that searches take
+//                  fewer cache misses.
+//   hash skiplist  Entries are hashed on a fixed-length prefix of their
+//                  user key into buckets that are skiplists of their own.
+//                  Point lookups only search one small bucket, but
+//                  iterating the memtable has to sort all entries first.
+//   vector         Entries are appended to an unsorted array.  Readers
+//                  share a sorted copy, into which the first read after
+//                  inserts merges the new entries.  Inserts are very
+//                  cheap, but reads interleaved with inserts are not.
+//                  Suited to bulk loads that do not read what they
+//                  write.
+//
+// A memtable entry is an encoded internal key followed by its value:
+//
+//    klength  varint32
+//    key      char[klength]    (user key followed by 8-byte tag)
+//    vlength  varint32
+//    value    char[vlength]
+//
+// Entries are allocated in the memtable's arena and are never freed.
+// Their keys never change once inserted, but with
+// Options::inplace_update_support a Put may overwrite the value of an
+// entry with one no longer than it.  The rep is not involved: the
+// overwrite keeps the entry at its place.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_MEMTABLEREP_H_
+#define STORAGE_LEVELDB_INCLUDE_MEMTABLEREP_H_
+
+#include <cstddef>
+
+#include "leveldb/export.h"
+#include "leveldb/slice.h"
+
+namespace leveldb {
+
+// The arena of a memtable.  Opaque: reps get memory from it through
+// MemTableRep::Allocate().
+class MemTableAllocator;
+
+class LEVELDB_EXPORT MemTableRep {
+ public:
+  // Orders memtable entries by their internal keys.
+  class KeyComparator {
+   public:
+    virtual ~KeyComparator() = default;
+
+    // Three-way comparison of two entries.
+    virtual int operator()(const char* a, const char* b) const = 0;
+
+    // Three-way comparison of an entry with an internal key.
+    virtual int operator()(const char* entry, const Slice& key) const = 0;
+
+    // Returns true if entries are ordered first by the bytes of their
+    // user keys, as with BytewiseComparator().
+    virtual bool UserKeysAreBytewise() const { return false; }
+  };
+
+  // Iterates over entries in the order of the KeyComparator.
+  class Iterator {
+   public:
+    virtual ~Iterator() = default;
+
+    virtual bool Valid() const = 0;
+
+    // Returns the entry at the current position.
+    // REQUIRES: Valid()
+    virtual const char* key() const = 0;
+
+    // REQUIRES: Valid()
+    virtual void Next() = 0;
+    virtual void Prev() = 0;
+
+    // Advance to the first entry >= "target", which is a length-prefixed
+    // internal key as produced by LookupKey::memtable_key().
+    virtual void Seek(const char* target) = 0;
+
+    virtual void SeekToFirst() = 0;
+    virtual void SeekToLast() = 0;
+  };
+
+  explicit MemTableRep(MemTableAllocator* allocator)
+      : allocator_(allocator) {}
+
+  MemTableRep(const MemTableRep&) = delete;
+  MemTableRep& operator=(const MemTableRep&) = delete;
+
+  virtual ~MemTableRep();
+
+  // Allocate space for an entry of "len" bytes.  The caller fills it in
+  // and then passes it to Insert().
+  virtual char* Allocate(size_t len);
+
+  // Insert an entry returned by Allocate().
+  // REQUIRES: nothing that compares equal to entry is in the rep.
+  // REQUIRES: external synchronization between writers; readers may
+  // run concurrently with a writer.
+  virtual void Insert(const char* entry) = 0;
+
+  // Called once no more entries will be inserted.
+  virtual void MarkReadOnly() {}
+
+  // Memory used by the rep outside of the arena.
+  virtual size_t ApproximateMemoryUsage() = 0;
+
+  // Return an iterator over all entries in sorted order.  The caller must
+  // delete it before the rep is destroyed.
+  virtual Iterator* GetIterator() = 0;
+
+  // Return an iterator that is only required to be correct for entries
+  // sharing a user key with the target of its first Seek().  Used for
+  // point lookups; the default returns GetIterator().
+  virtual Iterator* GetLookupIterator() { return GetIterator(); }
+
+ protected:
+  MemTableAllocator* const allocator_;
+};
+
+// Creates the MemTableRep of each new memtable.  A factory may be shared
+// by several DBs and must be thread-safe.
+class LEVELDB_EXPORT MemTableRepFactory {
+ public:
+  virtual ~MemTableRepFactory();
+
+  // The name of the representation, e.g. "leveldb.SkipListRep".
+  virtual const char* Name() const = 0;
+
+  virtual MemTableRep* CreateMemTableRep(const MemTableRep::KeyComparator& cmp,
+                                         MemTableAllocator* allocator) = 0;
+};
+
+// Return a factory for the default skiplist representation.
+LEVELDB_EXPORT MemTableRepFactory* NewSkipListRepFactory();
+
+// Return a factory for the inline skiplist representation.  Entries are
+// allocated by the rep itself rather than from the arena directly.
+LEVELDB_EXPORT MemTableRepFactory* NewInlineSkipListRepFactory();
+
+// Return a factory for a hash table of "bucket_count" skiplists keyed on
+// the first "prefix_length" bytes of the user key (the whole key if it is
+// shorter).  Each memtable allocates a bucket array of 8 * bucket_count
+// bytes on top of write_buffer_size.
+LEVELDB_EXPORT MemTableRepFactory* NewHashSkipListRepFactory(
+    size_t prefix_length, size_t bucket_count = 50000);
+
+// Return a factory for the vector representation.  "reserve" entries are
+// preallocated for each memtable.
+LEVELDB_EXPORT MemTableRepFactory* NewVectorRepFactory(size_t reserve = 0);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_MEMTABLEREP_H_
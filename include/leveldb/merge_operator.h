@@ -0,0 +1,55 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A MergeOperator turns read-modify-write sequences such as counter
+// increments into blind writes.  DB::Merge() records an operand for a
+// key without reading it; the operands are applied to the older value of
+// the key by the MergeOperator when the key is read, and by compactions
+// once nothing needs the individual operands any longer.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_MERGE_OPERATOR_H_
+#define STORAGE_LEVELDB_INCLUDE_MERGE_OPERATOR_H_
+
+#include <string>
+#include <vector>
+
+#include "leveldb/export.h"
+#include "leveldb/slice.h"
+
+namespace leveldb {
+
+class LEVELDB_EXPORT MergeOperator {
+ public:
+  virtual ~MergeOperator();
+
+  // Apply "operands", oldest first, to the value of "key" they were
+  // written over, which is "*existing_value", or null if the key had no
+  // value, and store the result in *new_value.
+  //
+  // Return false if the operands cannot be applied; the key then reads
+  // as corrupted.
+  //
+  // Called from reads and from the background compaction thread, so it
+  // must be thread-safe.
+  virtual bool FullMerge(const Slice& key, const Slice* existing_value,
+                         const std::vector<Slice>& operands,
+                         std::string* new_value) const = 0;
+
+  // Return the name of this merge operator.  Merge operands are stored in
+  // the database, so the same operator must be used every time it is
+  // opened.
+  virtual const char* Name() const = 0;
+};
+
+// Return a merge operator for 64-bit unsigned counters stored as eight
+// little-endian bytes.  Each operand, in the same encoding, is added to
+// the counter, which starts at zero if the key has no value.
+//
+// Callers must delete the result after any database that is using the
+// result has been closed.
+LEVELDB_EXPORT const MergeOperator* NewUInt64AddOperator();
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_MERGE_OPERATOR_H_
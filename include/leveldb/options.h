@@ -6,16 +6,21 @@
 #define STORAGE_LEVELDB_INCLUDE_OPTIONS_H_
 
 #include <cstddef>
+#include <cstdint>
 
 #include "leveldb/export.h"
 
 namespace leveldb {
 
 class Cache;
+class CompactionFilter;
 class Comparator;
 class Env;
 class FilterPolicy;
 class Logger;
+class MemTableRepFactory;
+class MergeOperator;
+class RateLimiter;
 class Snapshot;
 
 // DB contents are stored in a set of blocks, each of which holds a
@@ -30,6 +35,17 @@ enum CompressionType {
   kZstdCompression = 0x2,
 };
 
+// How table files are organized and compacted.
+enum CompactionStyle {
+  // Levels of exponentially growing size, each holding one sorted run.
+  // Keeps space overhead low but rewrites data once per level.
+  kCompactionStyleLevel = 0,
+  // Every table file in level-0 is a sorted run, and runs of similar size
+  // are merged together.  Data is rewritten far less often, at the cost
+  // of more space and of reads that consult more runs.
+  kCompactionStyleUniversal = 1,
+};
+
 // Options to control the behavior of a database (passed to DB::Open)
 struct LEVELDB_EXPORT Options {
   // Create an Options object with default values for all fields.
@@ -82,11 +98,180 @@ struct LEVELDB_EXPORT Options {
   // the next time the database is opened.
   size_t write_buffer_size = 4 * 1024 * 1024;
 
+  // If non-zero, a memtable is also switched once it holds this many
+  // entries, however little memory they take.
+  size_t memtable_max_entries = 0;
+
+  // If positive, a memtable holding at least 1024 entries is also
+  // switched once deletion markers make up this fraction of its entries.
+  // Flushing early lets compactions drop the deleted entries sooner, so
+  // that iterators stop skipping over them.  Clipped to [0, 1].
+  double memtable_max_deletion_ratio = 0;
+
+  // Maximum number of memtables, the active one included.  A full
+  // memtable is queued for flushing while writes continue in a new one;
+  // writes only wait when this many memtables exist.  Larger values
+  // absorb short write bursts at the cost of memory (up to
+  // max_write_buffer_number * write_buffer_size) and reads that have to
+  // consult more memtables.
+  int max_write_buffer_number = 2;
+
+  // If true, a flush writes every queued immutable memtable into a single
+  // level-0 file instead of one file per memtable.
+  bool merge_immutable_memtables = false;
+
+  // Maximum number of threads a single flush may use.  If greater than
+  // one, a flush of several megabytes is split by key range into up to
+  // this many tables that are built in parallel.  Clipped to 16.
+  int flush_parallelism = 1;
+
+  // Creates the in-memory index of each memtable (see memtablerep.h).
+  // If null, memtables are skiplists.
+  MemTableRepFactory* memtable_factory = nullptr;
+
+  // If positive, each memtable keeps a bloom filter of its user keys that
+  // takes write_buffer_size * memtable_bloom_size_ratio bytes, so that
+  // lookups of keys missing from a memtable rarely search it.  Values are
+  // clipped to 0.25.  With entries of 100 bytes, 0.02 gives each key
+  // about 16 bits of filter.
+  double memtable_bloom_size_ratio = 0;
+
+  // If non-zero, memtables allocate their memory in blocks of this many
+  // bytes backed by huge pages (e.g. 2MB), reducing TLB misses in large
+  // memtables.  Reserved huge pages (vm.nr_hugepages) are used if
+  // available, else transparent huge pages.  Must be a power of two and at
+  // most a quarter of write_buffer_size, otherwise it is ignored; rounded
+  // up to the huge page size of the system.  Only supported on Linux.
+  size_t memtable_huge_page_size = 0;
+
+  // If true, memtable blocks allocated with huge pages are placed on the
+  // NUMA node of the thread that writes them.
+  bool memtable_numa_aware = false;
+
+  // If true, a Put of a key whose newest version in the active memtable
+  // is a value at least as large overwrites that value in place instead
+  // of adding a new entry, as long as no snapshot, iterator or Get() call
+  // exists.  Keeps the memtable small when a few keys are overwritten over
+  // and over.  Reads started meanwhile wait for a write that updates
+  // values in place to finish, so readers still see batches atomically.
+  bool inplace_update_support = false;
+
   // Number of open files that can be used by the DB.  You may need to
   // increase this if your database has a large working set (budget
   // one open file per 2MB of working set).
   int max_open_files = 1000;
 
+  // Number of levels of the LSM tree, at most 16.  A database cannot be
+  // opened with fewer levels than hold files.
+  int num_levels = 7;
+
+  // Number of level-0 files at which a level-0 compaction starts (or, with
+  // universal compaction, the number of sorted runs at which they are
+  // merged).  This parameter can be changed with DB::SetOptions().
+  int level0_file_num_compaction_trigger = 4;
+
+  // Deepest level to which a flushed memtable is pushed if it does not
+  // overlap the levels above.  Pushing past level-0 avoids relatively
+  // expensive level 0=>1 compactions, but pushing all the way to the last
+  // level wastes space if the same keys are overwritten over and over.
+  // This parameter can be changed with DB::SetOptions().
+  int max_mem_compaction_level = 2;
+
+  // Size target of level-1; each further level gets a target
+  // max_bytes_for_level_multiplier times larger than the one above.
+  // These parameters can be changed with DB::SetOptions().
+  uint64_t max_bytes_for_level_base = 10 * 1048576;
+  double max_bytes_for_level_multiplier = 10;
+
+  // How table files are compacted.  A database may be reopened with a
+  // different style; files already pushed to higher levels by leveled
+  // compaction then stay where they are.
+  CompactionStyle compaction_style = kCompactionStyleLevel;
+
+  // If true, leveled compaction derives the size targets of the levels
+  // backwards from the size of the last level, instead of forwards from
+  // max_bytes_for_level_base.  Levels whose target would be below
+  // max_bytes_for_level_base are left empty and level-0 is compacted
+  // straight into the first level below them.  This keeps about
+  // 90% of the data in the last level whatever the size of the database,
+  // which bounds space amplification.
+  bool level_compaction_dynamic_level_bytes = false;
+
+  // Universal compaction merges sorted runs once there are
+  // level0_file_num_compaction_trigger of them.  Starting with the newest
+  // run, the next older run is added to the merge while its size is at
+  // most the combined size of the runs picked so far plus this percentage.
+  int universal_size_ratio = 1;
+
+  // Minimum and maximum number of sorted runs merged by one universal
+  // compaction.  The minimum is clipped to at least 2.
+  int universal_min_merge_width = 2;
+  int universal_max_merge_width = 1000;
+
+  // If the sorted runs other than the oldest one take more than this
+  // percentage of the size of the oldest run, universal compaction
+  // merges all runs into one to bound the space taken by stale data.
+  int universal_max_size_amplification_percent = 200;
+
+  // If positive, leveled compaction also pushes a table file holding at
+  // least 1024 entries into the level below once deletion markers make up
+  // this fraction of its entries, even if its level is within its size
+  // target.  Compacting such files early reclaims the space of the
+  // deleted data and stops reads from skipping over the markers.  Files
+  // of the last level are left alone.  Clipped to [0, 1].
+  double deletion_compaction_ratio = 0;
+
+  // If positive, leveled compaction also pushes table files older than
+  // this many seconds into the level below once no other compaction is
+  // needed, so that key ranges no longer written to still shed their
+  // overwritten and deleted data.  Files are aged from their creation;
+  // files of the last level and files created before their creation time
+  // was recorded are left alone.  The age of the files is checked whenever
+  // the DB considers scheduling a compaction.
+  uint64_t periodic_compaction_seconds = 0;
+
+  // If non-null, compactions pass the newest value of each key that no
+  // snapshot can observe to this filter, which may drop or rewrite it.
+  // Snapshots created while a compaction is running may observe its
+  // filtered results.
+  const CompactionFilter* compaction_filter = nullptr;
+
+  // Combines the operands written by DB::Merge() with the older value of
+  // their key.  Must be set to use DB::Merge(), and must be the same
+  // every time the database is opened.
+  const MergeOperator* merge_operator = nullptr;
+
+  // Write stalls.  When compactions fall behind, writes are first slowed
+  // down (throttled to a rate that drops as the backlog grows) and then
+  // stopped until compactions catch up.  The triggers, limits and rate
+  // below can be changed with DB::SetOptions().
+
+  // Number of level-0 files at which writes start being slowed down.
+  int level0_slowdown_writes_trigger = 8;
+
+  // Number of level-0 files at which writes are stopped.
+  int level0_stop_writes_trigger = 12;
+
+  // Writes are slowed down (respectively stopped) once the estimated
+  // number of bytes compactions must rewrite to bring every level back
+  // under its size target exceeds these limits.  Zero disables a limit.
+  uint64_t soft_pending_compaction_bytes_limit = 64ull << 30;
+  uint64_t hard_pending_compaction_bytes_limit = 256ull << 30;
+
+  // Write rate in bytes per second once writes are slowed down.  The
+  // rate is reduced further the closer the DB is to stopping writes.
+  uint64_t delayed_write_rate = 16 << 20;
+
+  // If non-null, table files written by memtable flushes and compactions
+  // are written through this limiter (see NewGenericRateLimiter()), with
+  // flushes taking priority over compactions.
+  RateLimiter* rate_limiter = nullptr;
+
+  // Compactions read their input files ahead in chunks of this many bytes,
+  // so that each input is read with a few large reads instead of one read
+  // per block.  0 reads the inputs block by block.
+  size_t compaction_readahead_size = 2 * 1024 * 1024;
+
   // Control over blocks (user data is stored in a set of blocks, and
   // a block is the unit of reading from disk).
 
@@ -135,6 +320,15 @@ struct LEVELDB_EXPORT Options {
   // Currently only the range [-5,22] is supported. Default is 1.
   int zstd_compression_level = 1;
 
+  // Compress write-ahead log records using the specified compression
+  // algorithm (zstd uses zstd_compression_level).  Records that do not
+  // compress well are logged uncompressed.  Logs written with any
+  // setting can be recovered regardless of the current setting, as long
+  // as the compression library used to write them is available.
+  //
+  // Default: kNoCompression
+  CompressionType wal_compression = kNoCompression;
+
   // EXPERIMENTAL: If true, append to existing MANIFEST and log files
   // when a database is opened.  This can significantly speed up open.
   //
@@ -162,6 +356,12 @@ struct LEVELDB_EXPORT ReadOptions {
   // not have been released).  If "snapshot" is null, use an implicit
   // snapshot of the state at the beginning of this read operation.
   const Snapshot* snapshot = nullptr;
+
+  // If non-zero, iterators read the table files ahead of the blocks they
+  // need, in chunks of this many bytes.  This suits scans of large ranges
+  // of files that are not cached, at the cost of a buffer of this size
+  // per table file the iterator visits.
+  size_t readahead_size = 0;
 };
 
 // Options that control write operations
@@ -183,6 +383,14 @@ struct LEVELDB_EXPORT WriteOptions {
   // with sync==true has similar crash semantics to a "write()"
   // system call followed by "fsync()".
   bool sync = false;
+
+  // If true, the write is applied to the memtable without first being
+  // appended to the write-ahead log.  Such writes are not recovered if
+  // the process crashes before the memtable has been flushed to a table
+  // file; they survive a clean shutdown because the DB flushes any
+  // memtable holding unlogged writes when it is closed.  "sync" has no
+  // effect on a write that skips the log.
+  bool disable_wal = false;
 };
 
 }  // namespace leveldb
@@ -0,0 +1,59 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A RateLimiter bounds the write bandwidth used by background work
+// (memtable flushes and compactions) so that it does not starve
+// foreground reads of device bandwidth.  A single limiter may be shared
+// by several DBs to bound their combined background I/O.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_RATE_LIMITER_H_
+#define STORAGE_LEVELDB_INCLUDE_RATE_LIMITER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "leveldb/export.h"
+
+namespace leveldb {
+
+class LEVELDB_EXPORT RateLimiter {
+ public:
+  // Memtable flushes are issued at kIOHigh and are served before
+  // compactions (kIOLow), since a slow flush stalls writers directly.
+  enum IOPriority { kIOLow = 0, kIOHigh = 1 };
+
+  virtual ~RateLimiter();
+
+  // Block until "bytes" may be written at priority "pri".
+  virtual void Request(size_t bytes, IOPriority pri) = 0;
+
+  // Called by the DB whenever foreground writes are slowed down or
+  // stopped because background work is falling behind.  An auto-tuned
+  // limiter uses this to hand more bandwidth to background writes.
+  virtual void ReportWriteStall() = 0;
+
+  // Current limit in bytes per second.
+  virtual int64_t GetBytesPerSecond() const = 0;
+
+  // Change the limit.  For an auto-tuned limiter this sets the upper
+  // bound of the tuned rate.
+  virtual void SetBytesPerSecond(int64_t bytes_per_second) = 0;
+};
+
+// Return a new rate limiter that allows at most "bytes_per_second" of
+// background writes.  Tokens are refilled ten times per second.
+//
+// If "auto_tuned" is true, the effective rate floats between 5% and 100%
+// of "bytes_per_second": it is raised quickly when writes stall and when
+// background writes are constantly throttled, and lowered slowly while
+// the budget goes unused.
+//
+// The caller must delete the result after any DB using it has been
+// closed.
+LEVELDB_EXPORT RateLimiter* NewGenericRateLimiter(int64_t bytes_per_second,
+                                                  bool auto_tuned = false);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_RATE_LIMITER_H_
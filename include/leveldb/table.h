@@ -19,6 +19,7 @@ struct Options;
 class RandomAccessFile;
 struct ReadOptions;
 class TableCache;
+struct TableProperties;
 
 // A Table is a sorted map from strings to strings.  Tables are
 // immutable and persistent.  A Table may be safely accessed from
@@ -62,27 +63,52 @@ class LEVELDB_EXPORT Table
     // be close to the file length.
     uint64_t ApproximateOffsetOf(const Slice &key) const;
 
+    // Returns the statistics stored in the table by the TableBuilder, or
+    // nullptr for tables written before they were recorded.  The result
+    // lives as long as the table.
+    const TableProperties *GetProperties() const;
+
   private:
     friend class TableCache;
     struct Rep;
 
     static Iterator *BlockReader(void *, const ReadOptions &, const Slice &);
+    static Iterator *ReadaheadBlockReader(
+        void *,
+        const ReadOptions &,
+        const Slice &);
+
+    // Returns an iterator over the block at index_value, read from "file"
+    // on a block cache miss.
+    Iterator *NewBlockIterator(
+        RandomAccessFile *file,
+        const ReadOptions &,
+        const Slice &index_value);
 
     explicit Table(Rep *rep)
         : rep_(rep)
     {}
 
     // Calls (*handle_result)(arg, ...) with the entry found after a call
-    // to Seek(key).  May not make such a call if filter policy says
+    // to Seek(key), and with each following entry for as long as it
+    // returns true.  May not make such a call if filter policy says
     // that key is not present.
     Status InternalGet(
         const ReadOptions &,
         const Slice &key,
         void *arg,
-        void (*handle_result)(void *arg, const Slice &k, const Slice &v));
+        bool (*handle_result)(void *arg, const Slice &k, const Slice &v));
+
+    // Returns an iterator over the range deletion block, or nullptr if the
+    // table has none.
+    Iterator *NewRangeTombstoneIterator() const;
 
-    void ReadMeta(const Footer &footer);
+    // Returns an error only if the table has range tombstones that
+    // cannot be read; the other meta blocks are optional.
+    Status ReadMeta(const Footer &footer);
     void ReadFilter(const Slice &filter_handle_value);
+    void ReadProperties(const Slice &handle_value);
+    Status ReadRangeTombstones(const Slice &handle_value);
 
     Rep *const rep_;
 };
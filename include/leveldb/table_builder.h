@@ -52,6 +52,22 @@ class LEVELDB_EXPORT TableBuilder
     // REQUIRES: Finish(), Abandon() have not been called
     void Add(const Slice &key, const Slice &value);
 
+    // Add key,value to the range deletion meta block of the table, which
+    // is kept apart from the entries added by Add().
+    // REQUIRES: key is after any previously added range deletion key
+    // according to comparator.
+    // REQUIRES: Finish(), Abandon() have not been called
+    void AddRangeTombstone(const Slice &key, const Slice &value);
+
+    // Record the number of deletion markers among the entries added and
+    // the range of their sequence numbers, which the builder cannot tell
+    // from their keys, in the table properties written by Finish().
+    // REQUIRES: Finish(), Abandon() have not been called
+    void SetEntryStats(
+        uint64_t num_deletions,
+        uint64_t smallest_seqno,
+        uint64_t largest_seqno);
+
     // Advanced operation: flush any buffered key/value pairs to file.
     // Can be used to ensure that two adjacent entries never live in
     // the same data block.  Most clients should not need to use this method.
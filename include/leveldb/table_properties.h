@@ -0,0 +1,59 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// TableProperties are statistics about the contents of a table, computed
+// by the TableBuilder and stored in a meta block of the table, so that
+// they can be read without scanning the data.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_TABLE_PROPERTIES_H_
+#define STORAGE_LEVELDB_INCLUDE_TABLE_PROPERTIES_H_
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include "leveldb/export.h"
+
+namespace leveldb {
+
+struct LEVELDB_EXPORT TableProperties {
+  // Bytes taken in the file by the data blocks, the index block (before
+  // compression) and the filter block.
+  uint64_t data_size = 0;
+  uint64_t index_size = 0;
+  uint64_t filter_size = 0;
+
+  // Number of data blocks.
+  uint64_t num_data_blocks = 0;
+
+  // Number of entries, and total size of their keys and values before
+  // compression.  raw_key_size + raw_value_size compared to data_size
+  // gives the compression ratio.
+  uint64_t num_entries = 0;
+  uint64_t raw_key_size = 0;
+  uint64_t raw_value_size = 0;
+
+  // Tables written by a DB: number of deletion markers among the
+  // entries, number of range tombstones kept apart from them, and the
+  // range of the sequence numbers of the entries.
+  uint64_t num_deletions = 0;
+  uint64_t num_range_deletions = 0;
+  uint64_t smallest_seqno = 0;
+  uint64_t largest_seqno = 0;
+
+  // Name of the compression type of the options used to write the table,
+  // and of their filter policy ("" if none).
+  std::string compression_name;
+  std::string filter_policy_name;
+
+  // Returns a human-readable list of the properties, one per line.
+  std::string ToString() const;
+};
+
+// Properties of tables, keyed by the name of their file.
+typedef std::map<std::string, TableProperties> TablePropertiesCollection;
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_TABLE_PROPERTIES_H_
@@ -39,6 +39,14 @@ class LEVELDB_EXPORT WriteBatch
         virtual ~Handler();
         virtual void Put(const Slice &key, const Slice &value) = 0;
         virtual void Delete(const Slice &key) = 0;
+
+        // Called for each DeleteRange() in the batch.  The default does
+        // nothing, so handlers written before range deletions existed
+        // keep compiling.
+        virtual void DeleteRange(const Slice &begin, const Slice &end);
+
+        // Called for each Merge() in the batch.  The default does nothing.
+        virtual void Merge(const Slice &key, const Slice &value);
     };
 
     WriteBatch();
@@ -55,6 +63,14 @@ class LEVELDB_EXPORT WriteBatch
     // If the database contains a mapping for "key", erase it.  Else do nothing.
     void Delete(const Slice &key);
 
+    // Erase every mapping whose key is in ["begin", "end").  Mappings
+    // stored later in this batch or in later writes are unaffected.
+    void DeleteRange(const Slice &begin, const Slice &end);
+
+    // Record "value" as a merge operand for "key", to be combined with
+    // the value of "key" by the DB's Options::merge_operator.
+    void Merge(const Slice &key, const Slice &value);
+
     // Clear all updates buffered in this batch.
     void Clear();
 
@@ -11,6 +11,7 @@
 #include "leveldb/slice.h"
 #include "leveldb/status.h"
 #include "leveldb/table_builder.h"
+#include "leveldb/table_properties.h"
 
 namespace leveldb {
 
@@ -78,6 +79,19 @@ static const uint64_t kTableMagicNumber = 0xdb4775248b80fb57ull;
 // 1-byte type + 32-bit crc
 static const size_t kBlockTrailerSize = 5;
 
+// Name of the metaindex entry for the block of range tombstones.
+static const char kRangeDelBlockName[] = "leveldb.rangedel";
+
+// Name of the metaindex entry for the block of table properties.
+static const char kPropertiesBlockName[] = "leveldb.properties";
+
+// The properties block holds a list of named properties, each encoded
+// as a length-prefixed name followed by a length-prefixed value.
+// Numbers are varint64 values.  Unknown names are skipped when decoding,
+// so that properties can be added without breaking older readers.
+void EncodeTableProperties(const TableProperties& props, std::string* dst);
+Status DecodeTableProperties(const Slice& contents, TableProperties* props);
+
 struct BlockContents {
   Slice data;           // Actual contents of data
   bool cachable;        // True iff data can be cached
@@ -4,11 +4,15 @@
 
 #include "leveldb/table.h"
 
+#include <algorithm>
+#include <cstring>
+
 #include "leveldb/cache.h"
 #include "leveldb/comparator.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/options.h"
+#include "leveldb/table_properties.h"
 #include "table/block.h"
 #include "table/filter_block.h"
 #include "table/format.h"
@@ -22,17 +26,22 @@ struct Table::Rep {
     delete filter;
     delete[] filter_data;
     delete index_block;
+    delete range_del_block;
+    delete properties;
   }
 
   Options options;
   Status status;
   RandomAccessFile* file;
+  uint64_t file_size;
   uint64_t cache_id;
   FilterBlockReader* filter;
   const char* filter_data;
 
   BlockHandle metaindex_handle;  // Handle to metaindex_block: saved from footer
   Block* index_block;
+  Block* range_del_block;  // Null if the table has no range tombstones
+  TableProperties* properties;  // Null if the table has no properties
 };
 
 Status Table::Open(const Options& options, RandomAccessFile* file,
@@ -67,23 +76,26 @@ Status Table::Open(const Options& options, RandomAccessFile* file,
     Rep* rep = new Table::Rep;
     rep->options = options;
     rep->file = file;
+    rep->file_size = size;
     rep->metaindex_handle = footer.metaindex_handle();
     rep->index_block = index_block;
     rep->cache_id = (options.block_cache ? options.block_cache->NewId() : 0);
     rep->filter_data = nullptr;
     rep->filter = nullptr;
+    rep->range_del_block = nullptr;
+    rep->properties = nullptr;
     *table = new Table(rep);
-    (*table)->ReadMeta(footer);
+    s = (*table)->ReadMeta(footer);
+    if (!s.ok()) {
+      delete *table;
+      *table = nullptr;
+    }
   }
 
   return s;
 }
 
-void Table::ReadMeta(const Footer& footer) {
-  if (rep_->options.filter_policy == nullptr) {
-    return;  // Do not need any metadata
-  }
-
+Status Table::ReadMeta(const Footer& footer) {
   // TODO(sanjay): Skip this if footer.metaindex_handle() size indicates
   // it is an empty block.
   ReadOptions opt;
@@ -93,19 +105,31 @@ void Table::ReadMeta(const Footer& footer) {
   BlockContents contents;
   if (!ReadBlock(rep_->file, opt, footer.metaindex_handle(), &contents).ok()) {
     // Do not propagate errors since meta info is not needed for operation
-    return;
+    return Status::OK();
   }
   Block* meta = new Block(contents);
 
   Iterator* iter = meta->NewIterator(BytewiseComparator());
-  std::string key = "filter.";
-  key.append(rep_->options.filter_policy->Name());
-  iter->Seek(key);
-  if (iter->Valid() && iter->key() == Slice(key)) {
-    ReadFilter(iter->value());
+  if (rep_->options.filter_policy != nullptr) {
+    std::string key = "filter.";
+    key.append(rep_->options.filter_policy->Name());
+    iter->Seek(key);
+    if (iter->Valid() && iter->key() == Slice(key)) {
+      ReadFilter(iter->value());
+    }
+  }
+  iter->Seek(kPropertiesBlockName);
+  if (iter->Valid() && iter->key() == Slice(kPropertiesBlockName)) {
+    ReadProperties(iter->value());
+  }
+  Status s;
+  iter->Seek(kRangeDelBlockName);
+  if (iter->Valid() && iter->key() == Slice(kRangeDelBlockName)) {
+    s = ReadRangeTombstones(iter->value());
   }
   delete iter;
   delete meta;
+  return s;
 }
 
 void Table::ReadFilter(const Slice& filter_handle_value) {
@@ -131,6 +155,48 @@ void Table::ReadFilter(const Slice& filter_handle_value) {
   rep_->filter = new FilterBlockReader(rep_->options.filter_policy, block.data);
 }
 
+void Table::ReadProperties(const Slice& handle_value) {
+  Slice v = handle_value;
+  BlockHandle handle;
+  if (!handle.DecodeFrom(&v).ok()) {
+    return;
+  }
+  ReadOptions opt;
+  opt.verify_checksums = true;
+  BlockContents contents;
+  if (!ReadBlock(rep_->file, opt, handle, &contents).ok()) {
+    return;
+  }
+  TableProperties* properties = new TableProperties;
+  if (DecodeTableProperties(contents.data, properties).ok()) {
+    rep_->properties = properties;
+  } else {
+    delete properties;
+  }
+  if (contents.heap_allocated) {
+    delete[] contents.data.data();
+  }
+}
+
+Status Table::ReadRangeTombstones(const Slice& handle_value) {
+  Slice v = handle_value;
+  BlockHandle handle;
+  Status s = handle.DecodeFrom(&v);
+  if (!s.ok()) {
+    return s;
+  }
+  // Unlike the filter, the tombstones are needed for correct reads, so
+  // their checksums are always verified.
+  ReadOptions opt;
+  opt.verify_checksums = true;
+  BlockContents contents;
+  s = ReadBlock(rep_->file, opt, handle, &contents);
+  if (s.ok()) {
+    rep_->range_del_block = new Block(contents);
+  }
+  return s;
+}
+
 Table::~Table() { delete rep_; }
 
 static void DeleteBlock(void* arg, void* ignored) {
@@ -148,12 +214,97 @@ static void ReleaseBlock(void* arg, void* h) {
   cache->Release(handle);
 }
 
+namespace {
+// Serves the reads of a single iterator from a buffer filled with reads of
+// up to readahead_size bytes.  Reads past the buffer refill it starting at
+// the offset read, so that a scan reads the file sequentially in large
+// chunks.  Not thread-safe.
+class ReadaheadFile : public RandomAccessFile {
+ public:
+  ReadaheadFile(RandomAccessFile* file, uint64_t file_size,
+                size_t readahead_size)
+      : file_(file),
+        file_size_(file_size),
+        readahead_size_(readahead_size),
+        buf_(new char[readahead_size]),
+        buffer_offset_(0) {}
+
+  ~ReadaheadFile() override { delete[] buf_; }
+
+  Status Read(uint64_t offset, size_t n, Slice* result,
+              char* scratch) const override {
+    if (n > readahead_size_ || offset + n > file_size_) {
+      return file_->Read(offset, n, result, scratch);
+    }
+    if (offset < buffer_offset_ ||
+        offset + n > buffer_offset_ + buffered_.size()) {
+      const size_t chunk =
+          std::min<uint64_t>(readahead_size_, file_size_ - offset);
+      Status s = file_->Read(offset, chunk, &buffered_, buf_);
+      buffer_offset_ = offset;
+      if (!s.ok()) {
+        buffered_.clear();
+        return s;
+      }
+    }
+    const uint64_t skip = std::min<uint64_t>(offset - buffer_offset_,
+                                             buffered_.size());
+    Slice data(buffered_.data() + skip,
+               std::min<uint64_t>(n, buffered_.size() - skip));
+    if (buffered_.data() == buf_) {
+      // Blocks may outlive the buffer: copy them out.
+      std::memcpy(scratch, data.data(), data.size());
+      *result = Slice(scratch, data.size());
+    } else {
+      // The file returned memory it owns (e.g. a mapping).
+      *result = data;
+    }
+    return Status::OK();
+  }
+
+ private:
+  RandomAccessFile* const file_;
+  const uint64_t file_size_;
+  const size_t readahead_size_;
+  char* const buf_;
+  mutable uint64_t buffer_offset_;
+  mutable Slice buffered_;
+};
+
+struct ReadaheadState {
+  ReadaheadState(Table* t, RandomAccessFile* file, uint64_t file_size,
+                 size_t readahead_size)
+      : table(t), file(file, file_size, readahead_size) {}
+
+  Table* const table;
+  ReadaheadFile file;
+};
+
+void DeleteReadaheadState(void* arg, void* ignored) {
+  delete reinterpret_cast<ReadaheadState*>(arg);
+}
+}  // namespace
+
 // Convert an index iterator value (i.e., an encoded BlockHandle)
 // into an iterator over the contents of the corresponding block.
 Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
                              const Slice& index_value) {
   Table* table = reinterpret_cast<Table*>(arg);
-  Cache* block_cache = table->rep_->options.block_cache;
+  return table->NewBlockIterator(table->rep_->file, options, index_value);
+}
+
+// Like BlockReader(), reading the blocks through the ReadaheadFile of the
+// iterator.
+Iterator* Table::ReadaheadBlockReader(void* arg, const ReadOptions& options,
+                                      const Slice& index_value) {
+  ReadaheadState* state = reinterpret_cast<ReadaheadState*>(arg);
+  return state->table->NewBlockIterator(&state->file, options, index_value);
+}
+
+Iterator* Table::NewBlockIterator(RandomAccessFile* file,
+                                  const ReadOptions& options,
+                                  const Slice& index_value) {
+  Cache* block_cache = rep_->options.block_cache;
   Block* block = nullptr;
   Cache::Handle* cache_handle = nullptr;
 
@@ -167,14 +318,14 @@ Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
     BlockContents contents;
     if (block_cache != nullptr) {
       char cache_key_buffer[16];
-      EncodeFixed64(cache_key_buffer, table->rep_->cache_id);
+      EncodeFixed64(cache_key_buffer, rep_->cache_id);
       EncodeFixed64(cache_key_buffer + 8, handle.offset());
       Slice key(cache_key_buffer, sizeof(cache_key_buffer));
       cache_handle = block_cache->Lookup(key);
       if (cache_handle != nullptr) {
         block = reinterpret_cast<Block*>(block_cache->Value(cache_handle));
       } else {
-        s = ReadBlock(table->rep_->file, options, handle, &contents);
+        s = ReadBlock(file, options, handle, &contents);
         if (s.ok()) {
           block = new Block(contents);
           if (contents.cachable && options.fill_cache) {
@@ -184,7 +335,7 @@ Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
         }
       }
     } else {
-      s = ReadBlock(table->rep_->file, options, handle, &contents);
+      s = ReadBlock(file, options, handle, &contents);
       if (s.ok()) {
         block = new Block(contents);
       }
@@ -193,7 +344,7 @@ Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
 
   Iterator* iter;
   if (block != nullptr) {
-    iter = block->NewIterator(table->rep_->options.comparator);
+    iter = block->NewIterator(rep_->options.comparator);
     if (cache_handle == nullptr) {
       iter->RegisterCleanup(&DeleteBlock, block, nullptr);
     } else {
@@ -206,32 +357,57 @@ Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
 }
 
 Iterator* Table::NewIterator(const ReadOptions& options) const {
+  if (options.readahead_size > 0) {
+    ReadaheadState* state =
+        new ReadaheadState(const_cast<Table*>(this), rep_->file,
+                           rep_->file_size, options.readahead_size);
+    Iterator* iter = NewTwoLevelIterator(
+        rep_->index_block->NewIterator(rep_->options.comparator),
+        &Table::ReadaheadBlockReader, state, options);
+    iter->RegisterCleanup(&DeleteReadaheadState, state, nullptr);
+    return iter;
+  }
   return NewTwoLevelIterator(
       rep_->index_block->NewIterator(rep_->options.comparator),
       &Table::BlockReader, const_cast<Table*>(this), options);
 }
 
+const TableProperties* Table::GetProperties() const {
+  return rep_->properties;
+}
+
+Iterator* Table::NewRangeTombstoneIterator() const {
+  if (rep_->range_del_block == nullptr) {
+    return nullptr;
+  }
+  return rep_->range_del_block->NewIterator(rep_->options.comparator);
+}
+
 Status Table::InternalGet(const ReadOptions& options, const Slice& k, void* arg,
-                          void (*handle_result)(void*, const Slice&,
+                          bool (*handle_result)(void*, const Slice&,
                                                 const Slice&)) {
   Status s;
   Iterator* iiter = rep_->index_block->NewIterator(rep_->options.comparator);
-  iiter->Seek(k);
-  if (iiter->Valid()) {
+  bool more = true;
+  // The entries handled may continue into the following blocks.
+  for (iiter->Seek(k); more && iiter->Valid(); iiter->Next()) {
     Slice handle_value = iiter->value();
     FilterBlockReader* filter = rep_->filter;
     BlockHandle handle;
     if (filter != nullptr && handle.DecodeFrom(&handle_value).ok() &&
         !filter->KeyMayMatch(handle.offset(), k)) {
       // Not found
-    } else {
-      Iterator* block_iter = BlockReader(this, options, iiter->value());
-      block_iter->Seek(k);
-      if (block_iter->Valid()) {
-        (*handle_result)(arg, block_iter->key(), block_iter->value());
-      }
-      s = block_iter->status();
-      delete block_iter;
+      break;
+    }
+    Iterator* block_iter = BlockReader(this, options, iiter->value());
+    for (block_iter->Seek(k); more && block_iter->Valid();
+         block_iter->Next()) {
+      more = (*handle_result)(arg, block_iter->key(), block_iter->value());
+    }
+    s = block_iter->status();
+    delete block_iter;
+    if (!s.ok()) {
+      break;
     }
   }
   if (s.ok()) {
@@ -10,6 +10,7 @@
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/options.h"
+#include "leveldb/table_properties.h"
 #include "table/block_builder.h"
 #include "table/filter_block.h"
 #include "table/format.h"
@@ -26,6 +27,7 @@ struct TableBuilder::Rep {
         offset(0),
         data_block(&options),
         index_block(&index_block_options),
+        range_del_block(&index_block_options),
         num_entries(0),
         closed(false),
         filter_block(opt.filter_policy == nullptr
@@ -42,8 +44,10 @@ struct TableBuilder::Rep {
   Status status;
   BlockBuilder data_block;
   BlockBuilder index_block;
+  BlockBuilder range_del_block;
   std::string last_key;
   int64_t num_entries;
+  TableProperties props;
   bool closed;  // Either Finish() or Abandon() has been called.
   FilterBlockBuilder* filter_block;
 
@@ -114,6 +118,8 @@ void TableBuilder::Add(const Slice& key, const Slice& value) {
 
   r->last_key.assign(key.data(), key.size());
   r->num_entries++;
+  r->props.raw_key_size += key.size();
+  r->props.raw_value_size += value.size();
   r->data_block.Add(key, value);
 
   const size_t estimated_block_size = r->data_block.CurrentSizeEstimate();
@@ -122,6 +128,24 @@ void TableBuilder::Add(const Slice& key, const Slice& value) {
   }
 }
 
+void TableBuilder::AddRangeTombstone(const Slice& key, const Slice& value) {
+  Rep* r = rep_;
+  assert(!r->closed);
+  if (!ok()) return;
+  r->range_del_block.Add(key, value);
+  r->props.num_range_deletions++;
+}
+
+void TableBuilder::SetEntryStats(uint64_t num_deletions,
+                                 uint64_t smallest_seqno,
+                                 uint64_t largest_seqno) {
+  Rep* r = rep_;
+  assert(!r->closed);
+  r->props.num_deletions = num_deletions;
+  r->props.smallest_seqno = smallest_seqno;
+  r->props.largest_seqno = largest_seqno;
+}
+
 void TableBuilder::Flush() {
   Rep* r = rep_;
   assert(!r->closed);
@@ -130,6 +154,7 @@ void TableBuilder::Flush() {
   assert(!r->pending_index_entry);
   WriteBlock(&r->data_block, &r->pending_handle);
   if (ok()) {
+    r->props.num_data_blocks++;
     r->pending_index_entry = true;
     r->status = r->file->Flush();
   }
@@ -210,6 +235,18 @@ void TableBuilder::WriteRawBlock(const Slice& block_contents,
 
 Status TableBuilder::status() const { return rep_->status; }
 
+static const char* CompressionTypeName(CompressionType type) {
+  switch (type) {
+    case kNoCompression:
+      return "NoCompression";
+    case kSnappyCompression:
+      return "Snappy";
+    case kZstdCompression:
+      return "Zstd";
+  }
+  return "Unknown";
+}
+
 Status TableBuilder::Finish() {
   Rep* r = rep_;
   Flush();
@@ -217,16 +254,52 @@ Status TableBuilder::Finish() {
   r->closed = true;
 
   BlockHandle filter_block_handle, metaindex_block_handle, index_block_handle;
+  BlockHandle range_del_block_handle, properties_block_handle;
+  r->props.data_size = r->offset;
 
   // Write filter block
   if (ok() && r->filter_block != nullptr) {
     WriteRawBlock(r->filter_block->Finish(), kNoCompression,
                   &filter_block_handle);
+    r->props.filter_size = filter_block_handle.size();
+  }
+
+  // Write range deletion block
+  const bool has_range_dels = !r->range_del_block.empty();
+  if (ok() && has_range_dels) {
+    WriteBlock(&r->range_del_block, &range_del_block_handle);
   }
 
-  // Write metaindex block
+  // The last index entry is known by now, so that the size of the index
+  // block can be recorded in the properties.
+  if (ok() && r->pending_index_entry) {
+    r->options.comparator->FindShortSuccessor(&r->last_key);
+    std::string handle_encoding;
+    r->pending_handle.EncodeTo(&handle_encoding);
+    r->index_block.Add(r->last_key, Slice(handle_encoding));
+    r->pending_index_entry = false;
+  }
+
+  // Write properties block
+  if (ok()) {
+    TableProperties* props = &r->props;
+    props->index_size = r->index_block.CurrentSizeEstimate();
+    props->num_entries = r->num_entries;
+    props->compression_name = CompressionTypeName(r->options.compression);
+    if (r->options.filter_policy != nullptr) {
+      props->filter_policy_name = r->options.filter_policy->Name();
+    }
+    std::string contents;
+    EncodeTableProperties(*props, &contents);
+    WriteRawBlock(contents, kNoCompression, &properties_block_handle);
+  }
+
+  // Write metaindex block.  Its keys are the names of the meta blocks,
+  // so they are ordered bytewise whatever the comparator of the table.
   if (ok()) {
-    BlockBuilder meta_index_block(&r->options);
+    Options meta_index_options = r->options;
+    meta_index_options.comparator = BytewiseComparator();
+    BlockBuilder meta_index_block(&meta_index_options);
     if (r->filter_block != nullptr) {
       // Add mapping from "filter.Name" to location of filter data
       std::string key = "filter.";
@@ -235,20 +308,22 @@ Status TableBuilder::Finish() {
       filter_block_handle.EncodeTo(&handle_encoding);
       meta_index_block.Add(key, handle_encoding);
     }
+    {
+      std::string handle_encoding;
+      properties_block_handle.EncodeTo(&handle_encoding);
+      meta_index_block.Add(kPropertiesBlockName, handle_encoding);
+    }
+    if (has_range_dels) {
+      std::string handle_encoding;
+      range_del_block_handle.EncodeTo(&handle_encoding);
+      meta_index_block.Add(kRangeDelBlockName, handle_encoding);
+    }
 
-    // TODO(postrelease): Add stats and other meta blocks
     WriteBlock(&meta_index_block, &metaindex_block_handle);
   }
 
   // Write index block
   if (ok()) {
-    if (r->pending_index_entry) {
-      r->options.comparator->FindShortSuccessor(&r->last_key);
-      std::string handle_encoding;
-      r->pending_handle.EncodeTo(&handle_encoding);
-      r->index_block.Add(r->last_key, Slice(handle_encoding));
-      r->pending_index_entry = false;
-    }
     WriteBlock(&r->index_block, &index_block_handle);
   }
 
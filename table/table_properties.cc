@@ -0,0 +1,99 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/table_properties.h"
+
+#include "table/format.h"
+#include "util/coding.h"
+#include "util/logging.h"
+
+namespace leveldb {
+
+namespace {
+struct NumericProperty {
+  const char* name;
+  uint64_t TableProperties::*field;
+};
+
+const NumericProperty kNumericProperties[] = {
+    {"data.size", &TableProperties::data_size},
+    {"index.size", &TableProperties::index_size},
+    {"filter.size", &TableProperties::filter_size},
+    {"num.data.blocks", &TableProperties::num_data_blocks},
+    {"num.entries", &TableProperties::num_entries},
+    {"raw.key.size", &TableProperties::raw_key_size},
+    {"raw.value.size", &TableProperties::raw_value_size},
+    {"num.deletions", &TableProperties::num_deletions},
+    {"num.range-deletions", &TableProperties::num_range_deletions},
+    {"smallest.seqno", &TableProperties::smallest_seqno},
+    {"largest.seqno", &TableProperties::largest_seqno},
+};
+
+const char kCompressionName[] = "compression";
+const char kFilterPolicyName[] = "filter.policy";
+}  // namespace
+
+std::string TableProperties::ToString() const {
+  std::string r;
+  for (const NumericProperty& p : kNumericProperties) {
+    r.append(p.name);
+    r.append(": ");
+    AppendNumberTo(&r, this->*p.field);
+    r.append("\n");
+  }
+  r.append(kCompressionName);
+  r.append(": ");
+  r.append(compression_name);
+  r.append("\n");
+  r.append(kFilterPolicyName);
+  r.append(": ");
+  r.append(filter_policy_name);
+  r.append("\n");
+  return r;
+}
+
+void EncodeTableProperties(const TableProperties& props, std::string* dst) {
+  std::string value;
+  for (const NumericProperty& p : kNumericProperties) {
+    value.clear();
+    PutVarint64(&value, props.*p.field);
+    PutLengthPrefixedSlice(dst, p.name);
+    PutLengthPrefixedSlice(dst, value);
+  }
+  PutLengthPrefixedSlice(dst, kCompressionName);
+  PutLengthPrefixedSlice(dst, props.compression_name);
+  PutLengthPrefixedSlice(dst, kFilterPolicyName);
+  PutLengthPrefixedSlice(dst, props.filter_policy_name);
+}
+
+Status DecodeTableProperties(const Slice& contents, TableProperties* props) {
+  *props = TableProperties();
+  Slice input = contents;
+  Slice name, value;
+  while (!input.empty()) {
+    if (!GetLengthPrefixedSlice(&input, &name) ||
+        !GetLengthPrefixedSlice(&input, &value)) {
+      return Status::Corruption("bad table properties block");
+    }
+    if (name == Slice(kCompressionName)) {
+      props->compression_name = value.ToString();
+      continue;
+    }
+    if (name == Slice(kFilterPolicyName)) {
+      props->filter_policy_name = value.ToString();
+      continue;
+    }
+    for (const NumericProperty& p : kNumericProperties) {
+      if (name == Slice(p.name)) {
+        if (!GetVarint64(&value, &(props->*p.field))) {
+          return Status::Corruption("bad table property", name);
+        }
+        break;
+      }
+    }
+  }
+  return Status::OK();
+}
+
+}  // namespace leveldb
@@ -9,6 +9,7 @@
 #include <catch2/catch_test_macros.hpp>
 #include <util/arena.h>
 #include <util/random.h>
+#include <cstring>
 
 using namespace leveldb;
 
@@ -61,4 +62,39 @@ TEST_CASE("store/arena.h")
             }
         }
     }
+
+    SECTION("HugePage")
+    {
+        // 无论大页是否可用，分配结果都应正确
+        const size_t kHugePageSize = 2 << 20;
+        Arena arena(kHugePageSize, true);
+        std::vector<char *> allocated;
+        for (int i = 0; i < 3000; i++) {
+            char *r = arena.AllocateAligned(1000);
+            std::memset(r, i % 256, 1000);
+            allocated.push_back(r);
+        }
+        for (size_t i = 0; i < allocated.size(); i++) {
+            REQUIRE((int(allocated[i][999]) & 0xff) == (i % 256));
+        }
+        REQUIRE(arena.MemoryUsage() >= 3000 * 1000);
+        REQUIRE(arena.HugePageMemoryUsage() <= arena.MemoryUsage());
+        if (arena.HugePageMemoryUsage() > 0) {
+            // 按大页整块分配
+            REQUIRE(arena.HugePageMemoryUsage() % kHugePageSize == 0);
+        }
+    }
+
+    SECTION("SmallHugePage")
+    {
+        // 小于系统大页的块大小会向上取整, 映射长度始终合法
+        Arena arena(8 << 10, false);
+        for (int i = 0; i < 100; i++) {
+            std::memset(arena.Allocate(1000), 0, 1000);
+        }
+        REQUIRE(arena.MemoryUsage() >= 100 * 1000);
+        if (arena.HugePageMemoryUsage() > 0) {
+            REQUIRE(arena.HugePageMemoryUsage() % (2 << 20) == 0);
+        }
+    }
 }
\ No newline at end of file
@@ -0,0 +1,96 @@
+////
+// @file concurrent_arena_test.cc
+// @brief
+// 测试多线程共享的ConcurrentArena
+//
+#include <catch2/catch_test_macros.hpp>
+#include <util/concurrent_arena.h>
+#include <util/random.h>
+#include <thread>
+#include <vector>
+
+using namespace leveldb;
+
+namespace
+{
+struct Allocation
+{
+    size_t size;
+    char *ptr;
+    bool aligned;
+};
+
+// 每个线程分配随机大小的内存并写入自己的字节模式
+// Catch2的断言不是线程安全的, 检查留到线程结束之后
+void AllocateMany(ConcurrentArena *arena, int id, int n,
+                  std::vector<Allocation> *allocated)
+{
+    Random rnd(301 + id);
+    for (int i = 0; i < n; i++) {
+        size_t s = rnd.OneIn(1000) ? rnd.Uniform(6000) : rnd.Uniform(100);
+        if (s == 0) { s = 1; }
+        bool aligned = rnd.OneIn(4);
+        char *r = aligned ? arena->AllocateAligned(s) : arena->Allocate(s);
+        for (size_t b = 0; b < s; b++) { r[b] = static_cast<char>(id); }
+        allocated->push_back(Allocation{s, r, aligned});
+    }
+}
+
+void CheckAllocations(const std::vector<Allocation> &allocated, int id,
+                      size_t *bytes)
+{
+    for (size_t i = 0; i < allocated.size(); i++) {
+        const Allocation &a = allocated[i];
+        *bytes += a.size;
+        if (a.aligned) {
+            REQUIRE(reinterpret_cast<uintptr_t>(a.ptr) % sizeof(void *) == 0);
+        }
+        for (size_t b = 0; b < a.size; b++) {
+            REQUIRE(a.ptr[b] == static_cast<char>(id));
+        }
+    }
+}
+}  // namespace
+
+TEST_CASE("util/concurrent_arena.h")
+{
+    SECTION("Empty")
+    {
+        ConcurrentArena arena;
+        REQUIRE(arena.MemoryUsage() == 0);
+    }
+
+    SECTION("Simple")
+    {
+        ConcurrentArena arena;
+        std::vector<Allocation> allocated;
+        AllocateMany(&arena, 0, 100000, &allocated);
+        size_t bytes = 0;
+        CheckAllocations(allocated, 0, &bytes);
+        // 未分配出去的slab空间不计入内存用量
+        REQUIRE(arena.MemoryUsage() >= bytes);
+        REQUIRE(arena.MemoryUsage() <= bytes * 1.10);
+    }
+
+    SECTION("Concurrent")
+    {
+        const int kThreads = 8;
+        const int kAllocations = 20000;
+        ConcurrentArena arena;
+        std::vector<std::vector<Allocation> > allocated(kThreads);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < kThreads; t++) {
+            threads.emplace_back(AllocateMany, &arena, t + 1, kAllocations,
+                                 &allocated[t]);
+        }
+        for (size_t t = 0; t < threads.size(); t++) { threads[t].join(); }
+
+        // 各线程的分配互不重叠
+        size_t bytes = 0;
+        for (int t = 0; t < kThreads; t++) {
+            CheckAllocations(allocated[t], t + 1, &bytes);
+        }
+        REQUIRE(arena.MemoryUsage() >= bytes);
+        REQUIRE(arena.MemoryUsage() <= bytes * 1.25);
+    }
+}
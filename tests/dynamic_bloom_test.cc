@@ -0,0 +1,63 @@
+////
+// @file dynamic_bloom_test.cc
+// @brief
+// 测试内存表使用的布隆过滤器
+//
+#include <catch2/catch_test_macros.hpp>
+#include <util/arena.h>
+#include <util/coding.h>
+#include <util/dynamic_bloom.h>
+
+using namespace leveldb;
+
+static Slice Key(int i, char *buffer)
+{
+    EncodeFixed32(buffer, i);
+    return Slice(buffer, sizeof(uint32_t));
+}
+
+TEST_CASE("util/dynamic_bloom.h")
+{
+    SECTION("Empty")
+    {
+        Arena arena;
+        DynamicBloom bloom(&arena, 100);
+        REQUIRE_FALSE(bloom.MayContain("hello"));
+        REQUIRE_FALSE(bloom.MayContain("world"));
+    }
+
+    SECTION("Small")
+    {
+        Arena arena;
+        DynamicBloom bloom(&arena, 100);
+        bloom.Add("hello");
+        bloom.Add("world");
+        REQUIRE(bloom.MayContain("hello"));
+        REQUIRE(bloom.MayContain("world"));
+        REQUIRE_FALSE(bloom.MayContain("x"));
+        REQUIRE_FALSE(bloom.MayContain("foo"));
+    }
+
+    SECTION("VaryingLengths")
+    {
+        // 每个键约16位：不能有假阴性，假阳性率应低于2%
+        char buffer[sizeof(int)];
+        for (int length = 1; length <= 10000; length *= 10) {
+            Arena arena;
+            DynamicBloom bloom(&arena, length * 16);
+            for (int i = 0; i < length; i++) {
+                bloom.Add(Key(i, buffer));
+            }
+            for (int i = 0; i < length; i++) {
+                REQUIRE(bloom.MayContain(Key(i, buffer)));
+            }
+            int false_positives = 0;
+            for (int i = 0; i < 10000; i++) {
+                if (bloom.MayContain(Key(i + 1000000000, buffer))) {
+                    false_positives++;
+                }
+            }
+            REQUIRE(false_positives <= 200);
+        }
+    }
+}
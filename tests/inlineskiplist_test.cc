@@ -0,0 +1,129 @@
+////
+// @file inlineskiplist_test.cc
+// @brief
+// 测试键内联存储的跳表
+//
+#include <catch2/catch_test_macros.hpp>
+#include <db/inlineskiplist.h>
+#include <util/arena.h>
+#include <util/coding.h>
+#include <util/random.h>
+#include <set>
+
+using namespace leveldb;
+
+typedef uint64_t Key;
+
+static Key Decode(const char *p)
+{
+    // 大端存储，按字节比较与按数值比较一致
+    Key k = 0;
+    for (int i = 0; i < 8; i++) {
+        k = (k << 8) | static_cast<uint8_t>(p[i]);
+    }
+    return k;
+}
+
+struct TestComparator
+{
+    int shift;  // 前缀取键的高位，相同前缀时回退到完整比较
+
+    int operator()(const char *a, const char *b) const
+    {
+        Key x = Decode(a), y = Decode(b);
+        return x < y ? -1 : (x > y ? +1 : 0);
+    }
+    uint64_t KeyPrefix(const char *key) const { return Decode(key) >> shift; }
+};
+
+typedef InlineSkipList<TestComparator> TestList;
+
+static void Insert(TestList *list, Key k)
+{
+    char *buf = list->AllocateKey(8);
+    for (int i = 7; i >= 0; i--) {
+        buf[i] = static_cast<char>(k & 0xff);
+        k >>= 8;
+    }
+    list->Insert(buf);
+}
+
+static std::string Encode(Key k)
+{
+    std::string s(8, '\0');
+    for (int i = 7; i >= 0; i--) {
+        s[i] = static_cast<char>(k & 0xff);
+        k >>= 8;
+    }
+    return s;
+}
+
+TEST_CASE("db/inlineskiplist.h")
+{
+    SECTION("Empty")
+    {
+        Arena arena;
+        TestList list(TestComparator{8}, &arena);
+        REQUIRE_FALSE(list.Contains(Encode(10).data()));
+
+        TestList::Iterator iter(&list);
+        REQUIRE_FALSE(iter.Valid());
+        iter.SeekToFirst();
+        REQUIRE_FALSE(iter.Valid());
+        iter.Seek(Encode(100).data());
+        REQUIRE_FALSE(iter.Valid());
+        iter.SeekToLast();
+        REQUIRE_FALSE(iter.Valid());
+    }
+
+    SECTION("InsertAndLookup")
+    {
+        // 分别测试：前缀为完整键、部分键、以及前缀全部相同
+        for (int shift : {0, 8, 64 - 1}) {
+            const int N = 2000;
+            const int R = 5000;
+            Random rnd(1000);
+            std::set<Key> keys;
+            Arena arena;
+            TestList list(TestComparator{shift}, &arena);
+            for (int i = 0; i < N; i++) {
+                Key key = rnd.Next() % R;
+                if (keys.insert(key).second) {
+                    Insert(&list, key);
+                }
+            }
+
+            for (int i = 0; i < R; i++) {
+                REQUIRE(list.Contains(Encode(i).data()) == (keys.count(i) == 1));
+            }
+
+            // 正向遍历与模型一致
+            for (int i = 0; i < R; i += 7) {
+                TestList::Iterator iter(&list);
+                iter.Seek(Encode(i).data());
+                std::set<Key>::iterator model_iter = keys.lower_bound(i);
+                for (int j = 0; j < 3; j++) {
+                    if (model_iter == keys.end()) {
+                        REQUIRE_FALSE(iter.Valid());
+                        break;
+                    }
+                    REQUIRE(iter.Valid());
+                    REQUIRE(*model_iter == Decode(iter.key()));
+                    ++model_iter;
+                    iter.Next();
+                }
+            }
+
+            // 反向遍历与模型一致
+            TestList::Iterator iter(&list);
+            iter.SeekToLast();
+            for (std::set<Key>::reverse_iterator model_iter = keys.rbegin();
+                 model_iter != keys.rend(); ++model_iter) {
+                REQUIRE(iter.Valid());
+                REQUIRE(*model_iter == Decode(iter.key()));
+                iter.Prev();
+            }
+            REQUIRE_FALSE(iter.Valid());
+        }
+    }
+}
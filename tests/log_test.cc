@@ -40,6 +40,14 @@ static std::string NumberString(int x)
     return std::string(buf);
 }
 
+// 测试文件放在测试目录下, 不写入当前工作目录
+static std::string TestFileName(Env *env)
+{
+    std::string dir;
+    env->GetTestDirectory(&dir);
+    return dir + "/log_testfile";
+}
+
 TEST_CASE("writing")
 {
     SECTION("short string")
@@ -48,11 +56,11 @@ TEST_CASE("writing")
         WritableFile *dest;
         SequentialFile *source;
         std::string msg = "hello,leveldb.";
-        Status s = env_->NewWritableFile("testfile", &dest);
+        Status s = env_->NewWritableFile(TestFileName(env_), &dest);
         REQUIRE(s.ok());
         Writer writer_(dest);
         REQUIRE(writer_.AddRecord(Slice(msg)).ok());
-        s = env_->NewSequentialFile("testfile", &source);
+        s = env_->NewSequentialFile(TestFileName(env_), &source);
         REQUIRE(s.ok());
         Reader::Reporter *repoter_;
         Reader reader_(source, repoter_, true, 0);
@@ -68,11 +76,11 @@ TEST_CASE("writing")
         WritableFile *dest;
         SequentialFile *source;
         std::string msg = BigString("hello ", 102400);
-        Status s = env_->NewWritableFile("testfile", &dest);
+        Status s = env_->NewWritableFile(TestFileName(env_), &dest);
         REQUIRE(s.ok());
         Writer writer_(dest);
         REQUIRE(writer_.AddRecord(Slice(msg)).ok());
-        s = env_->NewSequentialFile("testfile", &source);
+        s = env_->NewSequentialFile(TestFileName(env_), &source);
         REQUIRE(s.ok());
         Reader::Reporter *repoter_;
         Reader reader_(source, repoter_, true, 0);
@@ -87,14 +95,14 @@ TEST_CASE("writing")
         PosixEnv *env_ = new PosixEnv;
         WritableFile *dest;
         SequentialFile *source;
-        Status s = env_->NewWritableFile("testfile", &dest);
+        Status s = env_->NewWritableFile(TestFileName(env_), &dest);
         REQUIRE(s.ok());
         Writer writer_(dest);
         for (int i = 1; i <= 100000; ++i) {
             std::string msg = NumberString(i);
             REQUIRE(writer_.AddRecord(Slice(msg)).ok());
         }
-        s = env_->NewSequentialFile("testfile", &source);
+        s = env_->NewSequentialFile(TestFileName(env_), &source);
         REQUIRE(s.ok());
         Reader::Reporter *repoter_;
         Reader reader_(source, repoter_, true, 0);
@@ -116,11 +124,11 @@ TEST_CASE("writing")
         WritableFile *dest;
         SequentialFile *source;
         std::string msg = BigString("hello", n);
-        Status s = env_->NewWritableFile("testfile", &dest);
+        Status s = env_->NewWritableFile(TestFileName(env_), &dest);
         REQUIRE(s.ok());
         Writer writer_(dest);
         REQUIRE(writer_.AddRecord(Slice(msg)).ok());
-        s = env_->NewSequentialFile("testfile", &source);
+        s = env_->NewSequentialFile(TestFileName(env_), &source);
         REQUIRE(s.ok());
         Reader::Reporter *repoter_;
         Reader reader_(source, repoter_, true, 0);
@@ -133,5 +141,74 @@ TEST_CASE("writing")
     }
 }
 
+TEST_CASE("compressed records")
+{
+    SECTION("round trip")
+    {
+        // 压缩库不可用时记录以未压缩形式写入，读取结果应一致
+        const CompressionType types[] = {kSnappyCompression, kZstdCompression};
+        for (CompressionType type : types) {
+            PosixEnv *env_ = new PosixEnv;
+            WritableFile *dest;
+            SequentialFile *source;
+            Status s = env_->NewWritableFile(TestFileName(env_), &dest);
+            REQUIRE(s.ok());
+            Writer writer_(dest, 0, type, 1);
+            std::string big = BigString("hello ", 3 * kBlockSize);
+            REQUIRE(writer_.AddRecord(Slice("small")).ok());
+            REQUIRE(writer_.AddRecord(Slice(big)).ok());
+            REQUIRE(writer_.AddRecord(Slice("")).ok());
+            s = env_->NewSequentialFile(TestFileName(env_), &source);
+            REQUIRE(s.ok());
+            Reader reader_(source, nullptr, true, 0);
+            Slice record;
+            std::string scrach;
+            REQUIRE(reader_.ReadRecord(&record, &scrach));
+            REQUIRE(record.ToString() == "small");
+            REQUIRE(reader_.ReadRecord(&record, &scrach));
+            REQUIRE(record.ToString() == big);
+            REQUIRE(reader_.ReadRecord(&record, &scrach));
+            REQUIRE(record.ToString() == "");
+            REQUIRE(!reader_.ReadRecord(&record, &scrach));
+        }
+    }
+    SECTION("unknown compression type")
+    {
+        // 手工构造一个压缩类型未知的记录，读取时应报告损坏并跳过
+        struct CountingReporter : public Reader::Reporter {
+            size_t dropped = 0;
+            void Corruption(size_t bytes, const Status &status) override
+            {
+                dropped += bytes;
+            }
+        };
+        PosixEnv *env_ = new PosixEnv;
+        WritableFile *dest;
+        SequentialFile *source;
+        Status s = env_->NewWritableFile(TestFileName(env_), &dest);
+        REQUIRE(s.ok());
+        const std::string payload = "\x7f" "garbage";
+        char header[kHeaderSize];
+        char t = static_cast<char>(kCompressedFullType);
+        uint32_t crc = crc32c::Extend(crc32c::Value(&t, 1), payload.data(),
+                                      payload.size());
+        EncodeFixed32(header, crc32c::Mask(crc));
+        header[4] = static_cast<char>(payload.size() & 0xff);
+        header[5] = static_cast<char>(payload.size() >> 8);
+        header[6] = t;
+        REQUIRE(dest->Append(Slice(header, kHeaderSize)).ok());
+        REQUIRE(dest->Append(Slice(payload)).ok());
+        REQUIRE(dest->Close().ok());
+        s = env_->NewSequentialFile(TestFileName(env_), &source);
+        REQUIRE(s.ok());
+        CountingReporter reporter;
+        Reader reader_(source, &reporter, true, 0);
+        Slice record;
+        std::string scrach;
+        REQUIRE(!reader_.ReadRecord(&record, &scrach));
+        REQUIRE(reporter.dropped == payload.size());
+    }
+}
+
 } // namespace log
 } // namespace leveldb
\ No newline at end of file
@@ -13,6 +13,7 @@
 #include "db/memtable.h"
 #include "db/memtable.cc"
 #include "db/dbformat.h"
+#include "leveldb/memtablerep.h"
 #include "leveldb/table.h"
 #include "util/status.cc"
 #include <map>
@@ -121,4 +122,151 @@ TEST_CASE("memtable")
     }
 } // namespace leveldb
 
+TEST_CASE("leveldb/memtablerep.h")
+{
+    // 每种表示都应给出相同的查找与遍历结果
+    MemTableRepFactory *factories[] = {NewSkipListRepFactory(),
+                                       NewInlineSkipListRepFactory(),
+                                       NewHashSkipListRepFactory(2, 16),
+                                       NewVectorRepFactory()};
+    for (MemTableRepFactory *factory : factories) {
+        SECTION(factory->Name())
+        {
+            Options options;
+            options.memtable_factory = factory;
+            // 开启布隆过滤器不应改变查找结果
+            options.memtable_bloom_size_ratio = 0.01;
+            MemTable *mem = new MemTable(NewTestComparator(), options);
+            mem->Ref();
+            // 乱序写入, 同一个键写入两个版本
+            const char *keys[] = {"k3", "a", "k1", "b22", "k2", "b1"};
+            SequenceNumber seq = 1;
+            for (const char *k : keys) {
+                mem->Add(seq++, kTypeValue, k, std::string("v") + k);
+            }
+            mem->Add(seq++, kTypeDeletion, "k2", "");
+            mem->Add(seq++, kTypeValue, "a", "new");
+            // 只有合并操作数的键
+            mem->Add(seq++, kTypeMerge, "b3", "m1");
+            mem->Add(seq++, kTypeMerge, "b3", "m2");
+
+            std::string value;
+            Status s;
+            REQUIRE(mem->Get(LookupKey("k1", seq), &value, &s));
+            REQUIRE(value == "vk1");
+            REQUIRE(mem->Get(LookupKey("a", seq), &value, &s));
+            REQUIRE(value == "new");
+            // 旧快照读到旧版本
+            REQUIRE(mem->Get(LookupKey("a", 2), &value, &s));
+            REQUIRE(value == "va");
+            REQUIRE(mem->Get(LookupKey("k2", seq), &value, &s));
+            REQUIRE(s.IsNotFound());
+            s = Status::OK();
+            REQUIRE_FALSE(mem->Get(LookupKey("k0", seq), &value, &s));
+            REQUIRE_FALSE(mem->Get(LookupKey("k1", 2), &value, &s));
+            // 读过之后写入的条目也能读到
+            mem->Add(seq++, kTypeValue, "k0", "vk0");
+            REQUIRE(mem->Get(LookupKey("k0", seq), &value, &s));
+            REQUIRE(value == "vk0");
+            // 操作数按从新到旧收集, 并继续查找更旧的数据
+            std::vector<std::string> operands;
+            REQUIRE_FALSE(
+                mem->Get(LookupKey("b3", seq), &value, &s, nullptr, &operands));
+            REQUIRE(operands == std::vector<std::string>{"m2", "m1"});
+            REQUIRE(s.ok());
+            REQUIRE(mem->Get(LookupKey("b3", seq), &value, &s));
+            REQUIRE(s.IsNotSupportedError());
+            s = Status::OK();
+
+            // 不可变前后遍历顺序一致
+            for (int round = 0; round < 2; round++) {
+                Iterator *iter = mem->NewIterator();
+                std::string result;
+                for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+                    ParsedInternalKey ikey(Slice(), 0, kTypeValue);
+                    REQUIRE(ParseInternalKey(iter->key(), &ikey));
+                    result += ikey.user_key.ToString() + "@" +
+                              std::to_string(ikey.sequence) + " ";
+                }
+                REQUIRE(result ==
+                        "a@8 a@2 b1@6 b22@4 b3@10 b3@9 k0@11 k1@3 k2@7 "
+                        "k2@5 k3@1 ");
+                iter->Seek(LookupKey("b2", seq).internal_key());
+                REQUIRE(iter->Valid());
+                REQUIRE(ExtractUserKey(iter->key()) == "b22");
+                iter->Prev();
+                REQUIRE(ExtractUserKey(iter->key()) == "b1");
+                iter->SeekToLast();
+                REQUIRE(ExtractUserKey(iter->key()) == "k3");
+                delete iter;
+                mem->MarkImmutable();
+            }
+            mem->Unref();
+        }
+    }
+    for (MemTableRepFactory *factory : factories) {
+        delete factory;
+    }
+}
+
+namespace {
+// 与 BytewiseComparator 顺序相同, 但不会被识别为按字节比较
+class OpaqueBytewiseComparator : public Comparator
+{
+  public:
+    const char *Name() const override { return "test.OpaqueBytewise"; }
+    int Compare(const Slice &a, const Slice &b) const override
+    {
+        return BytewiseComparator()->Compare(a, b);
+    }
+    void FindShortestSeparator(std::string *, const Slice &) const override {}
+    void FindShortSuccessor(std::string *) const override {}
+};
+} // namespace
+
+TEST_CASE("memtable bytewise fast path")
+{
+    // 特化的按字节比较与通用比较器给出相同的顺序
+    OpaqueBytewiseComparator opaque;
+    MemTable *fast = new MemTable(InternalKeyComparator(BytewiseComparator()));
+    MemTable *slow = new MemTable(InternalKeyComparator(&opaque));
+    fast->Ref();
+    slow->Ref();
+    // 含高位字节、前缀关系与同键多版本
+    const std::string keys[] = {"",         "a",   std::string("a\0", 2),
+                                "\xff",     "ab",  "\x80z",
+                                "abcdefghi", "abc", "a"};
+    SequenceNumber seq = 1;
+    for (const std::string &k : keys) {
+        fast->Add(seq, kTypeValue, k, "v");
+        slow->Add(seq, kTypeValue, k, "v");
+        seq++;
+    }
+    Iterator *fast_iter = fast->NewIterator();
+    Iterator *slow_iter = slow->NewIterator();
+    int count = 0;
+    for (fast_iter->SeekToFirst(), slow_iter->SeekToFirst();
+         slow_iter->Valid(); fast_iter->Next(), slow_iter->Next()) {
+        REQUIRE(fast_iter->Valid());
+        REQUIRE(fast_iter->key() == slow_iter->key());
+        count++;
+    }
+    REQUIRE_FALSE(fast_iter->Valid());
+    REQUIRE(count == 9);
+
+    std::string value;
+    Status s;
+    REQUIRE(fast->Get(LookupKey("a", seq), &value, &s));
+    REQUIRE_FALSE(fast->Get(LookupKey("abcd", seq), &value, &s));
+    fast_iter->Seek(LookupKey("a", 5).internal_key());
+    REQUIRE(fast_iter->Valid());
+    REQUIRE(ExtractUserKey(fast_iter->key()) == "a");
+    REQUIRE(DecodeFixed64(fast_iter->key().data() +
+                          fast_iter->key().size() - 8) >> 8 == 2);
+    delete fast_iter;
+    delete slow_iter;
+    fast->Unref();
+    slow->Unref();
+}
+
 } // namespace leveldb
@@ -0,0 +1,48 @@
+////
+// @file rate_limiter_test.cc
+// @brief
+// 测试后台写入限速器
+//
+#include <catch2/catch_test_macros.hpp>
+#include <leveldb/env.h>
+#include <leveldb/rate_limiter.h>
+#include <memory>
+
+using namespace leveldb;
+
+TEST_CASE("include/leveldb/rate_limiter.h")
+{
+    SECTION("Throughput")
+    {
+        // 1MB/s，每100ms补充100KB：写入300KB至少需要约200ms
+        std::unique_ptr<RateLimiter> limiter(NewGenericRateLimiter(1 << 20));
+        Env *env = Env::Default();
+        const uint64_t start = env->NowMicros();
+        for (int i = 0; i < 75; i++) {
+            limiter->Request(4096, RateLimiter::kIOLow);
+        }
+        const uint64_t elapsed = env->NowMicros() - start;
+        REQUIRE(elapsed >= 150000);
+        REQUIRE(elapsed < 2000000);
+    }
+
+    SECTION("SetBytesPerSecond")
+    {
+        std::unique_ptr<RateLimiter> limiter(NewGenericRateLimiter(1 << 20));
+        REQUIRE(limiter->GetBytesPerSecond() == (1 << 20));
+        limiter->SetBytesPerSecond(1 << 10);
+        REQUIRE(limiter->GetBytesPerSecond() == (1 << 10));
+    }
+
+    SECTION("AutoTuned")
+    {
+        // 自动调节的速率不超过设定上限
+        std::unique_ptr<RateLimiter> limiter(
+            NewGenericRateLimiter(1 << 20, true));
+        REQUIRE(limiter->GetBytesPerSecond() <= (1 << 20));
+        REQUIRE(limiter->GetBytesPerSecond() >= (1 << 20) / 20);
+        limiter->ReportWriteStall();
+        limiter->Request(100, RateLimiter::kIOHigh);
+        REQUIRE(limiter->GetBytesPerSecond() <= (1 << 20));
+    }
+}
@@ -0,0 +1,57 @@
+////
+// @file write_controller_test.cc
+// @brief
+// 测试写入限速的令牌桶
+//
+#include <catch2/catch_test_macros.hpp>
+#include <db/write_controller.h>
+
+using namespace leveldb;
+
+TEST_CASE("db/write_controller.h")
+{
+    SECTION("NotThrottled")
+    {
+        WriteController controller;
+        REQUIRE(controller.GetDelay(1000, 1 << 20) == 0);
+    }
+
+    SECTION("Rate")
+    {
+        // 1MB/s：写入1MB需要等待约1秒
+        WriteController controller;
+        controller.SetDelayedWriteRate(1 << 20);
+        uint64_t now = 1000000;
+        REQUIRE(controller.GetDelay(now, 1 << 20) == 1000000);
+
+        // 等待期间补充的令牌已被上一次写入消耗
+        now += 1000000;
+        REQUIRE(controller.GetDelay(now, 1024) == 1024 * 1000000 / (1 << 20));
+    }
+
+    SECTION("Steady")
+    {
+        // 按时等待的写入者得到的平均速率等于设定速率
+        WriteController controller;
+        const uint64_t rate = 4 << 20;
+        controller.SetDelayedWriteRate(rate);
+        uint64_t now = 1;
+        uint64_t written = 0;
+        for (int i = 0; i < 1000; i++) {
+            now += controller.GetDelay(now, 4096) + 10;
+            written += 4096;
+        }
+        const double actual = written * 1000000.0 / now;
+        REQUIRE(actual <= rate * 1.01);
+        REQUIRE(actual >= rate * 0.95);
+    }
+
+    SECTION("Disable")
+    {
+        WriteController controller;
+        controller.SetDelayedWriteRate(1024);
+        REQUIRE(controller.GetDelay(1, 4096) > 0);
+        controller.SetDelayedWriteRate(0);
+        REQUIRE(controller.GetDelay(2, 4096) == 0);
+    }
+}
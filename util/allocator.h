@@ -0,0 +1,42 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// Allocator is the interface of the arena-style allocators that in-memory
+// structures (skiplists, memtable representations, bloom filters) carve
+// their memory out of.  Memory is released when the allocator is
+// destroyed, never piece by piece.
+
+#ifndef STORAGE_LEVELDB_UTIL_ALLOCATOR_H_
+#define STORAGE_LEVELDB_UTIL_ALLOCATOR_H_
+
+#include <cstddef>
+
+namespace leveldb {
+
+// The opaque arena type of include/leveldb/memtablerep.h, which keeps
+// Allocator itself out of the public API.  Every MemTableAllocator is an
+// Allocator.
+class MemTableAllocator {
+ public:
+  virtual ~MemTableAllocator() = default;
+};
+
+class Allocator : public MemTableAllocator {
+ public:
+  ~Allocator() override = default;
+
+  // Return a pointer to a newly allocated memory block of "bytes" bytes.
+  virtual char* Allocate(size_t bytes) = 0;
+
+  // Allocate memory with the normal alignment guarantees provided by malloc.
+  virtual char* AllocateAligned(size_t bytes) = 0;
+
+  // Returns an estimate of the total memory usage of data allocated
+  // by the allocator.
+  virtual size_t MemoryUsage() const = 0;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_UTIL_ALLOCATOR_H_
@@ -4,21 +4,83 @@
 
 #include "util/arena.h"
 
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstdio>
+#endif
+
 namespace leveldb {
 
 static const int kBlockSize = 4096;
 
-Arena::Arena()
-    : alloc_ptr_(nullptr), alloc_bytes_remaining_(0), memory_usage_(0) {}
+// Returns the size of the huge pages of the system, or 0 if unknown.
+static size_t SystemHugePageSize() {
+#if defined(__linux__)
+  static const size_t size = []() -> size_t {
+    std::FILE* f = std::fopen("/proc/meminfo", "r");
+    if (f == nullptr) {
+      return 0;
+    }
+    size_t kb = 0;
+    char line[128];
+    while (std::fgets(line, sizeof(line), f) != nullptr) {
+      if (std::sscanf(line, "Hugepagesize: %zu kB", &kb) == 1) {
+        break;
+      }
+    }
+    std::fclose(f);
+    return kb * 1024;
+  }();
+  return size;
+#else
+  return 0;
+#endif
+}
+
+// Rounds a requested huge page block size up to a multiple of the system
+// huge page size, so that the lengths mapped are valid; returns 0 (use
+// ordinary memory) if the system has no huge pages.
+static size_t HugePageBlockSize(size_t requested) {
+  if (requested == 0) {
+    return 0;
+  }
+  const size_t system = SystemHugePageSize();
+  if (system == 0 || (system & (system - 1)) != 0) {
+    return 0;
+  }
+  // Both are powers of two.
+  return requested > system ? requested : system;
+}
+
+Arena::Arena() : Arena(0, false) {}
+
+Arena::Arena(size_t huge_page_size, bool numa_aware)
+    : huge_page_size_(HugePageBlockSize(huge_page_size)),
+      block_size_(huge_page_size_ > kBlockSize ? huge_page_size_ : kBlockSize),
+      numa_aware_(numa_aware),
+      alloc_ptr_(nullptr),
+      alloc_bytes_remaining_(0),
+      memory_usage_(0),
+      huge_page_usage_(0) {
+  assert((huge_page_size & (huge_page_size - 1)) == 0);
+}
 
 Arena::~Arena() {
   for (size_t i = 0; i < blocks_.size(); i++) {
     delete[] blocks_[i];
   }
+#if defined(__linux__)
+  for (size_t i = 0; i < mapped_blocks_.size(); i++) {
+    munmap(mapped_blocks_[i].first, mapped_blocks_[i].second);
+  }
+#endif
 }
 
 char* Arena::AllocateFallback(size_t bytes) {
-  if (bytes > kBlockSize / 4) {
+  if (bytes > block_size_ / 4) {
     // Object is more than a quarter of our block size.  Allocate it separately
     // to avoid wasting too much space in leftover bytes.
     char* result = AllocateNewBlock(bytes);
@@ -26,8 +88,14 @@ char* Arena::AllocateFallback(size_t bytes) {
   }
 
   // We waste the remaining space in the current block.
-  alloc_ptr_ = AllocateNewBlock(kBlockSize);
-  alloc_bytes_remaining_ = kBlockSize;
+  alloc_ptr_ = nullptr;
+  if (huge_page_size_ != 0) {
+    alloc_ptr_ = AllocateHugePageBlock(block_size_);
+  }
+  if (alloc_ptr_ == nullptr) {
+    alloc_ptr_ = AllocateNewBlock(block_size_);
+  }
+  alloc_bytes_remaining_ = block_size_;
 
   char* result = alloc_ptr_;
   alloc_ptr_ += bytes;
@@ -63,4 +131,63 @@ char* Arena::AllocateNewBlock(size_t block_bytes) {
   return result;
 }
 
+char* Arena::AllocateHugePageBlock(size_t block_bytes) {
+#if defined(__linux__)
+  char* result = nullptr;
+  void* addr;
+#if defined(MAP_HUGETLB)
+  // Explicit huge pages are only available if the administrator reserved
+  // them (vm.nr_hugepages).
+  addr = mmap(nullptr, block_bytes, PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (addr != MAP_FAILED) {
+    result = reinterpret_cast<char*>(addr);
+  }
+#endif
+  if (result == nullptr) {
+    // Transparent huge pages need a huge-page aligned range, so map
+    // one extra page and trim the misaligned head and tail.
+    const size_t mapped_bytes = block_bytes + huge_page_size_;
+    addr = mmap(nullptr, mapped_bytes, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED) {
+      return nullptr;
+    }
+    char* base = reinterpret_cast<char*>(addr);
+    const uintptr_t mask = huge_page_size_ - 1;
+    result = reinterpret_cast<char*>(
+        (reinterpret_cast<uintptr_t>(base) + mask) & ~mask);
+    const size_t head = result - base;
+    const size_t tail = mapped_bytes - head - block_bytes;
+    if (head > 0) munmap(base, head);
+    if (tail > 0) munmap(result + block_bytes, tail);
+#if defined(MADV_HUGEPAGE)
+    madvise(result, block_bytes, MADV_HUGEPAGE);
+#endif
+  }
+
+#if defined(SYS_mbind) && defined(SYS_getcpu)
+  if (numa_aware_) {
+    // Prefer the node of the allocating thread.  Pages are placed when
+    // first touched, which happens after this call.
+    unsigned cpu, node;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0 && node < 64) {
+      const unsigned long nodemask = 1ul << node;
+      const int kMpolPreferred = 1;
+      syscall(SYS_mbind, result, block_bytes, kMpolPreferred, &nodemask,
+              sizeof(nodemask) * 8, 0);
+    }
+  }
+#endif
+
+  mapped_blocks_.push_back(std::make_pair(result, block_bytes));
+  memory_usage_.fetch_add(block_bytes, std::memory_order_relaxed);
+  huge_page_usage_.fetch_add(block_bytes, std::memory_order_relaxed);
+  return result;
+#else
+  (void)block_bytes;
+  return nullptr;
+#endif  // defined(__linux__)
+}
+
 }  // namespace leveldb
@@ -9,35 +9,65 @@
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
+#include <utility>
 #include <vector>
 
+#include "util/allocator.h"
+
 namespace leveldb {
 
-class Arena {
+// Arena is not thread-safe: allocations require external synchronization.
+// See ConcurrentArena for an arena that may be used by several threads.
+class Arena : public Allocator {
  public:
   Arena();
 
+  // If "huge_page_size" is non-zero, memory is carved out of blocks of
+  // that size, rounded up to the huge page size of the system, mapped
+  // with huge pages: explicitly reserved ones if available, else
+  // transparent huge pages, else ordinary memory.  Without huge pages in
+  // the system the arena works as if "huge_page_size" was zero.  If
+  // "numa_aware" is also true, each mapped block is placed on the NUMA
+  // node of the thread that allocates it.  Huge pages and NUMA placement
+  // are only supported on Linux.
+  // REQUIRES: huge_page_size is zero or a power of two
+  Arena(size_t huge_page_size, bool numa_aware);
+
   Arena(const Arena&) = delete;
   Arena& operator=(const Arena&) = delete;
 
-  ~Arena();
+  ~Arena() override;
 
   // Return a pointer to a newly allocated memory block of "bytes" bytes.
-  char* Allocate(size_t bytes);
+  char* Allocate(size_t bytes) override;
 
   // Allocate memory with the normal alignment guarantees provided by malloc.
-  char* AllocateAligned(size_t bytes);
+  char* AllocateAligned(size_t bytes) override;
 
   // Returns an estimate of the total memory usage of data allocated
   // by the arena.
-  size_t MemoryUsage() const {
+  size_t MemoryUsage() const override {
     return memory_usage_.load(std::memory_order_relaxed);
   }
 
+  // Returns the part of MemoryUsage() held in blocks mapped with huge
+  // pages.
+  size_t HugePageMemoryUsage() const {
+    return huge_page_usage_.load(std::memory_order_relaxed);
+  }
+
  private:
   char* AllocateFallback(size_t bytes);
   char* AllocateNewBlock(size_t block_bytes);
 
+  // Returns nullptr if no block could be mapped.
+  char* AllocateHugePageBlock(size_t block_bytes);
+
+  const size_t huge_page_size_;  // 0 if huge pages are not used
+  // Size of the blocks small allocations are carved out of.
+  const size_t block_size_;
+  const bool numa_aware_;
+
   // Allocation state
   char* alloc_ptr_;
   size_t alloc_bytes_remaining_;
@@ -45,11 +75,15 @@ class Arena {
   // Array of new[] allocated memory blocks
   std::vector<char*> blocks_;
 
+  // Blocks mapped with mmap() and their lengths
+  std::vector<std::pair<char*, size_t>> mapped_blocks_;
+
   // Total memory usage of the arena.
   //
   // TODO(costan): This member is accessed via atomics, but the others are
   //               accessed without any locking. Is this OK?
   std::atomic<size_t> memory_usage_;
+  std::atomic<size_t> huge_page_usage_;
 };
 
 inline char* Arena::Allocate(size_t bytes) {
@@ -0,0 +1,183 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/concurrent_arena.h"
+
+#include <cassert>
+#include <functional>
+#include <new>
+#include <thread>
+
+#include "util/mutexlock.h"
+
+#if defined(__linux__)
+#include <sched.h>
+#endif
+
+namespace leveldb {
+
+namespace {
+
+// Bytes taken from the underlying arena for a slab, its header included,
+// so that a slab is exactly one block of a default Arena.  Allocations
+// larger than a quarter of a slab bypass the shards.
+const uint32_t kSlabBytes = 4096;
+const int kMaxShards = 64;
+const size_t kCacheLineSize = 64;
+const size_t kAlign = (sizeof(void*) > 8) ? sizeof(void*) : 8;
+
+int ShardCount() {
+  unsigned cores = std::thread::hardware_concurrency();
+  int n = 1;
+  while (n < static_cast<int>(cores) && n < kMaxShards) {
+    n *= 2;
+  }
+  return n;
+}
+
+// Index of the core the calling thread runs on, or a per-thread value if
+// that is unknown.
+unsigned CurrentCore() {
+#if defined(__linux__)
+  int cpu = sched_getcpu();
+  if (cpu >= 0) {
+    return static_cast<unsigned>(cpu);
+  }
+#endif
+  static thread_local const unsigned thread_hash = static_cast<unsigned>(
+      std::hash<std::thread::id>()(std::this_thread::get_id()));
+  return thread_hash;
+}
+
+}  // namespace
+
+// Slabs live in the underlying arena and are never freed before it, so a
+// thread may still carve from a slab its shard has already replaced.
+struct ConcurrentArena::Slab {
+  char* base;
+  // Offset of the first free byte in the high 32 bits and of the end of
+  // the free range in the low 32 bits.
+  std::atomic<uint64_t> state;
+};
+
+// Aligned to a cache line so that cores do not contend on each other's
+// shards.
+struct alignas(kCacheLineSize) ConcurrentArena::Shard {
+  Shard() : slab(nullptr) {}
+
+  std::atomic<Slab*> slab;
+};
+
+ConcurrentArena::ConcurrentArena() : ConcurrentArena(0, false) {}
+
+ConcurrentArena::ConcurrentArena(size_t huge_page_size, bool numa_aware)
+    : shard_count_(ShardCount()),
+      shard_memory_(new char[(shard_count_ + 1) * kCacheLineSize]),
+      shards_(NewShards(shard_memory_, shard_count_)),
+      arena_(huge_page_size, numa_aware) {
+  static_assert(sizeof(Shard) == kCacheLineSize, "Shard is not a cache line");
+  static_assert(sizeof(Slab) % kAlign == 0, "slab data is misaligned");
+}
+
+ConcurrentArena::~ConcurrentArena() { delete[] shard_memory_; }
+
+ConcurrentArena::Shard* ConcurrentArena::NewShards(char* memory, int count) {
+  // operator new[] need not align to more than alignof(std::max_align_t)
+  // before C++17, so "memory" has room for one more cache line.
+  uintptr_t start = reinterpret_cast<uintptr_t>(memory);
+  start = (start + kCacheLineSize - 1) & ~(kCacheLineSize - 1);
+  Shard* shards = reinterpret_cast<Shard*>(start);
+  for (int i = 0; i < count; i++) {
+    new (&shards[i]) Shard;
+  }
+  return shards;
+}
+
+size_t ConcurrentArena::MemoryUsage() const {
+  size_t unused = 0;
+  for (int i = 0; i < shard_count_; i++) {
+    Slab* slab = shards_[i].slab.load(std::memory_order_acquire);
+    if (slab != nullptr) {
+      uint64_t state = slab->state.load(std::memory_order_relaxed);
+      unused += static_cast<uint32_t>(state) - (state >> 32);
+    }
+  }
+  size_t usage = arena_.MemoryUsage();
+  return usage > unused ? usage - unused : 0;
+}
+
+ConcurrentArena::Shard* ConcurrentArena::CurrentShard() const {
+  return &shards_[CurrentCore() & (shard_count_ - 1)];
+}
+
+char* ConcurrentArena::AllocateFromSlab(Slab* slab, size_t bytes,
+                                        bool aligned) {
+  uint64_t state = slab->state.load(std::memory_order_relaxed);
+  while (true) {
+    uint32_t head = static_cast<uint32_t>(state >> 32);
+    uint32_t tail = static_cast<uint32_t>(state);
+    uint32_t offset;
+    if (aligned) {
+      offset = (head + kAlign - 1) & ~static_cast<uint32_t>(kAlign - 1);
+      if (offset > tail || tail - offset < bytes) {
+        return nullptr;
+      }
+      head = offset + static_cast<uint32_t>(bytes);
+    } else {
+      if (tail - head < bytes) {
+        return nullptr;
+      }
+      tail -= static_cast<uint32_t>(bytes);
+      offset = tail;
+    }
+    uint64_t next = (static_cast<uint64_t>(head) << 32) | tail;
+    if (slab->state.compare_exchange_weak(state, next,
+                                          std::memory_order_relaxed)) {
+      return slab->base + offset;
+    }
+  }
+}
+
+char* ConcurrentArena::AllocateImpl(size_t bytes, bool aligned) {
+  assert(bytes > 0);
+  Shard* shard = CurrentShard();
+  if (bytes <= kSlabBytes / 4) {
+    Slab* slab = shard->slab.load(std::memory_order_acquire);
+    if (slab != nullptr) {
+      char* result = AllocateFromSlab(slab, bytes, aligned);
+      if (result != nullptr) {
+        return result;
+      }
+    }
+  }
+  return AllocateSlow(shard, bytes, aligned);
+}
+
+char* ConcurrentArena::AllocateSlow(Shard* shard, size_t bytes, bool aligned) {
+  MutexLock l(&mu_);
+  if (bytes > kSlabBytes / 4) {
+    return aligned ? arena_.AllocateAligned(bytes) : arena_.Allocate(bytes);
+  }
+
+  // Another thread may have refilled the shard while we waited.
+  Slab* slab = shard->slab.load(std::memory_order_relaxed);
+  if (slab != nullptr) {
+    char* result = AllocateFromSlab(slab, bytes, aligned);
+    if (result != nullptr) {
+      return result;
+    }
+  }
+
+  // The rest of the old slab is abandoned.
+  char* mem = arena_.AllocateAligned(kSlabBytes);
+  slab = new (mem) Slab;
+  slab->base = mem + sizeof(Slab);
+  slab->state.store(kSlabBytes - sizeof(Slab), std::memory_order_relaxed);
+  char* result = AllocateFromSlab(slab, bytes, aligned);
+  assert(result != nullptr);
+  shard->slab.store(slab, std::memory_order_release);
+  return result;
+}
+
+}  // namespace leveldb
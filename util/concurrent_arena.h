@@ -0,0 +1,83 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#ifndef STORAGE_LEVELDB_UTIL_CONCURRENT_ARENA_H_
+#define STORAGE_LEVELDB_UTIL_CONCURRENT_ARENA_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "port/port.h"
+#include "util/allocator.h"
+#include "util/arena.h"
+
+namespace leveldb {
+
+// ConcurrentArena is an Arena that may be used by several threads at once.
+//
+// Each CPU core is given a shard holding a small slab carved out of an
+// underlying Arena.  Allocations bump a pointer in the slab of the
+// caller's core with a single compare-and-swap; only refilling a slab
+// and allocations too large for a slab take a lock.  Aligned allocations
+// are taken from the front of a slab and unaligned ones from the back,
+// so mixing them does not waste space on padding.
+class ConcurrentArena : public Allocator {
+ public:
+  ConcurrentArena();
+
+  // See Arena::Arena(size_t, bool).
+  ConcurrentArena(size_t huge_page_size, bool numa_aware);
+
+  ConcurrentArena(const ConcurrentArena&) = delete;
+  ConcurrentArena& operator=(const ConcurrentArena&) = delete;
+
+  ~ConcurrentArena() override;
+
+  char* Allocate(size_t bytes) override { return AllocateImpl(bytes, false); }
+
+  char* AllocateAligned(size_t bytes) override {
+    return AllocateImpl(bytes, true);
+  }
+
+  // Returns the memory allocated from the underlying arena, less the part
+  // of the shard slabs that has not been handed out yet.
+  size_t MemoryUsage() const override;
+
+  // Returns the part of the underlying arena's memory that is held in
+  // blocks mapped with huge pages.
+  size_t HugePageMemoryUsage() const { return arena_.HugePageMemoryUsage(); }
+
+ private:
+  struct Slab;
+  struct Shard;
+
+  char* AllocateImpl(size_t bytes, bool aligned);
+
+  // Try to carve "bytes" out of "*slab".  Returns nullptr if it is full.
+  static char* AllocateFromSlab(Slab* slab, size_t bytes, bool aligned);
+
+  // Slow path: refill the caller's shard, or allocate straight from the
+  // underlying arena if "bytes" is too large for a slab.
+  char* AllocateSlow(Shard* shard, size_t bytes, bool aligned);
+
+  Shard* CurrentShard() const;
+
+  // Construct "count" shards in "memory", which holds count + 1 cache
+  // lines, at its first cache line boundary.
+  static Shard* NewShards(char* memory, int count);
+
+  const int shard_count_;  // A power of two
+  char* const shard_memory_;
+  Shard* const shards_;  // Within shard_memory_
+
+  // Serializes allocations from arena_.  Its usage counters are atomic
+  // and may be read without it.
+  port::Mutex mu_;
+  Arena arena_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_UTIL_CONCURRENT_ARENA_H_
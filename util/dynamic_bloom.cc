@@ -0,0 +1,76 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/dynamic_bloom.h"
+
+#include <cassert>
+#include <cstdint>
+#include <new>
+
+#include "util/allocator.h"
+#include "util/hash.h"
+
+namespace leveldb {
+
+namespace {
+
+const size_t kCacheLineSize = 64;
+
+uint32_t BloomHash(const Slice& key) {
+  return Hash(key.data(), key.size(), 0xbc9f1d34);
+}
+
+}  // namespace
+
+DynamicBloom::DynamicBloom(Allocator* allocator, uint32_t total_bits,
+                           int num_probes)
+    : num_lines_((total_bits + kLineBits - 1) / kLineBits),
+      num_probes_(num_probes) {
+  assert(total_bits > 0);
+  assert(num_probes > 0);
+  // Odd line counts spread hash values better under the modulo below.
+  num_lines_ |= 1;
+  const size_t bytes = num_lines_ * kWordsPerLine * sizeof(uint64_t);
+  char* raw = allocator->AllocateAligned(bytes + kCacheLineSize);
+  const uintptr_t misalignment =
+      reinterpret_cast<uintptr_t>(raw) & (kCacheLineSize - 1);
+  if (misalignment != 0) {
+    raw += kCacheLineSize - misalignment;
+  }
+  data_ = reinterpret_cast<std::atomic<uint64_t>*>(raw);
+  for (size_t i = 0; i < num_lines_ * kWordsPerLine; i++) {
+    new (&data_[i]) std::atomic<uint64_t>(0);
+  }
+}
+
+void DynamicBloom::Add(const Slice& key) {
+  uint32_t h = BloomHash(key);
+  std::atomic<uint64_t>* line = data_ + LineIndex(h) * kWordsPerLine;
+  const uint32_t delta = (h >> 17) | (h << 15);  // Rotate right 17 bits
+  for (int i = 0; i < num_probes_; i++) {
+    h += delta;
+    const uint32_t bit = h % kLineBits;
+    std::atomic<uint64_t>* word = &line[bit / 64];
+    // Single writer, so a plain read-modify-write is enough.
+    word->store(word->load(std::memory_order_relaxed) | (1ull << (bit % 64)),
+                std::memory_order_relaxed);
+  }
+}
+
+bool DynamicBloom::MayContain(const Slice& key) const {
+  uint32_t h = BloomHash(key);
+  const std::atomic<uint64_t>* line = data_ + LineIndex(h) * kWordsPerLine;
+  const uint32_t delta = (h >> 17) | (h << 15);
+  for (int i = 0; i < num_probes_; i++) {
+    h += delta;
+    const uint32_t bit = h % kLineBits;
+    if ((line[bit / 64].load(std::memory_order_relaxed) &
+         (1ull << (bit % 64))) == 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace leveldb
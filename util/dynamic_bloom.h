@@ -0,0 +1,54 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// DynamicBloom is an in-memory bloom filter that keys can be added to
+// while it is being queried, e.g. to let MemTable::Get() skip the
+// skiplist search for keys that were never added.  All probes for a key
+// fall into a single cache line, so a query costs at most one cache miss.
+//
+// Thread safety: Add() requires external synchronization, MayContain()
+// may be called concurrently with Add().
+
+#ifndef STORAGE_LEVELDB_UTIL_DYNAMIC_BLOOM_H_
+#define STORAGE_LEVELDB_UTIL_DYNAMIC_BLOOM_H_
+
+#include <atomic>
+#include <cstdint>
+
+#include "leveldb/slice.h"
+
+namespace leveldb {
+
+class Allocator;
+
+class DynamicBloom {
+ public:
+  // Allocate a filter of at least "total_bits" bits from "*allocator".
+  // REQUIRES: total_bits > 0
+  DynamicBloom(Allocator* allocator, uint32_t total_bits, int num_probes = 6);
+
+  DynamicBloom(const DynamicBloom&) = delete;
+  DynamicBloom& operator=(const DynamicBloom&) = delete;
+
+  void Add(const Slice& key);
+
+  // Returns false if "key" was definitely not added.
+  bool MayContain(const Slice& key) const;
+
+ private:
+  enum { kLineBits = 512, kWordsPerLine = kLineBits / 64 };
+
+  // Picks the cache line from other hash bits than the first probes.
+  uint32_t LineIndex(uint32_t h) const {
+    return ((h >> 11) | (h << 21)) % num_lines_;
+  }
+
+  uint32_t num_lines_;
+  const int num_probes_;
+  std::atomic<uint64_t>* data_;  // num_lines_ * kWordsPerLine words
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_UTIL_DYNAMIC_BLOOM_H_
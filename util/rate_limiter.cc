@@ -0,0 +1,198 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "util/rate_limiter.h"
+
+#include <algorithm>
+
+#include "leveldb/env.h"
+#include "port/port.h"
+#include "port/thread_annotations.h"
+#include "util/mutexlock.h"
+
+namespace leveldb {
+
+RateLimiter::~RateLimiter() = default;
+
+namespace {
+
+class GenericRateLimiter : public RateLimiter {
+ public:
+  GenericRateLimiter(int64_t bytes_per_second, bool auto_tuned, Env* env)
+      : env_(env),
+        auto_tuned_(auto_tuned),
+        max_bytes_per_second_(bytes_per_second),
+        bytes_per_second_(auto_tuned ? bytes_per_second / 2
+                                     : bytes_per_second),
+        available_bytes_(0),
+        next_refill_micros_(env->NowMicros()),
+        high_pri_waiting_(0),
+        periods_(0),
+        drained_periods_(0),
+        drained_(false),
+        stalls_(0) {}
+
+  ~GenericRateLimiter() override = default;
+
+  void Request(size_t bytes, IOPriority pri) override {
+    MutexLock l(&mu_);
+    bool counted = false;
+    while (true) {
+      Refill(env_->NowMicros());
+      if (pri == kIOHigh || high_pri_waiting_ == 0) {
+        const size_t granted =
+            std::min<size_t>(bytes, std::max<int64_t>(available_bytes_, 0));
+        available_bytes_ -= granted;
+        bytes -= granted;
+        if (bytes == 0) {
+          break;
+        }
+      }
+      // Wait for the next refill.
+      drained_ = true;
+      if (pri == kIOHigh && !counted) {
+        high_pri_waiting_++;
+        counted = true;
+      }
+      const uint64_t now = env_->NowMicros();
+      const uint64_t wait =
+          next_refill_micros_ > now ? next_refill_micros_ - now : 0;
+      mu_.Unlock();
+      env_->SleepForMicroseconds(static_cast<int>(wait));
+      mu_.Lock();
+    }
+    if (counted) {
+      high_pri_waiting_--;
+    }
+  }
+
+  void ReportWriteStall() override {
+    MutexLock l(&mu_);
+    stalls_++;
+  }
+
+  int64_t GetBytesPerSecond() const override {
+    MutexLock l(&mu_);
+    return bytes_per_second_;
+  }
+
+  void SetBytesPerSecond(int64_t bytes_per_second) override {
+    MutexLock l(&mu_);
+    max_bytes_per_second_ = std::max<int64_t>(bytes_per_second, 1);
+    bytes_per_second_ = auto_tuned_ ? std::min(bytes_per_second_,
+                                               max_bytes_per_second_)
+                                    : max_bytes_per_second_;
+  }
+
+ private:
+  static const uint64_t kRefillPeriodMicros = 100 * 1000;
+  // Auto-tuning adjusts the rate once per this many refill periods.
+  static const int kTunePeriods = 20;
+
+  int64_t RefillBytes() const {
+    return std::max<int64_t>(
+        1, bytes_per_second_ * static_cast<int64_t>(kRefillPeriodMicros) /
+               1000000);
+  }
+
+  void Refill(uint64_t now) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    if (now < next_refill_micros_) {
+      return;
+    }
+    const uint64_t periods =
+        (now - next_refill_micros_) / kRefillPeriodMicros + 1;
+    next_refill_micros_ += periods * kRefillPeriodMicros;
+    // Unused budget does not accumulate beyond one period, so background
+    // writes cannot burst after an idle spell.
+    available_bytes_ = std::min(
+        RefillBytes(), available_bytes_ + static_cast<int64_t>(periods) *
+                                              RefillBytes());
+
+    if (auto_tuned_) {
+      periods_ += periods;
+      if (drained_) {
+        drained_periods_++;
+        drained_ = false;
+      }
+      if (periods_ >= kTunePeriods) {
+        Tune();
+      }
+    }
+  }
+
+  void Tune() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    const int64_t min_rate = std::max<int64_t>(1, max_bytes_per_second_ / 20);
+    int64_t rate = bytes_per_second_;
+    if (stalls_ > 0) {
+      // Writers are waiting on background work: give it bandwidth fast.
+      rate *= 2;
+    } else if (drained_periods_ * 10 >= periods_ * 9) {
+      // Background writes were throttled almost all the time.
+      rate += rate / 20 + 1;
+    } else if (drained_periods_ * 2 < periods_) {
+      // Most of the budget went unused: leave more for foreground reads.
+      rate -= rate / 20;
+    }
+    bytes_per_second_ =
+        std::max(min_rate, std::min(rate, max_bytes_per_second_));
+    periods_ = 0;
+    drained_periods_ = 0;
+    stalls_ = 0;
+  }
+
+  mutable port::Mutex mu_;
+  Env* const env_;
+  const bool auto_tuned_;
+  int64_t max_bytes_per_second_ GUARDED_BY(mu_);
+  int64_t bytes_per_second_ GUARDED_BY(mu_);
+  int64_t available_bytes_ GUARDED_BY(mu_);
+  uint64_t next_refill_micros_ GUARDED_BY(mu_);
+  int high_pri_waiting_ GUARDED_BY(mu_);
+
+  // Auto-tuning state since the last adjustment.
+  uint64_t periods_ GUARDED_BY(mu_);
+  uint64_t drained_periods_ GUARDED_BY(mu_);
+  bool drained_ GUARDED_BY(mu_);  // Some request waited in this period
+  int stalls_ GUARDED_BY(mu_);
+};
+
+class RateLimitedWritableFile : public WritableFile {
+ public:
+  RateLimitedWritableFile(WritableFile* base, RateLimiter* limiter,
+                          RateLimiter::IOPriority pri)
+      : base_(base), limiter_(limiter), pri_(pri) {}
+
+  ~RateLimitedWritableFile() override { delete base_; }
+
+  Status Append(const Slice& data) override {
+    limiter_->Request(data.size(), pri_);
+    return base_->Append(data);
+  }
+  Status Close() override { return base_->Close(); }
+  Status Flush() override { return base_->Flush(); }
+  Status Sync() override { return base_->Sync(); }
+
+ private:
+  WritableFile* const base_;
+  RateLimiter* const limiter_;
+  const RateLimiter::IOPriority pri_;
+};
+
+}  // namespace
+
+RateLimiter* NewGenericRateLimiter(int64_t bytes_per_second, bool auto_tuned) {
+  return new GenericRateLimiter(std::max<int64_t>(bytes_per_second, 1),
+                                auto_tuned, Env::Default());
+}
+
+WritableFile* NewRateLimitedWritableFile(WritableFile* base,
+                                         RateLimiter* limiter,
+                                         RateLimiter::IOPriority pri) {
+  if (limiter == nullptr) {
+    return base;
+  }
+  return new RateLimitedWritableFile(base, limiter, pri);
+}
+
+}  // namespace leveldb